@@ -0,0 +1,43 @@
+/*
+  ADC sampling in noise reduction sleep
+
+  Conversions run with the CPU asleep (SLEEP_MODE_ADC), which removes its switching noise from the
+  result and costs less than spinning on ADSC. Each reading averages ADC_SAMPLES conversions after
+  discarding the first ones, until two in a row agree within 1 LSB: the mux settles after a channel
+  change within one, but the bandgap takes several to start up and charge the sample and hold, so no
+  delay() is needed between channels. Read several channels in one adcBegin()/adcEnd().
+
+  The ADC is only powered between adcBegin() and adcEnd(). Timer0 and the UART stop during the
+  conversions, so millis() loses about 0.1 ms per conversion.
+
+  Copyright: desplega.com
+*/
+
+#ifndef ADC_H
+#define ADC_H
+
+#include <Arduino.h>
+
+// Channels (MUX3..0)
+#define ADC_CHANNEL_A0 0
+#define ADC_CHANNEL_BANDGAP 14 // Internal 1.1 V reference, to measure Vcc
+
+// Conversions averaged per reading
+#define ADC_SAMPLES 16
+
+// Most conversions discarded while a channel settles (3.3 ms), for an input too noisy to ever agree
+#define ADC_SETTLE_CONVERSIONS 32
+
+// Time of one conversion: 13 ADC clocks at 125 kHz (the first one after adcBegin() takes 25)
+#define ADC_CONVERSION_US 104
+
+// Powers the ADC up, with AVcc as reference and a 125 kHz ADC clock at 8 MHz
+void adcBegin();
+
+// Powers the ADC down, for power down sleep
+void adcEnd();
+
+// Average of samples conversions of a channel, 0 to 1023
+uint16_t adcRead(uint8_t channel, uint8_t samples = ADC_SAMPLES);
+
+#endif
@@ -0,0 +1,27 @@
+/*
+  SRAM ring buffer of readings waiting to be sent in a batch frame
+
+  Copyright: desplega.com
+*/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "telemetry.h"
+
+// Readings the buffer holds. When it is full the oldest reading is overwritten
+#define BATCH_CAPACITY 8
+
+// Adds a reading at the end
+void batchAdd(const TelemetryReading *reading);
+
+// Number of buffered readings
+uint8_t batchCount();
+
+// Buffered reading, 0 is the oldest
+const TelemetryReading *batchGet(uint8_t index);
+
+// Removes the count oldest readings
+void batchDrop(uint8_t count);
+
+#endif
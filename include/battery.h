@@ -1,3 +1,4 @@
 #include <Arduino.h>
 
+unsigned char batteryMeasure(); // Vcc in 1/10 V with the ADC already on (adcBegin()), kept for the next isVoltageLow()
 bool isVoltageLow();
\ No newline at end of file
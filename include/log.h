@@ -0,0 +1,98 @@
+/*
+  Serial logging with compile-time levels
+
+  Text output goes through the LOG_ macros, which compile to nothing (arguments included) above
+  LOG_LEVEL. Set it with a build flag, eg -DLOG_LEVEL=LOG_LEVEL_NONE in the release env of
+  platformio.ini, so production firmware spends no awake time on the UART.
+
+  With -DLOG_TRACE=1 text output is off and TRACE() writes fixed size binary records instead,
+  which cost a few ms per event at 9600 baud:
+    LOG_TRACE_SYNC (1 byte) | event, one of TRACE_ (1 byte) | value (int32_t, LSB first)
+  Without it TRACE() compiles to nothing.
+
+  Copyright: desplega.com
+*/
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <Arduino.h>
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_DEBUG 3
+
+#ifndef LOG_TRACE
+#define LOG_TRACE 0
+#endif
+
+#if LOG_TRACE
+#undef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_NONE // The UART carries binary records
+#elif !defined(LOG_LEVEL)
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+#define LOG_BAUD 9600
+#define LOG_TRACE_SYNC 0xa5
+
+// Trace events, the value they carry in brackets
+#define TRACE_BOOT 1            // Sequence number restored from the store
+#define TRACE_RADIO_FAILED 2    // 0
+#define TRACE_SENSORS 3         // Number of temperature sensors found
+#define TRACE_GHOST_DEVICE 4    // Index of the sensor
+#define TRACE_SAMPLE 5          // Wake cycle count
+#define TRACE_HARP_ADC 6        // Harp input ADC value
+#define TRACE_TEMPERATURE 7     // Sensor index << 16 | temperature in 1/16 C
+#define TRACE_NOT_REPORTED 8    // Wake cycle count
+#define TRACE_SEND 9            // Frame length
+#define TRACE_ACK 10            // CRC16 of the acknowledged frame
+#define TRACE_ADR 11            // RSSI of the ADR command
+#define TRACE_REPLAY 12         // Number of readings replayed
+#define TRACE_DEFERRED 13       // Duty cycle off time in ms the send waits for
+#define TRACE_TX_TIMEOUT 14     // Frame length
+
+#if LOG_LEVEL > LOG_LEVEL_NONE || LOG_TRACE
+#define LOG_BEGIN() Serial.begin(LOG_BAUD)
+#define LOG_FLUSH() logFlush() // Let the UART finish before its clock stops
+// Waits for the UART to send everything, profiled as PROFILE_SERIAL
+void logFlush();
+#else
+#define LOG_BEGIN() do {} while (0)
+#define LOG_FLUSH() do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) Serial.print(__VA_ARGS__)
+#define LOG_ERRORLN(...) Serial.println(__VA_ARGS__)
+#else
+#define LOG_ERROR(...) do {} while (0)
+#define LOG_ERRORLN(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) Serial.print(__VA_ARGS__)
+#define LOG_INFOLN(...) Serial.println(__VA_ARGS__)
+#else
+#define LOG_INFO(...) do {} while (0)
+#define LOG_INFOLN(...) do {} while (0)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) Serial.print(__VA_ARGS__)
+#define LOG_DEBUGLN(...) Serial.println(__VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#define LOG_DEBUGLN(...) do {} while (0)
+#endif
+
+#if LOG_TRACE
+#define TRACE(event, value) logTrace(event, value)
+// Writes one binary trace record
+void logTrace(uint8_t event, int32_t value);
+#else
+#define TRACE(event, value) do {} while (0)
+#endif
+
+#endif
@@ -13,6 +13,7 @@
 // NVM map
 #define VIRGIN_ADDR 00 // 1 byte
 #define DEVICE_ID_ADDR 01 // 6 bytes
+#define STORE_ADDR 16 // Store-and-forward log of readings, up to the end of EEPROM (see store.h)
 
 // Default values
 #define DEVICE_ID_LENGTH 6 // DEVICE ID: To be manually defined with 6 bytes. It must be unique!
@@ -20,4 +21,5 @@
 
 void nvmInit();
 void nvmReset();
-void nvmGetDeviceID(char*);
\ No newline at end of file
+void nvmGetDeviceID(char*);
+uint8_t nvmNodeAddress(const char*); // RadioHead address of the node, derived from its DEVICE ID
\ No newline at end of file
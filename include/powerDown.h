@@ -6,5 +6,13 @@
 #define INIT_SLEEP_TIME 1 // Required to start up the device in sleep mode for a short time
 #define SLEEP_TIME 8 // Normal sleep time (1 is 8 seconds, which is the max of watchdog, other numbers is x times 8 seconds)
 
+// Watchdog intervals: index 0 is 16ms, each next index doubles it, up to 9 (8s)
+#define WDT_INTERVAL_8S 9
+#define WDT_INTERVAL_MS(index) (16UL << (index))
+
 void initSleep(void);
-void goToSleep(char);
\ No newline at end of file
+void goToSleep(char); // Power down for time watchdog intervals, or shutdown() if the battery is low
+void shutdown() __attribute__((noreturn)); // Power down for ever with interrupts disabled: the low battery shutdown
+void idleSleep(); // Idle until the next interrupt: the millis() timer (within 1ms) or LoRa DIO0. millis() advances
+void sleepMs(unsigned long ms); // Power down for at least ms milliseconds (rounded up to 16ms). millis() does not advance
+unsigned long sleptMillis(); // Total time spent in power down since reset, in ms (millis() only counts awake time)
\ No newline at end of file
@@ -0,0 +1,93 @@
+/*
+  Awake time and energy profiler
+
+  The firmware tells the profiler which phase it is in (sensors, ADC, radio, ...). Awake time is
+  measured with Timer1 counting CPU cycles, power down time comes from sleptMillis(). Timer1 stops
+  in ADC noise reduction sleep too, so the ADC phase is counted from its conversions. Each phase
+  has two configurable current figures, while awake and while powered down (eg the DS18B20 keeps
+  converting while the MCU sleeps), and charge is attributed from them. TX current follows the
+  transmitter power given to profileTxPower().
+
+  Running totals are kept in ProfileTotals. profileDump() prints them, the same way on the node
+  and on the host build, so that changes can be compared. With TELEMETRY_ENERGY the total charge
+  is also sent in every reading.
+
+  Build with -DPROFILE=0 to compile it out (the functions become empty inlines).
+
+  Copyright: desplega.com
+*/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <Arduino.h>
+
+#ifndef PROFILE
+#define PROFILE 1
+#endif
+
+// Phases
+#define PROFILE_MCU 0     // Anything else, MCU active
+#define PROFILE_SENSORS 1 // DS18B20 conversion and 1-Wire
+#define PROFILE_ADC 2     // ADC noise reduction sleep
+#define PROFILE_SERIAL 3  // Waiting for the UART
+#define PROFILE_RADIO 4   // Radio configuration over SPI, in standby
+#define PROFILE_TX 5      // Transmitting
+#define PROFILE_RX 6      // Listen windows
+#define PROFILE_SLEEP 7   // Powered down, whatever the phase
+#define PROFILE_PHASES 8
+
+// Currents in uA, at 3.3 V and 8 MHz (datasheet typical figures). Awake ones include the MCU
+#define PROFILE_UA_MCU 3000
+#define PROFILE_UA_SLEEP 5          // Power down with watchdog, radio asleep, sensors idle
+#define PROFILE_UA_SENSORS 1000     // DS18B20 converting
+#define PROFILE_UA_ADC 1300         // CPU halted, ADC on
+#define PROFILE_UA_RADIO_STANDBY 1600
+#define PROFILE_UA_RX 10800
+
+typedef struct
+{
+  uint32_t ms[PROFILE_PHASES];     // Time in each phase. PROFILE_SLEEP is all power down time
+  uint32_t charge[PROFILE_PHASES]; // Charge drawn in each phase, in uC (uA x s). Wraps after about 1200 mAh
+} ProfileTotals;
+
+#if PROFILE
+
+// Starts Timer1 and the accounting, in PROFILE_MCU
+void profileBegin();
+
+// Switches to a phase. Returns the previous one, to go back to with profileLeave()
+uint8_t profileEnter(uint8_t phase);
+
+// Goes back to a phase returned by profileEnter()
+void profileLeave(uint8_t previous);
+
+// Charges time Timer1 can't see to a phase, at its awake current: Timer1 stops in ADC noise
+// reduction sleep, so adcRead() accounts PROFILE_ADC from its number of conversions
+void profileAdd(uint8_t phase, uint32_t micros);
+
+// Sets the transmitter power the TX current is taken for, in dBm
+void profileTxPower(int8_t power);
+
+// Brings the totals up to date and returns them
+const ProfileTotals *profileTotals();
+
+// Total charge drawn since profileBegin() in mC
+uint32_t profileCharge();
+
+// Prints the totals
+void profileDump();
+
+#else
+
+inline void profileBegin() {}
+inline uint8_t profileEnter(uint8_t) { return PROFILE_MCU; }
+inline void profileLeave(uint8_t) {}
+inline void profileAdd(uint8_t, uint32_t) {}
+inline void profileTxPower(int8_t) {}
+inline uint32_t profileCharge() { return 0; }
+inline void profileDump() {}
+
+#endif
+
+#endif
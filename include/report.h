@@ -0,0 +1,29 @@
+/*
+  Report by exception: decides which readings are worth an uplink
+
+  A reading is reported when a field moved more than its deadband away from the last reported
+  reading, or when REPORT_HEARTBEAT_MS passed since the last report so the server still sees the
+  node is alive. Deadbands are per field, in telemetrySchema order (see src/report.cpp). Comparing
+  against the last reported value, not the last reading, keeps slow drifts from going unnoticed.
+
+  Copyright: desplega.com
+*/
+
+#ifndef REPORT_H
+#define REPORT_H
+
+#include "telemetry.h"
+
+// Deadband of the temperatures in 1/16 C
+#define REPORT_DEADBAND_TEMPERATURE 8
+
+// Longest time without a report in ms (on the clock of TelemetryReading::time)
+#define REPORT_HEARTBEAT_MS (15UL * 60 * 1000)
+
+// Deadband value of fields that never trigger a report on their own
+#define REPORT_IGNORE 0xffff
+
+// Returns true if reading must be reported, and then remembers it as the last reported one
+bool reportDue(const TelemetryReading *reading);
+
+#endif
@@ -0,0 +1,30 @@
+/*
+  Deadline ordered task scheduler for the wake/sleep cycle
+
+  Tasks are one-shot functions with a deadline. schedulerRun() runs the due ones and then powers
+  down until the next deadline, choosing the watchdog intervals to hit it. Periodic tasks schedule
+  themselves again.
+
+  Copyright: desplega.com
+*/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+// Maximum number of pending tasks
+#define SCHEDULER_MAX_TASKS 4
+
+typedef void (*SchedulerTask)(void);
+
+// Time in ms since reset, counting both awake (millis()) and powered down time
+unsigned long schedulerNow();
+
+// Schedules task to run at time due (as schedulerNow()). Returns false if there are too many tasks
+bool schedulerAt(unsigned long due, SchedulerTask task);
+
+// Runs every due task, in deadline order, then powers down until the next deadline
+void schedulerRun();
+
+#endif
@@ -0,0 +1,61 @@
+/*
+  Store-and-forward log of readings in EEPROM
+
+  Every reported reading is appended to a circular log of fixed size records after STORE_ADDR, so
+  writes go round the whole EEPROM instead of wearing a few cells. A record stays pending until the
+  gateway acknowledges the frame it was sent in, and pending records are replayed in batches once
+  the link is back. When the log is full the oldest record is overwritten, pending or not.
+
+  Record layout (STORE_RECORD_LENGTH bytes): TelemetryReading | status (last byte).
+  The status is erased before the reading is written and set last, so a record torn by a reset is
+  seen as empty.
+
+  Writes are queued and done by the EEPROM ready interrupt, about 3.4 ms per byte, so the CPU goes
+  on (eg transmitting) while they complete. The interrupt can't wake the CPU from power down, so
+  call storeFlush() before sleeping.
+
+  ACK downlink: STORE_ACK_COMMAND | CRC16 of the acknowledged frame (2 bytes, LSB first), followed by an
+  ADR command (see RHAdr.h) when flagged with RH_FLAGS_ADR
+
+  Copyright: desplega.com
+*/
+
+#ifndef STORE_H
+#define STORE_H
+
+#include <Arduino.h>
+#include "nvm.h"
+#include "telemetry.h"
+
+// Room for the reading and the status byte, rounded up to an even length: 16 bytes on AVR (20 with
+// TELEMETRY_ENERGY). Larger in the native build, where TelemetryReading is padded
+#define STORE_RECORD_LENGTH ((sizeof(TelemetryReading) + 2) & ~1)
+#define STORE_RECORDS ((E2END + 1 - STORE_ADDR) / STORE_RECORD_LENGTH)
+
+// Status byte of a record
+#define STORE_EMPTY 0xff
+#define STORE_PENDING 0x01
+#define STORE_ACKED 0x00
+
+// ACK downlink
+#define STORE_ACK_COMMAND 'K'
+#define STORE_ACK_LEN 3
+
+// Finds the end of the log. Returns the sequence number of the newest record, 0 if the log is empty
+uint32_t storeInit();
+
+// Queues a reading to be written as a pending record
+void storeAppend(const TelemetryReading *reading);
+
+// Marks the pending record with this sequence number as acknowledged
+void storeAck(uint32_t sequence);
+
+// Reads the next pending record, oldest first. Start with *cursor = 0.
+// Readings logged before the last reset get time 0, as their real time is unknown.
+// Returns false when there are no more
+bool storeNextPending(uint16_t *cursor, TelemetryReading *reading);
+
+// Waits until every queued write is done
+void storeFlush();
+
+#endif
@@ -0,0 +1,121 @@
+/*
+  Compact binary telemetry frames sent over LoRa, and their schema
+
+  Single reading frame layout:
+    TELEMETRY_VERSION (1 byte) | device ID (DEVICE_ID_LENGTH bytes) | fields, in telemetrySchema order | CRC16 (2 bytes, LSB first)
+
+  Batch frame layout, several readings in one uplink:
+    TELEMETRY_BATCH_VERSION (1 byte) | device ID | number of readings (1 byte) |
+    age of the first reading in seconds (varint) | fields of the first reading, as in a single reading frame |
+    for each further reading: seconds since the previous reading (varint), then each field as a zigzag varint
+    of its difference from the previous reading (flags are packed as usual) | CRC16
+  A reading taken before the last reset of the node has its timeUnknown flag set: the clock it was timed
+  with is gone, so its age is meaningless and decoders give it no timestamp.
+
+  Field encodings:
+    TELEMETRY_VARINT  - uint32_t as unsigned LEB128 (7 bits per byte, LSB first, bit 7 set on all but the last byte)
+    TELEMETRY_FIXED16 - int16_t fixed point, LSB first. Temperatures are in 1/16 C, the DS18B20 native resolution
+    TELEMETRY_FLAG    - one bit. Consecutive flags share a byte, the first one in bit 0
+
+  This file is shared with the gateway decoder (tools/telemetry_decode.cpp), so it must not depend on Arduino.
+
+  Copyright: desplega.com
+*/
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef ARDUINO
+#include <avr/pgmspace.h>
+#else
+#include <string.h>
+#ifndef PROGMEM
+#define PROGMEM
+#define memcpy_P memcpy
+#endif
+#endif
+
+#include "nvm.h"
+
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_BATCH_VERSION 2
+
+// Field types
+#define TELEMETRY_VARINT 0
+#define TELEMETRY_FIXED16 1
+#define TELEMETRY_FLAG 2
+
+// 1 to send the charge drawn since reset (see profile.h) in every reading.
+// The node and the gateway decoder must be built with the same value
+#ifndef TELEMETRY_ENERGY
+#define TELEMETRY_ENERGY 0
+#endif
+
+// Number of temperature sensors in a reading (MAX 2 devices!)
+#define TELEMETRY_TEMPERATURES 2
+
+// Worst case frame: version + device ID + 5 byte sequence + temperatures + one flag byte + energy + CRC
+#define TELEMETRY_MAX_FRAME_LENGTH (1 + DEVICE_ID_LENGTH + 5 + TELEMETRY_TEMPERATURES * 2 + 1 + TELEMETRY_ENERGY * 5 + 2)
+
+// Worst case size of a further reading in a batch frame: time delta + sequence delta + temperature deltas + flag byte + energy delta
+#define TELEMETRY_MAX_BATCH_READING_LENGTH (5 + 5 + TELEMETRY_TEMPERATURES * 3 + 1 + TELEMETRY_ENERGY * 5)
+
+// Fixed point scale of temperatures: value = degrees C * TELEMETRY_FIXED16_SCALE
+#define TELEMETRY_FIXED16_SCALE 16
+
+// One reading of the node
+typedef struct
+{
+  uint32_t sequence;                             // Reading counter, to detect lost and duplicated frames
+  int16_t temperature[TELEMETRY_TEMPERATURES];   // In 1/16 C, 0 if the sensor is not present
+  uint8_t harp;                                  // Harp status, 0 or 1
+  uint8_t led;                                   // LED status, 0 or 1
+#if TELEMETRY_ENERGY
+  uint32_t energy;                               // Charge drawn since reset in mC
+#endif
+  uint32_t time;                                 // When the reading was taken in ms (node clock), for batches
+  uint8_t timeUnknown;                           // 1 if taken before the last reset, when time is meaningless
+} TelemetryReading;
+
+// One entry of the schema
+typedef struct
+{
+  char name[4];   // JSON key the gateway forwards the field as, empty if it is not forwarded
+  uint8_t type;   // TELEMETRY_VARINT, TELEMETRY_FIXED16 or TELEMETRY_FLAG
+  uint8_t offset; // Offset of the field in TelemetryReading
+} TelemetryField;
+
+// The schema, in frame order (in PROGMEM on AVR)
+extern const TelemetryField telemetrySchema[] PROGMEM;
+extern const uint8_t telemetrySchemaLength;
+
+// Reads one entry of the schema
+void telemetryGetField(uint8_t index, TelemetryField *field);
+
+// Encodes a reading into frame, which must have room for TELEMETRY_MAX_FRAME_LENGTH bytes.
+// Returns the frame length
+uint8_t telemetryEncode(const TelemetryReading *reading, const char *deviceID, uint8_t *frame);
+
+// Encodes as many of count readings (oldest first) as fit in size bytes into a batch frame.
+// now is the current time on the clock of TelemetryReading::time. encoded receives the number of readings encoded.
+// Returns the frame length
+uint8_t telemetryEncodeBatch(const TelemetryReading *const *readings, uint8_t count, uint32_t now,
+                             const char *deviceID, uint8_t *frame, uint8_t size, uint8_t *encoded);
+
+// Decodes a single reading frame. deviceID must have room for DEVICE_ID_LENGTH bytes.
+// Returns false if the frame is truncated, has a bad CRC or an unknown version
+bool telemetryDecode(const uint8_t *frame, uint8_t length, char *deviceID, TelemetryReading *reading);
+
+// Decodes a batch frame into at most maxReadings readings, oldest first. ages receives the age of each
+// reading in seconds at the time it was sent (TelemetryReading::time is not set).
+// Returns the number of readings, or -1 if the frame is invalid
+int telemetryDecodeBatch(const uint8_t *frame, uint8_t length, char *deviceID,
+                         TelemetryReading *readings, uint32_t *ages, uint8_t maxReadings);
+
+// CRC-16/XMODEM (polynomial 0x1021, initial value 0)
+uint16_t CRC16(const uint8_t *pBuffer, uint32_t length);
+
+#endif
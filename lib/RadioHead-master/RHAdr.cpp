@@ -0,0 +1,245 @@
+// RHAdr.cpp
+//
+// Adaptive data rate for RH_RF95 networks
+// Copyright (C) 2019 desplega.com
+
+#include <RHAdr.h>
+
+// Demodulation floor of a spreading factor in units of 0.25 dB, per the SX1276 datasheet:
+// -7.5 dB at SF7, 2.5 dB lower for each further spreading factor
+#define RH_ADR_REQUIRED_SNR(sf) (-10 * ((int16_t)(sf) - 4))
+
+////////////////////////////////////////////////////////////////////
+// RHAdrServer
+RHAdrServer::RHAdrServer(uint8_t minSf, uint8_t maxSf, int8_t minPower, int8_t maxPower,
+			 uint8_t defaultSf, int8_t defaultPower)
+    :
+    _nextNode(0),
+    _minSf(minSf),
+    _maxSf(maxSf),
+    _minPower(minPower),
+    _maxPower(maxPower),
+    _defaultSf(defaultSf),
+    _defaultPower(defaultPower)
+{
+    memset(_nodes, 0, sizeof(_nodes));
+    for (uint8_t i = 0; i < RH_ADR_MAX_NODES; i++)
+	_nodes[i].address = RH_BROADCAST_ADDRESS; // Unused
+}
+
+RHAdrServer::NodeState* RHAdrServer::findNode(uint8_t address, bool create)
+{
+    uint8_t i;
+    for (i = 0; i < RH_ADR_MAX_NODES; i++)
+	if (_nodes[i].address == address)
+	    return &_nodes[i];
+    if (!create || address == RH_BROADCAST_ADDRESS)
+	return NULL;
+
+    NodeState* node = &_nodes[_nextNode];
+    _nextNode = (_nextNode + 1) % RH_ADR_MAX_NODES;
+    memset(node, 0, sizeof(*node));
+    node->address = address;
+    node->sf = node->targetSf = _defaultSf;
+    node->power = node->targetPower = _defaultPower;
+    return node;
+}
+
+void RHAdrServer::handleUplink(uint8_t from, int8_t snr, uint8_t flags, uint8_t settings)
+{
+    NodeState* node = findNode(from, true);
+    if (!node)
+	return;
+    // Without a report, a node that fell back on its own is assumed to be at full power
+    bool fellBack = !settings && (flags & RH_FLAGS_ADR);
+    uint8_t sf = settings ? RH_ADR_SETTINGS_SF(settings) : node->sf;
+    int8_t power = settings ? RH_ADR_SETTINGS_POWER(settings) : fellBack ? _maxPower : node->power;
+    if (fellBack || sf != node->sf || power != node->power)
+    {
+	// Applied a command or fell back: our history no longer describes its link
+	node->sf = sf;
+	node->power = power;
+	node->samples = 0;
+	node->next = 0;
+    }
+
+    node->snr[node->next] = snr;
+    node->next = (node->next + 1) % RH_ADR_HISTORY;
+    if (node->samples < RH_ADR_HISTORY)
+	node->samples++;
+    if (node->samples == RH_ADR_HISTORY)
+	compute(node);
+}
+
+void RHAdrServer::compute(NodeState* node)
+{
+    int8_t best = node->snr[0];
+    for (uint8_t i = 1; i < RH_ADR_HISTORY; i++)
+	if (node->snr[i] > best)
+	    best = node->snr[i];
+
+    // Surplus above the demodulation floor plus installation margin, in whole steps.
+    // Round a deficit away from zero, so any shortfall raises the power
+    int16_t margin = best - RH_ADR_REQUIRED_SNR(node->sf) - RH_ADR_MARGIN_DB * 4;
+    int16_t steps = margin >= 0 ? margin / (RH_ADR_STEP_DB * 4) : -((RH_ADR_STEP_DB * 4 - 1 - margin) / (RH_ADR_STEP_DB * 4));
+
+    uint8_t sf = node->sf;
+    int8_t power = node->power;
+    while (steps > 0 && sf > _minSf)
+    {
+	sf--;
+	steps--;
+    }
+    while (steps > 0 && power > _minPower)
+    {
+	power = (power - RH_ADR_STEP_DB < _minPower) ? _minPower : power - RH_ADR_STEP_DB;
+	steps--;
+    }
+    while (steps < 0 && power < _maxPower)
+    {
+	power = (power + RH_ADR_STEP_DB > _maxPower) ? _maxPower : power + RH_ADR_STEP_DB;
+	steps++;
+    }
+    // Out of power, trade data rate for range
+    while (steps < 0 && sf < _maxSf)
+    {
+	sf++;
+	steps++;
+    }
+    node->targetSf = sf;
+    node->targetPower = power;
+}
+
+bool RHAdrServer::commandDue(uint8_t node)
+{
+    NodeState* state = findNode(node, false);
+    return state
+	&& state->samples == RH_ADR_HISTORY
+	&& (state->targetSf != state->sf || state->targetPower != state->power);
+}
+
+uint8_t RHAdrServer::command(uint8_t node, uint8_t* buf)
+{
+    if (!commandDue(node))
+	return 0;
+    // Nothing is recorded: the node reports the settings it applied in its next uplink
+    NodeState* state = findNode(node, false);
+    buf[0] = RH_ADR_COMMAND;
+    buf[1] = state->targetSf;
+    buf[2] = (uint8_t)state->targetPower;
+    return RH_ADR_COMMAND_LEN;
+}
+
+bool RHAdrServer::sendCommand(RHGenericDriver& driver, uint8_t node)
+{
+    uint8_t buf[RH_ADR_COMMAND_LEN];
+    if (!command(node, buf))
+	return false;
+    driver.setHeaderTo(node);
+    driver.setHeaderFlags(RH_FLAGS_ADR);
+    bool sent = driver.send(buf, sizeof(buf));
+    driver.setHeaderFlags(RH_FLAGS_NONE, RH_FLAGS_ADR);
+    driver.setHeaderTo(RH_BROADCAST_ADDRESS);
+    return sent;
+}
+
+bool RHAdrServer::nodeSettings(uint8_t node, uint8_t* sf, int8_t* power)
+{
+    NodeState* state = findNode(node, false);
+    if (!state)
+	return false;
+    if (sf)    *sf = state->sf;
+    if (power) *power = state->power;
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////
+// RHAdrNode
+RHAdrNode::RHAdrNode(RH_RF95& driver, uint8_t sf, int8_t power, RH_RF95::Bandwidth bw,
+		     uint8_t crDenominator, uint8_t maxSf, int8_t maxPower)
+    :
+    _driver(driver),
+    _sf(sf),
+    _power(power),
+    _bw(bw),
+    _crDenominator(crDenominator),
+    _maxSf(maxSf),
+    _maxPower(maxPower),
+    _ackFailures(0),
+    _fallenBack(false),
+    _gatewayHeard(false)
+{
+}
+
+void RHAdrNode::begin()
+{
+    apply();
+}
+
+void RHAdrNode::apply()
+{
+    RH_RF95::ModemConfig config = RH_RF95::modemConfig(_sf, _bw, _crDenominator);
+    _driver.setModemRegisters(&config);
+    _driver.setTxPower(_power);
+}
+
+bool RHAdrNode::handleMessage(const uint8_t* buf, uint8_t len, uint8_t flags)
+{
+    if (!(flags & RH_FLAGS_ADR) || len != RH_ADR_COMMAND_LEN || buf[0] != RH_ADR_COMMAND)
+	return false;
+    if (!RH_RF95::modemConfigValid(buf[1], _bw, _crDenominator))
+	return true; // An ADR command, but not one we can apply
+
+    _sf = buf[1];
+    _power = (int8_t)buf[2];
+    _ackFailures = 0;
+    _fallenBack = false;
+    _gatewayHeard = true;
+    apply();
+    return true;
+}
+
+void RHAdrNode::sendResult(bool acknowledged)
+{
+    if (acknowledged)
+    {
+	_ackFailures = 0;
+	_gatewayHeard = true;
+	return;
+    }
+    if (!_gatewayHeard)
+	return; // Nothing says this gateway ever answers
+    if (++_ackFailures < RH_ADR_MAX_ACK_FAILURES)
+	return;
+
+    // Link lost at the commanded settings: fall back one step, power first since it costs no airtime
+    _ackFailures = 0;
+    if (_power < _maxPower)
+	_power = (_power + RH_ADR_STEP_DB > _maxPower) ? _maxPower : _power + RH_ADR_STEP_DB;
+    else if (_sf < _maxSf)
+	_sf++;
+    else
+	return; // Nothing left to try
+    _fallenBack = true;
+    apply();
+}
+
+uint8_t RHAdrNode::uplinkFlags()
+{
+    return _fallenBack ? RH_FLAGS_ADR : RH_FLAGS_NONE;
+}
+
+uint8_t RHAdrNode::uplinkId()
+{
+    return RH_ADR_SETTINGS(_sf, _power);
+}
+
+uint8_t RHAdrNode::spreadingFactor()
+{
+    return _sf;
+}
+
+int8_t RHAdrNode::txPower()
+{
+    return _power;
+}
@@ -0,0 +1,205 @@
+// RHAdr.h
+//
+// Adaptive data rate for RH_RF95 networks
+// Copyright (C) 2019 desplega.com
+
+#ifndef RHAdr_h
+#define RHAdr_h
+
+#include <RH_RF95.h>
+
+// The flag in the FLAGS header that marks ADR traffic.
+// From the gateway it marks an ADR command. From a node it is a request for a new ADR command,
+// sent after the node has fallen back from the commanded settings.
+#define RH_FLAGS_ADR 0x20
+
+// Number of SNR samples kept per node. A new command is only computed on a full history
+#define RH_ADR_HISTORY 8
+
+// Maximum number of nodes an RHAdrServer can track
+#ifndef RH_ADR_MAX_NODES
+ #define RH_ADR_MAX_NODES 16
+#endif
+
+// Installation margin in dB kept above the demodulation floor of the spreading factor
+#define RH_ADR_MARGIN_DB 10
+
+// Size of one ADR step in dB: one spreading factor, or this much transmitter power
+#define RH_ADR_STEP_DB 3
+
+// Number of consecutive unacknowledged sends before a node falls back one ADR step
+#define RH_ADR_MAX_ACK_FAILURES 3
+
+// ADR command message: RH_ADR_COMMAND, spreading factor, transmitter power (dBm)
+#define RH_ADR_COMMAND     'A'
+#define RH_ADR_COMMAND_LEN 3
+
+// The settings a node transmits with, as it reports them in the ID header of its uplinks:
+// spreading factor - 6 in the top 3 bits, power (0 to 31 dBm) in the low 5 bits. 0 is no report
+#define RH_ADR_SETTINGS(sf, power) ((uint8_t)((((sf) - 6) << 5) | ((power) & 0x1f)))
+#define RH_ADR_SETTINGS_SF(settings) (((settings) >> 5) + 6)
+#define RH_ADR_SETTINGS_POWER(settings) ((int8_t)((settings) & 0x1f))
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHAdrServer RHAdr.h <RHAdr.h>
+/// \brief Gateway side of adaptive data rate: computes the fastest spreading factor and lowest
+/// transmitter power each node's link supports.
+///
+/// Feed it the SNR of every uplink with handleUplink(). Once RH_ADR_HISTORY samples have been
+/// collected for a node, the best SNR is compared with the demodulation floor of the node's spreading
+/// factor (-7.5 dB at SF7 down to -20 dB at SF12) plus RH_ADR_MARGIN_DB. Each RH_ADR_STEP_DB of surplus
+/// first lowers the spreading factor, then the transmitter power. A deficit raises the power first,
+/// then the spreading factor.
+/// When the result differs from the node's current settings, a command is due: command() builds it,
+/// for instance to append to an acknowledgement, or sendCommand() sends it as a datagram of its own.
+/// Both are flagged with RH_FLAGS_ADR and neither is acknowledged: a command is known to have been
+/// applied when the next uplink of the node reports the new settings (see RH_ADR_SETTINGS), and stays
+/// due until then.
+///
+/// An RH_RF95 gateway only demodulates the spreading factor it is configured for, so a single
+/// radio gateway should construct this with minSf == maxSf, which leaves ADR controlling power only.
+class RHAdrServer
+{
+public:
+    /// Constructor.
+    /// \param[in] minSf Lowest spreading factor to command (7 to 12)
+    /// \param[in] maxSf Highest spreading factor to command (7 to 12)
+    /// \param[in] minPower Lowest transmitter power to command in dBm
+    /// \param[in] maxPower Highest transmitter power to command in dBm
+    /// \param[in] defaultSf Spreading factor nodes use until commanded otherwise
+    /// \param[in] defaultPower Transmitter power nodes use until commanded otherwise
+    RHAdrServer(uint8_t minSf = 7, uint8_t maxSf = 12, int8_t minPower = 5, int8_t maxPower = 20,
+		uint8_t defaultSf = 7, int8_t defaultPower = 13);
+
+    /// Records the signal quality of an uplink.
+    /// \param[in] from Address of the node that sent it
+    /// \param[in] snr SNR of the uplink in units of 0.25 dB, as RH_RF95::PacketInfo::snr
+    /// \param[in] flags FLAGS header of the uplink. RH_FLAGS_ADR means the node has fallen back
+    /// from the last command. Without a report of its settings, it is then assumed to transmit at maxPower
+    /// \param[in] settings ID header of the uplink: the settings the node sent it with (RH_ADR_SETTINGS),
+    /// or 0 if it does not report them. The history is discarded whenever they change
+    void handleUplink(uint8_t from, int8_t snr, uint8_t flags, uint8_t settings = 0);
+
+    /// Tells whether a command is due for a node
+    /// \param[in] node Address of the node
+    /// \return true if command() would build something
+    bool commandDue(uint8_t node);
+
+    /// Builds the due command for a node, if any
+    /// \param[in] node Address of the node
+    /// \param[out] buf Where to put the command, RH_ADR_COMMAND_LEN bytes
+    /// \return The length of the command, 0 if none is due
+    uint8_t command(uint8_t node, uint8_t* buf);
+
+    /// Sends the due command to a node, if any, as a datagram flagged with RH_FLAGS_ADR
+    /// \param[in] driver The driver to send with
+    /// \param[in] node Address of the node
+    /// \return true if a command was sent
+    bool sendCommand(RHGenericDriver& driver, uint8_t node);
+
+    /// Returns the settings a node last reported (or was assumed to have)
+    /// \param[in] node Address of the node
+    /// \param[out] sf Spreading factor
+    /// \param[out] power Transmitter power in dBm
+    /// \return false if the node is unknown
+    bool nodeSettings(uint8_t node, uint8_t* sf, int8_t* power);
+
+protected:
+    /// \brief Per node ADR state
+    typedef struct
+    {
+	uint8_t  address;                 ///< Node address
+	uint8_t  sf;                      ///< Current spreading factor
+	int8_t   power;                   ///< Current transmitter power in dBm
+	uint8_t  samples;                 ///< Number of valid entries in snr
+	uint8_t  next;                    ///< Index in snr of the next sample
+	int8_t   snr[RH_ADR_HISTORY];     ///< SNR history in units of 0.25 dB
+	uint8_t  targetSf;                ///< Spreading factor computed from the history
+	int8_t   targetPower;             ///< Power computed from the history
+    } NodeState;
+
+    /// Finds a node's state, optionally allocating it (entries are recycled round robin when full)
+    NodeState* findNode(uint8_t address, bool create);
+
+    /// Computes targetSf and targetPower from the history of a node
+    void       compute(NodeState* node);
+
+private:
+    NodeState _nodes[RH_ADR_MAX_NODES];
+    uint8_t   _nextNode;
+    uint8_t   _minSf;
+    uint8_t   _maxSf;
+    int8_t    _minPower;
+    int8_t    _maxPower;
+    uint8_t   _defaultSf;
+    int8_t    _defaultPower;
+};
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHAdrNode RHAdr.h <RHAdr.h>
+/// \brief Node side of adaptive data rate: applies commands from an RHAdrServer to an RH_RF95
+///
+/// Pass every message received from the gateway to handleMessage(), and the result of every
+/// acknowledged send to sendResult(). After RH_ADR_MAX_ACK_FAILURES consecutive failures the node
+/// falls back one step (more power, then a higher spreading factor) and sets RH_FLAGS_ADR on its
+/// uplinks (see uplinkFlags()) until a new command arrives.
+/// Failures only count once the gateway has been heard (an ACK or a command): a gateway that never
+/// acknowledges must not push the node to full power and the slowest spreading factor.
+class RHAdrNode
+{
+public:
+    /// Constructor.
+    /// \param[in] driver The radio to configure
+    /// \param[in] sf Initial spreading factor (7 to 12)
+    /// \param[in] power Initial transmitter power in dBm
+    /// \param[in] bw Bandwidth, which ADR does not change
+    /// \param[in] crDenominator Coding rate denominator, which ADR does not change
+    /// \param[in] maxSf Highest spreading factor the node falls back to
+    /// \param[in] maxPower Highest transmitter power the node falls back to
+    RHAdrNode(RH_RF95& driver, uint8_t sf = 7, int8_t power = 13, RH_RF95::Bandwidth bw = RH_RF95::Bw125kHz,
+	      uint8_t crDenominator = 5, uint8_t maxSf = 12, int8_t maxPower = 20);
+
+    /// Programs the initial settings into the radio. Call after the driver's init()
+    void    begin();
+
+    /// Applies a message if it is an ADR command
+    /// \param[in] buf The message
+    /// \param[in] len Length of the message
+    /// \param[in] flags The FLAGS header of the message
+    /// \return true if the message was an ADR command (and has been applied)
+    bool    handleMessage(const uint8_t* buf, uint8_t len, uint8_t flags);
+
+    /// Reports the outcome of an acknowledged send
+    /// \param[in] acknowledged true if the gateway was heard after the send (any valid downlink)
+    void    sendResult(bool acknowledged);
+
+    /// Returns the flags to set on uplinks: RH_FLAGS_ADR while a fallback is waiting for a new command
+    uint8_t uplinkFlags();
+
+    /// Returns the ID header to set on uplinks: the current settings, RH_ADR_SETTINGS(sf, power)
+    uint8_t uplinkId();
+
+    /// Returns the current spreading factor
+    uint8_t spreadingFactor();
+
+    /// Returns the current transmitter power in dBm
+    int8_t  txPower();
+
+protected:
+    /// Programs the radio with the current settings
+    void    apply();
+
+private:
+    RH_RF95&            _driver;
+    uint8_t             _sf;
+    int8_t              _power;
+    RH_RF95::Bandwidth  _bw;
+    uint8_t             _crDenominator;
+    uint8_t             _maxSf;
+    int8_t              _maxPower;
+    uint8_t             _ackFailures;
+    bool                _fallenBack;
+    bool                _gatewayHeard;
+};
+
+#endif
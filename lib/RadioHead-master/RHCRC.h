@@ -5,15 +5,189 @@
 // These routines originally derived from Arduino source code. See RHCRC.cpp
 // for copyright information
 // $Id: RHCRC.h,v 1.1 2014/06/24 02:40:12 mikem Exp $
+//
+// Table driven CRC engine Copyright (C) 2019 desplega.com
 
 #ifndef RHCRC_h
 #define RHCRC_h
 
-#include <RadioHead.h>
+// Only plain headers, so that programs that do not use RadioHead (eg gateway tools) can use the engine
+#include <stdint.h>
+#include <stddef.h>
+#if defined(__AVR__)
+ #include <avr/pgmspace.h>
+ #define RH_CRC_PROGMEM PROGMEM
+#else
+ #define RH_CRC_PROGMEM
+#endif
+
+// Hosts have the cache for slicing-by-8 tables (8 tables of 256 entries), microcontrollers use one table
+#ifndef RH_CRC_SLICE_BY_8
+ #if defined(__linux__) || defined(__APPLE__) || defined(_WIN32)
+  #define RH_CRC_SLICE_BY_8 1
+ #else
+  #define RH_CRC_SLICE_BY_8 0
+ #endif
+#endif
 
 extern uint16_t RHcrc16_update(uint16_t crc, uint8_t a);
 extern uint16_t RHcrc_xmodem_update (uint16_t crc, uint8_t data);
 extern uint16_t RHcrc_ccitt_update (uint16_t crc, uint8_t data);
 extern uint8_t  RHcrc_ibutton_update(uint8_t crc, uint8_t data);
 
+/// Compile time list of the integers I..., for building tables from a parameter pack
+template <uint16_t... I> struct RHIndices {};
+template <uint16_t N, uint16_t... I> struct RHMakeIndices : RHMakeIndices<N - 1, N - 1, I...> {};
+template <uint16_t... I> struct RHMakeIndices<0, I...> { typedef RHIndices<I...> type; };
+
+template <class Crc, uint8_t K, class Indices> struct RHCrcTable;
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHCrc RHCRC.h <RHCRC.h>
+/// \brief Table driven CRC of any width from 8 to 32 bits, polynomial and bit order.
+///
+/// The lookup tables are computed by the compiler (in PROGMEM on AVR), and only for the CRCs a program
+/// uses. On AVR one 256 entry table replaces the 8 shift and xor steps per byte of the bitwise routines.
+/// On hosts (RH_CRC_SLICE_BY_8) buffers are processed 8 octets per step with 8 tables.
+///
+/// The CRC register is passed in and returned, so the initial value and final xor are up to the caller,
+/// as with RHcrc_ccitt_update() and friends, which now use this engine:
+/// \code
+/// uint16_t crc = RHCrcCcitt::update(0xffff, buf, len);
+/// crc = RHCrcCcitt::update(crc, nextOctet);
+/// \endcode
+/// \tparam T Unsigned type holding the CRC register
+/// \tparam Width Width of the CRC in bits, a multiple of 8
+/// \tparam Poly The polynomial in normal (MSB first) form, eg 0x1021 for CCITT
+/// \tparam Reflected true if octets are processed LSB first (and Poly is applied bit reversed)
+template <typename T, uint8_t Width, T Poly, bool Reflected>
+class RHCrc
+{
+public:
+    typedef T Value;
+
+    /// Adds one octet to a CRC
+    /// \param[in] crc The CRC so far
+    /// \param[in] data The octet
+    /// \return The updated CRC
+    static T update(T crc, uint8_t data)
+    {
+	if (Reflected)
+	    return (T)(shiftOut(crc) ^ entry(0, (uint8_t)(crc ^ data)));
+	else
+	    return (T)(shiftOut(crc) ^ entry(0, (uint8_t)((crc >> (Width - 8)) ^ data)));
+    }
+
+    /// Adds a buffer to a CRC
+    /// \param[in] crc The CRC so far
+    /// \param[in] data The octets
+    /// \param[in] len Number of octets in data
+    /// \return The updated CRC
+    static T update(T crc, const uint8_t* data, size_t len)
+    {
+#if RH_CRC_SLICE_BY_8
+	for (; len >= 8; len -= 8, data += 8)
+	{
+	    // The CRC register overlays the first Width / 8 octets, in the order they are shifted out
+	    uint8_t v[8];
+	    for (uint8_t i = 0; i < 8; i++)
+		v[i] = data[i] ^ (i < Width / 8 ? (uint8_t)(crc >> (Reflected ? i * 8 : Width - 8 - i * 8)) : 0);
+	    crc = 0;
+	    for (uint8_t i = 0; i < 8; i++)
+		crc ^= entry(7 - i, v[i]);
+	}
+#endif
+	while (len--)
+	    crc = update(crc, *data++);
+	return crc;
+    }
+
+    /// Table entry: the CRC from 0 of octet i followed by k zero octets. For the table generator
+    static constexpr T slice(uint8_t k, uint16_t i)
+    {
+	return k == 0 ? steps(Reflected ? (T)i : (T)((T)i << (Width - 8)), 8) : zeroOctet(slice(k - 1, i));
+    }
+
+private:
+    static constexpr T Mask = (T)(Width == sizeof(T) * 8 ? ~(T)0 : (((T)1 << (Width % (sizeof(T) * 8))) - 1));
+
+    /// Bit reverses the low bits bits of v
+    static constexpr T reflect(T v, uint8_t bits)
+    {
+	return bits == 0 ? 0 : (T)(((v & 1) << (bits - 1)) | reflect(v >> 1, bits - 1));
+    }
+
+    /// One bitwise CRC step
+    static constexpr T step(T v)
+    {
+	return Reflected
+	    ? (T)((v & 1) ? (v >> 1) ^ reflect(Poly, Width) : v >> 1)
+	    : (T)(((v >> (Width - 1)) & 1) ? ((v << 1) ^ Poly) & Mask : (v << 1) & Mask);
+    }
+
+    static constexpr T steps(T v, uint8_t n)
+    {
+	return n == 0 ? v : steps(step(v), n - 1);
+    }
+
+    /// Shifts the octet that leaves the register out, making room for the next one
+    static constexpr T shiftOut(T crc)
+    {
+	return Width == 8 ? 0 : (T)(Reflected ? crc >> 8 : (crc << 8) & Mask);
+    }
+
+    /// Feeds a zero octet to a table entry
+    static constexpr T zeroOctet(T v)
+    {
+	return (T)(shiftOut(v) ^ steps(Reflected ? (T)(v & 0xff) : (T)((T)((v >> (Width - 8)) & 0xff) << (Width - 8)), 8));
+    }
+
+    static T entry(uint8_t k, uint8_t i)
+    {
+	const T* table = k == 0 ? RHCrcTable<RHCrc, 0, typename RHMakeIndices<256>::type>::values
+#if RH_CRC_SLICE_BY_8
+	    : k == 1 ? RHCrcTable<RHCrc, 1, typename RHMakeIndices<256>::type>::values
+	    : k == 2 ? RHCrcTable<RHCrc, 2, typename RHMakeIndices<256>::type>::values
+	    : k == 3 ? RHCrcTable<RHCrc, 3, typename RHMakeIndices<256>::type>::values
+	    : k == 4 ? RHCrcTable<RHCrc, 4, typename RHMakeIndices<256>::type>::values
+	    : k == 5 ? RHCrcTable<RHCrc, 5, typename RHMakeIndices<256>::type>::values
+	    : k == 6 ? RHCrcTable<RHCrc, 6, typename RHMakeIndices<256>::type>::values
+	    : RHCrcTable<RHCrc, 7, typename RHMakeIndices<256>::type>::values;
+#else
+	    : 0;
+#endif
+	return read(&table[i]);
+    }
+
+#if defined(__AVR__)
+    static uint8_t  read(const uint8_t* p)  { return pgm_read_byte(p); }
+    static uint16_t read(const uint16_t* p) { return pgm_read_word(p); }
+    static uint32_t read(const uint32_t* p) { return pgm_read_dword(p); }
+#else
+    static T        read(const T* p)        { return *p; }
+#endif
+};
+
+/// 256 entries of a CRC lookup table, computed by the compiler
+template <class Crc, uint8_t K, uint16_t... I>
+struct RHCrcTable<Crc, K, RHIndices<I...> >
+{
+    static const typename Crc::Value values[256];
+};
+
+template <class Crc, uint8_t K, uint16_t... I>
+const typename Crc::Value RHCrcTable<Crc, K, RHIndices<I...> >::values[256] RH_CRC_PROGMEM = { Crc::slice(K, I)... };
+
+/// CRC-16/XMODEM, as RHcrc_xmodem_update() and the telemetry frames. Start from 0
+typedef RHCrc<uint16_t, 16, 0x1021, false> RHCrcXmodem;
+
+/// CRC-16/CCITT LSB first, as RHcrc_ccitt_update(), RH_Serial and RH_ASK. Start from 0xffff
+typedef RHCrc<uint16_t, 16, 0x1021, true>  RHCrcCcitt;
+
+/// CRC-16/ARC, as RHcrc16_update()
+typedef RHCrc<uint16_t, 16, 0x8005, true>  RHCrc16;
+
+/// Dallas/Maxim 1-Wire CRC-8, as RHcrc_ibutton_update()
+typedef RHCrc<uint8_t, 8, 0x31, true>      RHCrcIbutton;
+
 #endif
@@ -0,0 +1,105 @@
+// RHChannelPlan.cpp
+//
+// Multi-channel frequency hopping and duty cycle accounting for RH_RF95
+// Copyright (C) 2019 desplega.com
+
+#include <RHChannelPlan.h>
+
+RHChannelPlan::RHChannelPlan(const Channel* channels, uint8_t numChannels, uint16_t dutyCycleDivisor, uint32_t slotLength)
+    :
+    _channels(channels),
+    _numChannels(numChannels),
+    _dutyCycleDivisor(dutyCycleDivisor ? dutyCycleDivisor : 1),
+    _slotLength(slotLength ? slotLength : 1)
+{
+    memset(_bandOffStart, 0, sizeof(_bandOffStart));
+    memset(_bandOffLength, 0, sizeof(_bandOffLength));
+    memset(_bandAirtime, 0, sizeof(_bandAirtime));
+}
+
+uint8_t RHChannelPlan::numChannels()
+{
+    return _numChannels;
+}
+
+RHChannelPlan::Channel RHChannelPlan::channel(uint8_t index)
+{
+    Channel c;
+    memcpy_P(&c, &_channels[index], sizeof(Channel));
+    if (c.band >= RH_CHANNEL_PLAN_MAX_BANDS)
+	c.band = RH_CHANNEL_PLAN_MAX_BANDS - 1;
+    return c;
+}
+
+uint32_t RHChannelPlan::slotAt(uint32_t now)
+{
+    return now / _slotLength;
+}
+
+uint8_t RHChannelPlan::hopChannel(uint8_t address, uint32_t slot)
+{
+    if (!_numChannels)
+	return RH_CHANNEL_NONE;
+    // Multiplicative hash of (slot, address): cheap on 8 bit processors, and successive
+    // slots of one node, as well as different nodes in one slot, land on unrelated channels
+    uint32_t h = (slot * 2654435761UL) ^ (address * 40503UL);
+    h ^= h >> 16;
+    return h % _numChannels;
+}
+
+bool RHChannelPlan::available(uint8_t index, uint32_t now)
+{
+    if (index >= _numChannels)
+	return false;
+    uint8_t band = channel(index).band;
+    // Unsigned elapsed time is immune to millis() wrapping
+    return now - _bandOffStart[band] >= _bandOffLength[band];
+}
+
+uint8_t RHChannelPlan::selectChannel(uint8_t address, uint32_t now)
+{
+    uint8_t hop = hopChannel(address, slotAt(now));
+    for (uint8_t i = 0; i < _numChannels; i++)
+    {
+	uint8_t index = (hop + i) % _numChannels;
+	if (available(index, now))
+	    return index;
+    }
+    return RH_CHANNEL_NONE;
+}
+
+uint32_t RHChannelPlan::offTime(uint32_t now)
+{
+    uint32_t shortest = 0xffffffff;
+    for (uint8_t i = 0; i < _numChannels; i++)
+    {
+	uint8_t band = channel(i).band;
+	uint32_t elapsed = now - _bandOffStart[band];
+	uint32_t left = elapsed >= _bandOffLength[band] ? 0 : _bandOffLength[band] - elapsed;
+	if (left < shortest)
+	    shortest = left;
+    }
+    return _numChannels ? shortest : 0;
+}
+
+void RHChannelPlan::recordTransmit(uint8_t index, uint32_t airtime, uint32_t now)
+{
+    if (index >= _numChannels)
+	return;
+    uint8_t band = channel(index).band;
+    _bandAirtime[band] += airtime;
+    // Transmitting for T at duty cycle 1/D means staying off for T * (D - 1) afterwards
+    _bandOffStart[band] = now;
+    _bandOffLength[band] = airtime * _dutyCycleDivisor;
+}
+
+uint32_t RHChannelPlan::bandAirtime(uint8_t band)
+{
+    return band < RH_CHANNEL_PLAN_MAX_BANDS ? _bandAirtime[band] : 0;
+}
+
+void RHChannelPlan::tune(RH_RF95& driver, uint8_t index)
+{
+    if (index < _numChannels)
+	driver.setFrequencyRegisters(channel(index).frf);
+}
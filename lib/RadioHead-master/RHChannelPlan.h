@@ -0,0 +1,142 @@
+// RHChannelPlan.h
+//
+// Multi-channel frequency hopping and duty cycle accounting for RH_RF95
+// Copyright (C) 2019 desplega.com
+
+#ifndef RHChannelPlan_h
+#define RHChannelPlan_h
+
+#include <RH_RF95.h>
+
+// Maximum number of regulatory sub-bands a plan can account for
+#ifndef RH_CHANNEL_PLAN_MAX_BANDS
+ #define RH_CHANNEL_PLAN_MAX_BANDS 4
+#endif
+
+// Returned by selectChannel() when every sub-band is still in its off time
+#define RH_CHANNEL_NONE 0xff
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHChannelPlan RHChannelPlan.h <RHChannelPlan.h>
+/// \brief Spreads traffic over several channels with a per node hop sequence,
+/// within the duty cycle allowed in each regulatory sub-band.
+///
+/// Time is divided into slots. In each slot, each node address maps to one channel of the plan,
+/// pseudo-randomly, so that nodes are spread over all channels and a receiver that knows the node
+/// address and the slot knows where to listen. Aggregate capacity then scales with the number of channels.
+///
+/// Regulators (eg ETSI EN 300 220 in the EU 868 MHz band) limit the duty cycle per sub-band.
+/// Each channel belongs to a sub-band, and after transmitting for T in a sub-band the sub-band is
+/// off for T * (dutyCycleDivisor - 1). If the hop channel's sub-band is off, selectChannel() picks
+/// the next channel in the plan that is available.
+///
+/// Channels are given as precomputed Frf register values, so retuning costs one SPI burst and no
+/// floating point. Build the table at compile time, and on AVR keep it in flash:
+/// \code
+/// PROGMEM static const RHChannelPlan::Channel channels[] =
+/// {
+///     { RH_RF95::frequencyToFrf(868100000), 0 },
+///     { RH_RF95::frequencyToFrf(868300000), 0 },
+///     { RH_RF95::frequencyToFrf(868500000), 0 },
+///     { RH_RF95::frequencyToFrf(869525000), 1 },
+/// };
+/// RHChannelPlan plan(channels, 4, 100, 10000); // 1% duty cycle, 10 second slots
+/// ...
+/// uint32_t airtime = RH_RF95::timeOnAirUs(len + RH_RF95_HEADER_LEN, 7, RH_RF95::Bw125kHz, 5) / 1000 + 1;
+/// uint8_t channel = plan.selectChannel(thisAddress, millis());
+/// if (channel == RH_CHANNEL_NONE)
+///     return plan.offTime(millis()); // Try again then
+/// plan.tune(driver, channel);
+/// driver.send(data, len);
+/// plan.recordTransmit(channel, airtime, millis());
+/// \endcode
+/// See examples/simulator/simulator_rf95_channel_plan for a complete example.
+class RHChannelPlan
+{
+public:
+    /// \brief One channel of a plan
+    typedef struct
+    {
+	uint32_t   frf;            ///< Centre frequency as returned by RH_RF95::frequencyToFrf()
+	uint8_t    band;           ///< Regulatory sub-band, 0 to RH_CHANNEL_PLAN_MAX_BANDS - 1
+    } Channel;
+
+    /// Constructor.
+    /// \param[in] channels Array of channels. On AVR it must be in PROGMEM. It is not copied,
+    /// so it must outlive the plan
+    /// \param[in] numChannels Number of entries in channels
+    /// \param[in] dutyCycleDivisor Reciprocal of the allowed duty cycle per sub-band, eg 100 for 1%.
+    /// 1 disables duty cycle accounting
+    /// \param[in] slotLength Length of a hop slot in milliseconds
+    RHChannelPlan(const Channel* channels, uint8_t numChannels, uint16_t dutyCycleDivisor, uint32_t slotLength);
+
+    /// Returns the number of channels in the plan
+    uint8_t  numChannels();
+
+    /// Returns the hop slot a time falls in
+    /// \param[in] now Time in milliseconds, eg from millis()
+    /// \return The slot number
+    uint32_t slotAt(uint32_t now);
+
+    /// Returns the channel a node uses in a slot, regardless of duty cycle.
+    /// Both ends of a link can compute this.
+    /// \param[in] address The node address
+    /// \param[in] slot The hop slot
+    /// \return Index of the channel
+    uint8_t  hopChannel(uint8_t address, uint32_t slot);
+
+    /// Tells whether a transmission may start on a channel now
+    /// \param[in] channel Index of the channel
+    /// \param[in] now Time in milliseconds
+    /// \return true if the channel's sub-band is not in its off time
+    bool     available(uint8_t channel, uint32_t now);
+
+    /// Picks the channel for a node to transmit on now: its hop channel if that is available,
+    /// else the next available channel in the plan.
+    /// \param[in] address The node address
+    /// \param[in] now Time in milliseconds
+    /// \return Index of the channel, or RH_CHANNEL_NONE if none is available
+    uint8_t  selectChannel(uint8_t address, uint32_t now);
+
+    /// Returns how long until selectChannel() can return a channel
+    /// \param[in] now Time in milliseconds
+    /// \return Time in milliseconds, 0 if a channel is available now
+    uint32_t offTime(uint32_t now);
+
+    /// Charges a transmission against the duty cycle of its channel's sub-band
+    /// \param[in] channel Index of the channel
+    /// \param[in] airtime Time on air of the transmission in milliseconds
+    /// \param[in] now Time in milliseconds at which the transmission started
+    void     recordTransmit(uint8_t channel, uint32_t airtime, uint32_t now);
+
+    /// Returns the total time on air charged to a sub-band since construction
+    /// \param[in] band The sub-band
+    /// \return Airtime in milliseconds
+    uint32_t bandAirtime(uint8_t band);
+
+    /// Tunes a radio to a channel
+    /// \param[in] driver The radio
+    /// \param[in] channel Index of the channel
+    void     tune(RH_RF95& driver, uint8_t channel);
+
+protected:
+    /// Reads a channel from the (possibly PROGMEM) table
+    Channel  channel(uint8_t index);
+
+private:
+    const Channel* _channels;
+    uint8_t        _numChannels;
+    uint16_t       _dutyCycleDivisor;
+    uint32_t       _slotLength;
+
+    /// millis() at which each sub-band's off time started
+    uint32_t       _bandOffStart[RH_CHANNEL_PLAN_MAX_BANDS];
+
+    /// Length of each sub-band's off time in milliseconds
+    uint32_t       _bandOffLength[RH_CHANNEL_PLAN_MAX_BANDS];
+
+    /// Total airtime charged to each sub-band
+    uint32_t       _bandAirtime[RH_CHANNEL_PLAN_MAX_BANDS];
+};
+
+#endif
@@ -0,0 +1,47 @@
+// RHClock.cpp
+//
+// Copyright (C) 2019 desplega.com
+
+#include <RHClock.h>
+
+#if (RH_PLATFORM == RH_PLATFORM_UNIX) || (RH_PLATFORM == RH_PLATFORM_RASPI)
+#include <time.h>
+
+uint32_t RHClock::micros()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint32_t RHClock::millis()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+#elif (RH_PLATFORM == RH_PLATFORM_GENERIC_AVR8) || (RH_PLATFORM == RH_PLATFORM_STM32STD) || (RH_PLATFORM == RH_PLATFORM_STM32F4_HAL)
+// No micros() here
+uint32_t RHClock::micros()
+{
+    return (uint32_t)::millis() * 1000;
+}
+
+uint32_t RHClock::millis()
+{
+    return ::millis();
+}
+
+#else
+uint32_t RHClock::micros()
+{
+    return ::micros();
+}
+
+uint32_t RHClock::millis()
+{
+    return ::millis();
+}
+
+#endif
@@ -0,0 +1,43 @@
+// RHClock.h
+//
+// Monotonic time source for the RadioHead timeouts and packet timestamps
+// Copyright (C) 2019 desplega.com
+
+#ifndef RHClock_h
+#define RHClock_h
+
+#include <RadioHead.h>
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHClock RHClock.h <RHClock.h>
+/// \brief Monotonic time in microseconds and milliseconds, for timeouts and timestamps.
+///
+/// On Linux and OSX (RH_PLATFORM_UNIX and RH_PLATFORM_RASPI) the time comes from
+/// clock_gettime(CLOCK_MONOTONIC), which NTP or the user setting the date can't make jump as
+/// gettimeofday() does. On Arduino and the other microcontroller platforms it is micros() and millis(),
+/// counted by a hardware timer (timer 0 on AVR, with a resolution of 4 microseconds at 16 MHz and
+/// 8 microseconds at 8 MHz). Platforms without micros() (RH_PLATFORM_GENERIC_AVR8,
+/// RH_PLATFORM_STM32STD, RH_PLATFORM_STM32F4_HAL) only have millisecond resolution.
+///
+/// The origin is arbitrary and the values wrap around (micros() after about 71 minutes,
+/// millis() after about 49 days), so only compare them by difference, which unsigned arithmetic
+/// keeps right across the wrap:
+/// \code
+/// uint32_t start = RHClock::micros();
+/// while (RHClock::micros() - start < timeout)
+///     ...
+/// \endcode
+/// Both can be called from interrupt handlers.
+class RHClock
+{
+public:
+    /// Returns the monotonic time in microseconds.
+    /// \return Microseconds since an arbitrary origin, modulo 2^32
+    static uint32_t micros();
+
+    /// Returns the monotonic time in milliseconds.
+    /// \return Milliseconds since an arbitrary origin, modulo 2^32
+    static uint32_t millis();
+};
+
+#endif
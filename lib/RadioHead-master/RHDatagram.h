@@ -13,7 +13,7 @@
 #define RH_MAX_MESSAGE_LEN 255
 
 /////////////////////////////////////////////////////////////////////
-/// \class RHDatagram RHDatagram.h <RHDatagram.h>
+/// \class RHDatagramT RHDatagram.h <RHDatagram.h>
 /// \brief Manager class for addressed, unreliable messages
 ///
 /// Every RHDatagram node has an 8 bit address (defaults to 0).
@@ -42,13 +42,25 @@
 /// \b FLAGS A bitmask of flags. The most significant 4 bits are reserved for use by RadioHead. The least
 /// significant 4 bits are reserved for applications.<br>
 ///
-class RHDatagram
+/// \par Static Dispatch
+///
+/// RHDatagram and the managers built on it (RHReliableDatagram, RHRouter and RHMesh) are typedefs of
+/// class templates instantiated for RHGenericDriver, so they work with any driver, through its virtual functions.
+/// A program with only one type of radio can instantiate them for its driver class instead, wrapped in
+/// RHStaticDriver so the compiler knows no subclass overrides it. Calls to the driver are then direct and can be
+/// inlined, which makes the code smaller and faster, notably in the ack wait loop of RHReliableDatagram::sendtoWait():
+/// \code
+/// RHStaticDriver<RH_RF95> driver;
+/// RHReliableDatagramT<RHStaticDriver<RH_RF95> > manager(driver, CLIENT_ADDRESS);
+/// \endcode
+template <class Driver>
+class RHDatagramT
 {
 public:
     /// Constructor. 
     /// \param[in] driver The RadioHead driver to use to transport messages.
     /// \param[in] thisAddress The address to assign to this node. Defaults to 0
-    RHDatagram(RHGenericDriver& driver, uint8_t thisAddress = 0);
+    RHDatagramT(Driver& driver, uint8_t thisAddress = 0);
 
     /// Initialise this instance and the 
     /// driver connected to it.
@@ -153,10 +165,149 @@ public:
 
 protected:
     /// The Driver we are to use
-    RHGenericDriver&        _driver;
+    Driver&                 _driver;
 
     /// The address of this node
     uint8_t         _thisAddress;
 };
 
+template <class Driver>
+RHDatagramT<Driver>::RHDatagramT(Driver& driver, uint8_t thisAddress) 
+    :
+    _driver(driver),
+    _thisAddress(thisAddress)
+{
+}
+
+////////////////////////////////////////////////////////////////////
+// Public methods
+template <class Driver>
+bool RHDatagramT<Driver>::init()
+{
+    bool ret = _driver.init();
+    if (ret)
+	setThisAddress(_thisAddress);
+    return ret;
+}
+
+template <class Driver>
+void RHDatagramT<Driver>::setThisAddress(uint8_t thisAddress)
+{
+    _driver.setThisAddress(thisAddress);
+    // Use this address in the transmitted FROM header
+    setHeaderFrom(thisAddress);
+    _thisAddress = thisAddress;
+}
+
+template <class Driver>
+bool RHDatagramT<Driver>::sendto(uint8_t* buf, uint8_t len, uint8_t address)
+{
+    setHeaderTo(address);
+    return _driver.send(buf, len);
+}
+
+template <class Driver>
+bool RHDatagramT<Driver>::recvfrom(uint8_t* buf, uint8_t* len, uint8_t* from, uint8_t* to, uint8_t* id, uint8_t* flags)
+{
+    if (_driver.recv(buf, len))
+    {
+	if (from)  *from =  headerFrom();
+	if (to)    *to =    headerTo();
+	if (id)    *id =    headerId();
+	if (flags) *flags = headerFlags();
+	return true;
+    }
+    return false;
+}
+
+template <class Driver>
+bool RHDatagramT<Driver>::available()
+{
+    return _driver.available();
+}
+
+template <class Driver>
+void RHDatagramT<Driver>::waitAvailable()
+{
+    _driver.waitAvailable();
+}
+
+template <class Driver>
+bool RHDatagramT<Driver>::waitPacketSent()
+{
+    return _driver.waitPacketSent();
+}
+
+template <class Driver>
+bool RHDatagramT<Driver>::waitPacketSent(uint16_t timeout)
+{
+    return _driver.waitPacketSent(timeout);
+}
+
+template <class Driver>
+bool RHDatagramT<Driver>::waitAvailableTimeout(uint16_t timeout)
+{
+    return _driver.waitAvailableTimeout(timeout);
+}
+
+template <class Driver>
+uint8_t RHDatagramT<Driver>::thisAddress()
+{
+    return _thisAddress;
+}
+
+template <class Driver>
+void RHDatagramT<Driver>::setHeaderTo(uint8_t to)
+{
+    _driver.setHeaderTo(to);
+}
+
+template <class Driver>
+void RHDatagramT<Driver>::setHeaderFrom(uint8_t from)
+{
+    _driver.setHeaderFrom(from);
+}
+
+template <class Driver>
+void RHDatagramT<Driver>::setHeaderId(uint8_t id)
+{
+    _driver.setHeaderId(id);
+}
+
+template <class Driver>
+void RHDatagramT<Driver>::setHeaderFlags(uint8_t set, uint8_t clear)
+{
+    _driver.setHeaderFlags(set, clear);
+}
+
+template <class Driver>
+uint8_t RHDatagramT<Driver>::headerTo()
+{
+    return _driver.headerTo();
+}
+
+template <class Driver>
+uint8_t RHDatagramT<Driver>::headerFrom()
+{
+    return _driver.headerFrom();
+}
+
+template <class Driver>
+uint8_t RHDatagramT<Driver>::headerId()
+{
+    return _driver.headerId();
+}
+
+template <class Driver>
+uint8_t RHDatagramT<Driver>::headerFlags()
+{
+    return _driver.headerFlags();
+}
+
+/// The manager for any driver, through its virtual functions
+typedef RHDatagramT<RHGenericDriver> RHDatagram;
+
+// Compiled once, in RHDatagram.cpp
+extern template class RHDatagramT<RHGenericDriver>;
+
 #endif
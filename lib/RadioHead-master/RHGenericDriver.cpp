@@ -16,7 +16,11 @@ RHGenericDriver::RHGenericDriver()
     _rxBad(0),
     _rxGood(0),
     _txGood(0),
-    _cad_timeout(0)
+    _cad(false),
+    _cad_timeout(0),
+    _pendingEvents(0),
+    _eventCallback(NULL),
+    _eventContext(NULL)
 {
 }
 
@@ -34,11 +38,11 @@ void RHGenericDriver::waitAvailable()
 
 // Blocks until a valid message is received or timeout expires
 // Return true if there is a message available
-// Works correctly even on millis() rollover
+// Works correctly even on RHClock::millis() rollover
 bool RHGenericDriver::waitAvailableTimeout(uint16_t timeout)
 {
-    unsigned long starttime = millis();
-    while ((millis() - starttime) < timeout)
+    uint32_t starttime = RHClock::millis();
+    while ((RHClock::millis() - starttime) < timeout)
     {
         if (available())
 	{
@@ -58,8 +62,8 @@ bool RHGenericDriver::waitPacketSent()
 
 bool RHGenericDriver::waitPacketSent(uint16_t timeout)
 {
-    unsigned long starttime = millis();
-    while ((millis() - starttime) < timeout)
+    uint32_t starttime = RHClock::millis();
+    while ((RHClock::millis() - starttime) < timeout)
     {
         if (_mode != RHModeTx) // Any previous transmit finished?
            return true;
@@ -79,10 +83,10 @@ bool RHGenericDriver::waitCAD()
     // DCF : BackoffTime = random() x aSlotTime
     // 100 - 1000 ms
     // 10 sec timeout
-    unsigned long t = millis();
+    uint32_t t = RHClock::millis();
     while (isChannelActive())
     {
-         if (millis() - t > _cad_timeout) 
+         if (RHClock::millis() - t > _cad_timeout) 
 	     return false;
 #if (RH_PLATFORM == RH_PLATFORM_STM32) // stdlib on STMF103 gets confused if random is redefined
 	 delay(_random(1, 10) * 100);
@@ -212,6 +216,48 @@ void RHGenericDriver::setCADTimeout(unsigned long cad_timeout)
     _cad_timeout = cad_timeout;
 }
 
+void RHGenericDriver::setEventCallback(EventCallback callback, void* context)
+{
+    _eventCallback = callback;
+    _eventContext = context;
+}
+
+uint8_t RHGenericDriver::pendingEvents()
+{
+    return _pendingEvents;
+}
+
+uint8_t RHGenericDriver::handleEvents()
+{
+    pollEvents();
+    uint8_t events;
+    // Take them in one go, so that none raised by an interrupt in between is lost
+    ATOMIC_BLOCK_START;
+    events = _pendingEvents;
+    _pendingEvents = 0;
+    ATOMIC_BLOCK_END;
+    if (events && _eventCallback)
+	_eventCallback(this, events, _eventContext);
+    return events;
+}
+
+bool RHGenericDriver::cadDetected()
+{
+    return _cad;
+}
+
+// subclasses are expected to override if they have to look for events
+void RHGenericDriver::pollEvents()
+{
+}
+
+#if (RH_PLATFORM == RH_PLATFORM_UNIX) || (RH_PLATFORM == RH_PLATFORM_RASPI)
+int RHGenericDriver::eventFd()
+{
+    return -1;
+}
+#endif
+
 #if (RH_PLATFORM == RH_PLATFORM_ARDUINO) && defined(RH_PLATFORM_ATTINY)
 // Tinycore does not have __cxa_pure_virtual, so without this we
 // get linking complaints from the default code generated for pure virtual functions
@@ -7,6 +7,7 @@
 #define RHGenericDriver_h
 
 #include <RadioHead.h>
+#include <RHClock.h>
 
 // Defines bits of the FLAGS header reserved for use by the RadioHead library and 
 // the flags available for use by applications
@@ -17,6 +18,11 @@
 // Default timeout for waitCAD() in ms
 #define RH_CAD_DEFAULT_TIMEOUT            10000
 
+// Events raised by drivers, as bits of the mask passed to the EventCallback
+#define RH_EVENT_RECEIVE                  0x01
+#define RH_EVENT_TX_DONE                  0x02
+#define RH_EVENT_CAD_DONE                 0x04
+
 /////////////////////////////////////////////////////////////////////
 /// \class RHGenericDriver RHGenericDriver.h <RHGenericDriver.h>
 /// \brief Abstract base class for a RadioHead driver.
@@ -38,6 +44,39 @@
 /// -ID A message ID, distinct (over short time scales) for each message sent by a particilar node
 /// -FLAGS A bitmask of flags. The most significant 4 bits are reserved for use by RadioHead. The least
 /// significant 4 bits are reserved for applications.
+///
+/// \par Events
+///
+/// Instead of polling available() or waitPacketSent(), an application can let the driver tell it
+/// what happened. Drivers record events as they happen: RH_EVENT_RECEIVE when a valid message
+/// is ready for recv(), RH_EVENT_TX_DONE when a message has been sent and RH_EVENT_CAD_DONE when
+/// a channel activity detection has finished (see cadDetected()). Interrupt driven drivers record them
+/// in their interrupt handler, and their MCU can sleep until the next interrupt. Polled drivers
+/// (eg RH_Serial, RH_TCP) look for them in pollEvents().
+/// handleEvents() then collects them and calls the callback set with setEventCallback() from the main loop,
+/// never from the interrupt handler, so the callback can call recv() or send():
+/// \code
+/// void onEvents(RHGenericDriver* driver, uint8_t events, void* context)
+/// {
+///     if (events & RH_EVENT_RECEIVE)
+///     {
+///         uint8_t buf[RH_RF95_MAX_MESSAGE_LEN];
+///         uint8_t len = sizeof(buf);
+///         if (driver->recv(buf, &len))
+///             ...
+///     }
+/// }
+/// ...
+/// rf95.setEventCallback(onEvents);
+/// rf95.setModeRx();
+/// while (1)
+/// {
+///     rf95.handleEvents();
+///     // Sleep until the next interrupt
+/// }
+/// \endcode
+/// On RH_PLATFORM_UNIX and RH_PLATFORM_RASPI, eventFd() gives a file descriptor to wait on with select() or epoll
+/// before calling handleEvents().
 class RHGenericDriver
 {
 public:
@@ -247,7 +286,49 @@ public:
     /// \return The number of packets successfully transmitted
     uint16_t       txGood();
 
+    /// The type of the function called by handleEvents()
+    /// \param[in] driver The driver that raised the events
+    /// \param[in] events The events raised since the last call, a mask of RH_EVENT_*
+    /// \param[in] context The context passed to setEventCallback()
+    typedef void (*EventCallback)(RHGenericDriver* driver, uint8_t events, void* context);
+
+    /// Sets the function that handleEvents() calls with the events raised by the driver.
+    /// \param[in] callback The function to call, or NULL to stop calling one
+    /// \param[in] context Passed to the callback, eg the object that handles the events
+    void           setEventCallback(EventCallback callback, void* context = NULL);
+
+    /// Returns the events raised since the last call to handleEvents(), without clearing them.
+    /// Can be used to decide whether to sleep.
+    /// \return A mask of RH_EVENT_*
+    uint8_t        pendingEvents();
+
+    /// Looks for events with pollEvents(), then clears the events raised since the last call and calls
+    /// the callback set with setEventCallback() (if any) with them.
+    /// Call it from the main loop, eg after each wake up.
+    /// \return The events passed to the callback, a mask of RH_EVENT_*, 0 if there were none
+    uint8_t        handleEvents();
+
+    /// Returns the result of the last channel activity detection, eg when RH_EVENT_CAD_DONE is raised
+    /// \return true if channel activity was detected
+    bool           cadDetected();
+
+#if (RH_PLATFORM == RH_PLATFORM_UNIX) || (RH_PLATFORM == RH_PLATFORM_RASPI)
+    /// Returns a file descriptor that becomes readable when handleEvents() may have events to report,
+    /// to wait for several drivers (or other sources) with select() or epoll.
+    /// \return The file descriptor, or -1 if the driver has none
+    virtual int    eventFd();
+#endif
+
 protected:
+    /// Records an event for the next call to handleEvents().
+    /// Can be called from an interrupt handler.
+    /// \param[in] event One of RH_EVENT_*
+    void           raiseEvent(uint8_t event) { _pendingEvents |= event; }
+
+    /// Called by handleEvents() to let polled drivers look for events.
+    /// Drivers that raise them from their interrupt handler don't need to override it.
+    virtual void   pollEvents();
+
 
     /// The current transport operating mode
     volatile RHMode     _mode;
@@ -300,9 +381,33 @@ protected:
     /// Channel activity timeout in ms
     unsigned int        _cad_timeout;
 
+    /// Events raised and not handled yet, a mask of RH_EVENT_*
+    volatile uint8_t    _pendingEvents;
+
+    /// Called by handleEvents()
+    EventCallback       _eventCallback;
+
+    /// Passed to _eventCallback
+    void*               _eventContext;
+
 private:
 
 };
 
+/////////////////////////////////////////////////////////////////////
+/// \class RHStaticDriver RHGenericDriver.h <RHGenericDriver.h>
+/// \brief A driver class that can't be subclassed, for managers that call it directly.
+///
+/// Has the constructors of Driver and nothing else. As it is final, the compiler resolves calls to
+/// its virtual functions at compile time when they are made through an RHStaticDriver (rather than an
+/// RHGenericDriver) reference, as the manager templates do when instantiated for it (see RHDatagramT).
+/// The vtable is still there, so the driver can also be passed to code that takes an RHGenericDriver.
+template <class Driver>
+class RHStaticDriver final : public Driver
+{
+public:
+    using Driver::Driver;
+};
+
 
 #endif 
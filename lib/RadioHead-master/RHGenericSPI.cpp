@@ -29,3 +29,27 @@ void RHGenericSPI::setFrequency(Frequency frequency)
     _frequency = frequency;
 }
 
+void RHGenericSPI::transferMessage(uint8_t slaveSelectPin, const Transfer* transfers, uint8_t count)
+{
+    bool selected = false;
+    for (uint8_t i = 0; i < count; i++)
+    {
+	const Transfer& t = transfers[i];
+	if (!selected && slaveSelectPin != RH_SPI_NO_SLAVE_SELECT)
+	    digitalWrite(slaveSelectPin, LOW);
+	selected = true;
+	for (uint8_t j = 0; j < t.len; j++)
+	{
+	    uint8_t val = transfer(t.tx ? t.tx[j] : 0);
+	    if (t.rx)
+		t.rx[j] = val;
+	}
+	if (t.deselect || i == count - 1)
+	{
+	    if (slaveSelectPin != RH_SPI_NO_SLAVE_SELECT)
+		digitalWrite(slaveSelectPin, HIGH);
+	    selected = false;
+	}
+    }
+}
+
@@ -9,6 +9,15 @@
 
 #include <RadioHead.h>
 
+// Slave select pin for SPI interfaces that select the slave themselves, such as RHLinuxSPI
+#define RH_SPI_NO_SLAVE_SELECT 0xff
+
+// On Linux a transfer is a system call, so the drivers hand whole messages to transferMessage().
+// Microcontrollers keep their octet by octet loops, which are cheaper than building the messages
+#if (RH_PLATFORM == RH_PLATFORM_UNIX) || (RH_PLATFORM == RH_PLATFORM_RASPI)
+ #define RH_HAVE_SPI_MESSAGES
+#endif
+
 /////////////////////////////////////////////////////////////////////
 /// \class RHGenericSPI RHGenericSPI.h <RHGenericSPI.h>
 /// \brief Base class for SPI interfaces
@@ -27,6 +36,12 @@
 /// - begin()
 /// - end() 
 /// - transfer()
+///
+/// \par Messages
+///
+/// transferMessage() sends a list of transfers with one call, which RHLinuxSPI makes one system call.
+/// RHSPIDriver and RHNRFSPIDriver use it for all their register accesses where RH_HAVE_SPI_MESSAGES
+/// is defined. The default implementation selects the slave and calls transfer() for each octet.
 class RHGenericSPI 
 {
 public:
@@ -73,6 +88,15 @@ public:
 	BitOrderLSBFirst,      ///< SPI LSB first
     } BitOrder;
 
+    /// \brief One transfer of an SPI message, see transferMessage()
+    typedef struct
+    {
+	const uint8_t* tx;       ///< Octets to send, NULL to send zeros
+	uint8_t*       rx;       ///< Where to store the octets received, NULL to discard them
+	uint8_t        len;      ///< Number of octets
+	bool           deselect; ///< Deselect the slave after this transfer, eg between two register accesses
+    } Transfer;
+
     /// Constructor
     /// Creates an instance of an abstract SPI interface.
     /// Do not use this contructor directly: you must instead use on of the concrete subclasses provided 
@@ -89,6 +113,15 @@ public:
     /// \return The octet read from SPI while the data octet was sent
     virtual uint8_t transfer(uint8_t data) = 0;
 
+    /// Transfers an SPI message: the transfers in order, with the slave selected from the start of the
+    /// first one to the end of the last one, and deselected in between after transfers marked deselect.
+    /// The default implementation drives slaveSelectPin and calls transfer(uint8_t) for each octet.
+    /// \param[in] slaveSelectPin The slave select pin, or RH_SPI_NO_SLAVE_SELECT if the interface selects
+    /// the slave itself
+    /// \param[in] transfers The transfers
+    /// \param[in] count Number of transfers
+    virtual void transferMessage(uint8_t slaveSelectPin, const Transfer* transfers, uint8_t count);
+
     /// SPI Configuration methods
     /// Enable SPI interrupts (if supported)
     /// This can be used in an SPI slave to indicate when an SPI message has been received
@@ -52,6 +52,12 @@ public:
     /// Disables the SPI bus (leaving pin modes unchanged). 
     /// Call this after you have finished using the SPI interface.
     void end();
+#elif (RH_PLATFORM == RH_PLATFORM_UNIX)
+    // The simulated bus, to whichever simulated device (eg RHSimSX1276) is selected
+    uint8_t transfer(uint8_t data) {return simulatorSpiTransfer(data);}
+    void begin(){}
+    void end(){}
+
 #else
     // not supported on ATTiny etc
     uint8_t transfer(uint8_t /*data*/) {return 0;}
@@ -0,0 +1,78 @@
+// RHManagerTraits.h
+//
+// Compile time capacities of the RHReliableDatagram, RHRouter and RHMesh managers
+// Copyright (C) 2019 desplega.com
+
+#ifndef RHManagerTraits_h
+#define RHManagerTraits_h
+
+#include <RadioHead.h>
+
+// Default max number of hops we will route
+#ifndef RH_DEFAULT_MAX_HOPS
+ #define RH_DEFAULT_MAX_HOPS 30
+#endif
+
+// The default size of the routing table we keep
+#ifndef RH_ROUTING_TABLE_SIZE
+ #define RH_ROUTING_TABLE_SIZE 10
+#endif
+
+// Timeout for address resolution in milliecs
+#ifndef RH_MESH_ARP_TIMEOUT
+ #define RH_MESH_ARP_TIMEOUT 4000
+#endif
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHDefaultTraits RHManagerTraits.h <RHManagerTraits.h>
+/// \brief The capacities of the managers, as the second template parameter of RHReliableDatagramT,
+/// RHRouterT and RHMeshT.
+///
+/// A traits class has these constants. The limits are checked with static_assert when a manager is instantiated:
+/// - seenNodes: number of nodes whose last message ID RHReliableDatagram remembers, to discard duplicates.
+///   256 keeps one octet for every address. Fewer keep 2 octets for each of the nodes heard most recently.
+///   1 to 256
+/// - routingTableSize: routes RHRouter keeps (3 octets each), the oldest one is dropped to add one to a full table.
+///   1 to 255
+/// - maxHops: default for RHRouter::setMaxHops(). At most RH_MESH_MAX_MESSAGE_LEN - 2 for RHMesh,
+///   as route discovery messages list the nodes they went through
+/// - meshArpTimeout: milliseconds RHMesh waits for the answer to a route discovery
+///
+/// RHDefaultTraits has the historical values, which can be changed with the RH_DEFAULT_MAX_HOPS,
+/// RH_ROUTING_TABLE_SIZE and RH_MESH_ARP_TIMEOUT macros. RHNodeTraits and RHGatewayTraits
+/// are for the two ends of a small network. Derive your own from any of them:
+/// \code
+/// struct MyTraits : public RHNodeTraits
+/// {
+///     static constexpr uint8_t routingTableSize = 8;
+/// };
+/// RHMeshT<RH_RF95, MyTraits> manager(driver, 3);
+/// \endcode
+struct RHDefaultTraits
+{
+    static constexpr uint16_t seenNodes = 256;
+    static constexpr uint8_t  routingTableSize = RH_ROUTING_TABLE_SIZE;
+    static constexpr uint8_t  maxHops = RH_DEFAULT_MAX_HOPS;
+    static constexpr uint16_t meshArpTimeout = RH_MESH_ARP_TIMEOUT;
+};
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHNodeTraits RHManagerTraits.h <RHManagerTraits.h>
+/// \brief Capacities for a node with 2 kbytes of SRAM that talks to a few neighbours,
+/// 22 octets of tables instead of 286.
+struct RHNodeTraits : public RHDefaultTraits
+{
+    static constexpr uint16_t seenNodes = 4;
+    static constexpr uint8_t  routingTableSize = 4;
+    static constexpr uint8_t  maxHops = 8;
+};
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHGatewayTraits RHManagerTraits.h <RHManagerTraits.h>
+/// \brief Capacities for a gateway with a route to every node address.
+struct RHGatewayTraits : public RHDefaultTraits
+{
+    static constexpr uint8_t  routingTableSize = 255;
+};
+
+#endif
@@ -15,11 +15,48 @@
 #define RH_MESH_MESSAGE_TYPE_ROUTE_DISCOVERY_RESPONSE       2
 #define RH_MESH_MESSAGE_TYPE_ROUTE_FAILURE                  3
 
-// Timeout for address resolution in milliecs
-#define RH_MESH_ARP_TIMEOUT 4000
+/////////////////////////////////////////////////////////////////////
+/// \class RHMeshTypes RHMesh.h <RHMesh.h>
+/// \brief The message types of RHMeshT, which don't depend on the driver.
+class RHMeshTypes
+{
+public:
+
+    /// The maximum length permitted for the application payload data in a RHMesh message
+    #define RH_MESH_MAX_MESSAGE_LEN (RH_ROUTER_MAX_MESSAGE_LEN - sizeof(RHMeshTypes::MeshMessageHeader))
+
+    /// Structure of the basic RHMesh header.
+    typedef struct
+    {
+	uint8_t             msgType;  ///< Type of RHMesh message, one of RH_MESH_MESSAGE_TYPE_*
+    } MeshMessageHeader;
+
+    /// Signals an application layer message for the caller of RHMesh
+    typedef struct
+    {
+	MeshMessageHeader   header; ///< msgType = RH_MESH_MESSAGE_TYPE_APPLICATION 
+	uint8_t             data[RH_MESH_MAX_MESSAGE_LEN]; ///< Application layer payload data
+    } MeshApplicationMessage;
+
+    /// Signals a route discovery request or reply (At present only supports physical dest addresses of length 1 octet)
+    typedef struct
+    {
+	MeshMessageHeader   header;  ///< msgType = RH_MESH_MESSAGE_TYPE_ROUTE_DISCOVERY_*
+	uint8_t             destlen; ///< Reserved. Must be 1.g
+	uint8_t             dest;    ///< The address of the destination node whose route is being sought
+	uint8_t             route[RH_MESH_MAX_MESSAGE_LEN - 1]; ///< List of node addresses visited so far. Length is implcit
+    } MeshRouteDiscoveryMessage;
+
+    /// Signals a route failure
+    typedef struct
+    {
+	MeshMessageHeader   header; ///< msgType = RH_MESH_MESSAGE_TYPE_ROUTE_FAILURE
+	uint8_t             dest; ///< The address of the destination towards which the route failed
+    } MeshRouteFailureMessage;
+};
 
 /////////////////////////////////////////////////////////////////////
-/// \class RHMesh RHMesh.h <RHMesh.h>
+/// \class RHMeshT RHMesh.h <RHMesh.h>
 /// \brief RHRouter subclass for sending addressed, optionally acknowledged datagrams
 /// multi-hop routed across a network, with automatic route discovery
 ///
@@ -112,46 +149,18 @@
 /// message queueing. This means that only one message at a time can be handled. Message transmission 
 /// failures can have a severe impact on network performance.
 /// If you need high performance mesh networking under all conditions consider XBee or similar.
-class RHMesh : public RHRouter
+template <class Driver, class Traits = RHDefaultTraits>
+class RHMeshT : public RHRouterT<Driver, Traits>, public RHMeshTypes
 {
-public:
+    // Route discovery messages list the nodes they went through, and the destination
+    static_assert(Traits::maxHops <= RH_MESH_MAX_MESSAGE_LEN - 2, "Traits::maxHops nodes don't fit in a route discovery message");
 
-    /// The maximum length permitted for the application payload data in a RHMesh message
-    #define RH_MESH_MAX_MESSAGE_LEN (RH_ROUTER_MAX_MESSAGE_LEN - sizeof(RHMesh::MeshMessageHeader))
-
-    /// Structure of the basic RHMesh header.
-    typedef struct
-    {
-	uint8_t             msgType;  ///< Type of RHMesh message, one of RH_MESH_MESSAGE_TYPE_*
-    } MeshMessageHeader;
-
-    /// Signals an application layer message for the caller of RHMesh
-    typedef struct
-    {
-	MeshMessageHeader   header; ///< msgType = RH_MESH_MESSAGE_TYPE_APPLICATION 
-	uint8_t             data[RH_MESH_MAX_MESSAGE_LEN]; ///< Application layer payload data
-    } MeshApplicationMessage;
-
-    /// Signals a route discovery request or reply (At present only supports physical dest addresses of length 1 octet)
-    typedef struct
-    {
-	MeshMessageHeader   header;  ///< msgType = RH_MESH_MESSAGE_TYPE_ROUTE_DISCOVERY_*
-	uint8_t             destlen; ///< Reserved. Must be 1.g
-	uint8_t             dest;    ///< The address of the destination node whose route is being sought
-	uint8_t             route[RH_MESH_MAX_MESSAGE_LEN - 1]; ///< List of node addresses visited so far. Length is implcit
-    } MeshRouteDiscoveryMessage;
-
-    /// Signals a route failure
-    typedef struct
-    {
-	MeshMessageHeader   header; ///< msgType = RH_MESH_MESSAGE_TYPE_ROUTE_FAILURE
-	uint8_t             dest; ///< The address of the destination towards which the route failed
-    } MeshRouteFailureMessage;
+public:
 
     /// Constructor. 
     /// \param[in] driver The RadioHead driver to use to transport messages.
     /// \param[in] thisAddress The address to assign to this node. Defaults to 0
-    RHMesh(RHGenericDriver& driver, uint8_t thisAddress = 0);
+    RHMeshT(Driver& driver, uint8_t thisAddress = 0);
 
     /// Sends a message to the destination node. Initialises the RHRouter message header 
     /// (the SOURCE address is set to the address of this node, HOPS to 0) and calls 
@@ -219,17 +228,17 @@ protected:
     /// Called by recvfromAck() immediately after it gets the message from RHReliableDatagram
     /// \param [in] message Pointer to the RHRouter message that was received.
     /// \param [in] messageLen Length of message in octets
-    virtual void peekAtMessage(RoutedMessage* message, uint8_t messageLen);
+    virtual void peekAtMessage(RHRouterTypes::RoutedMessage* message, uint8_t messageLen);
 
     /// Internal function that inspects messages being received and adjusts the routing table if necessary.
     /// This is virtual, which lets subclasses override or intercept the route() function.
     /// Called by sendtoWait after the message header has been filled in.
     /// \param [in] message Pointer to the RHRouter message to be sent.
     /// \param [in] messageLen Length of message in octets
-    virtual uint8_t route(RoutedMessage* message, uint8_t messageLen);
+    virtual uint8_t route(RHRouterTypes::RoutedMessage* message, uint8_t messageLen);
 
     /// Try to resolve a route for the given address. Blocks while discovering the route
-    /// which may take up to 4000 msec.
+    /// which may take up to Traits::meshArpTimeout (4000) msec.
     /// Virtual so subclasses can override.
     /// \param [in] address The physical address to resolve
     /// \return true if the address was resolved and added to the local routing table
@@ -253,6 +262,248 @@ private:
 
 };
 
+template <class Driver, class Traits>
+uint8_t RHMeshT<Driver, Traits>::_tmpMessage[RH_ROUTER_MAX_MESSAGE_LEN];
+
+////////////////////////////////////////////////////////////////////
+// Constructors
+template <class Driver, class Traits>
+RHMeshT<Driver, Traits>::RHMeshT(Driver& driver, uint8_t thisAddress) 
+    : RHRouterT<Driver, Traits>(driver, thisAddress)
+{
+}
+
+////////////////////////////////////////////////////////////////////
+// Public methods
+
+////////////////////////////////////////////////////////////////////
+// Discovers a route to the destination (if necessary), sends and 
+// waits for delivery to the next hop (but not for delivery to the final destination)
+template <class Driver, class Traits>
+uint8_t RHMeshT<Driver, Traits>::sendtoWait(uint8_t* buf, uint8_t len, uint8_t address, uint8_t flags)
+{
+    if (len > RH_MESH_MAX_MESSAGE_LEN)
+	return RH_ROUTER_ERROR_INVALID_LENGTH;
+
+    if (address != RH_BROADCAST_ADDRESS)
+    {
+	RHRouterTypes::RoutingTableEntry* route = this->getRouteTo(address);
+	if (!route && !doArp(address))
+	    return RH_ROUTER_ERROR_NO_ROUTE;
+    }
+
+    // Now have a route. Contruct an application layer message and send it via that route
+    MeshApplicationMessage* a = (MeshApplicationMessage*)&_tmpMessage;
+    a->header.msgType = RH_MESH_MESSAGE_TYPE_APPLICATION;
+    memcpy(a->data, buf, len);
+    return RHRouterT<Driver, Traits>::sendtoWait(_tmpMessage, sizeof(MeshMessageHeader) + len, address, flags);
+}
+
+////////////////////////////////////////////////////////////////////
+template <class Driver, class Traits>
+bool RHMeshT<Driver, Traits>::doArp(uint8_t address)
+{
+    // Need to discover a route
+    // Broadcast a route discovery message with nothing in it
+    MeshRouteDiscoveryMessage* p = (MeshRouteDiscoveryMessage*)&_tmpMessage;
+    p->header.msgType = RH_MESH_MESSAGE_TYPE_ROUTE_DISCOVERY_REQUEST;
+    p->destlen = 1; 
+    p->dest = address; // Who we are looking for
+    uint8_t error = RHRouterT<Driver, Traits>::sendtoWait((uint8_t*)p, sizeof(MeshMessageHeader) + 2, RH_BROADCAST_ADDRESS);
+    if (error !=  RH_ROUTER_ERROR_NONE)
+	return false;
+    
+    // Wait for a reply, which will be unicast back to us
+    // It will contain the complete route to the destination
+    uint8_t messageLen = sizeof(_tmpMessage);
+    // FIXME: timeout should be configurable
+    uint32_t starttime = RHClock::millis();
+    int32_t timeLeft;
+    while ((timeLeft = Traits::meshArpTimeout - (RHClock::millis() - starttime)) > 0)
+    {
+	if (this->waitAvailableTimeout(timeLeft))
+	{
+	    if (RHRouterT<Driver, Traits>::recvfromAck(_tmpMessage, &messageLen))
+	    {
+		if (   messageLen > 1
+		       && p->header.msgType == RH_MESH_MESSAGE_TYPE_ROUTE_DISCOVERY_RESPONSE)
+		{
+		    // Got a reply, now add the next hop to the dest to the routing table
+		    // The first hop taken is the first octet
+		    this->addRouteTo(address, this->headerFrom());
+		    return true;
+		}
+	    }
+	}
+	YIELD;
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////
+// Called by RHRouter::recvfromAck whenever a message goes past
+template <class Driver, class Traits>
+void RHMeshT<Driver, Traits>::peekAtMessage(RHRouterTypes::RoutedMessage* message, uint8_t messageLen)
+{
+    MeshMessageHeader* m = (MeshMessageHeader*)message->data;
+    if (   messageLen > 1 
+	&& m->msgType == RH_MESH_MESSAGE_TYPE_ROUTE_DISCOVERY_RESPONSE)
+    {
+	// This is a unicast RH_MESH_MESSAGE_TYPE_ROUTE_DISCOVERY_RESPONSE messages 
+	// being routed back to the originator here. Want to scrape some routing data out of the response
+	// We can find the routes to all the nodes between here and the responding node
+	MeshRouteDiscoveryMessage* d = (MeshRouteDiscoveryMessage*)message->data;
+	this->addRouteTo(d->dest, this->headerFrom());
+	uint8_t numRoutes = messageLen - sizeof(RHRouterTypes::RoutedMessageHeader) - sizeof(MeshMessageHeader) - 2;
+	uint8_t i;
+	// Find us in the list of nodes that were traversed to get to the responding node
+	for (i = 0; i < numRoutes; i++)
+	    if (d->route[i] == this->_thisAddress)
+		break;
+	i++;
+	while (i++ < numRoutes)
+	    this->addRouteTo(d->route[i], this->headerFrom());
+    }
+    else if (   messageLen > 1 
+	     && m->msgType == RH_MESH_MESSAGE_TYPE_ROUTE_FAILURE)
+    {
+	MeshRouteFailureMessage* d = (MeshRouteFailureMessage*)message->data;
+	this->deleteRouteTo(d->dest);
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+// This is called when a message is to be delivered to the next hop
+template <class Driver, class Traits>
+uint8_t RHMeshT<Driver, Traits>::route(RHRouterTypes::RoutedMessage* message, uint8_t messageLen)
+{
+    uint8_t from = this->headerFrom(); // Might get clobbered during call to superclass route()
+    uint8_t ret = RHRouterT<Driver, Traits>::route(message, messageLen);
+    if (   ret == RH_ROUTER_ERROR_NO_ROUTE
+	|| ret == RH_ROUTER_ERROR_UNABLE_TO_DELIVER)
+    {
+	// Cant deliver to the next hop. Delete the route
+	this->deleteRouteTo(message->header.dest);
+	if (message->header.source != this->_thisAddress)
+	{
+	    // This is being proxied, so tell the originator about it
+	    MeshRouteFailureMessage* p = (MeshRouteFailureMessage*)&_tmpMessage;
+	    p->header.msgType = RH_MESH_MESSAGE_TYPE_ROUTE_FAILURE;
+	    p->dest = message->header.dest; // Who you were trying to deliver to
+	    // Make sure there is a route back towards whoever sent the original message
+	    this->addRouteTo(message->header.source, from);
+	    ret = RHRouterT<Driver, Traits>::sendtoWait((uint8_t*)p, sizeof(MeshMessageHeader) + 1, message->header.source);
+	}
+    }
+    return ret;
+}
+
+////////////////////////////////////////////////////////////////////
+// Subclasses may want to override
+template <class Driver, class Traits>
+bool RHMeshT<Driver, Traits>::isPhysicalAddress(uint8_t* address, uint8_t addresslen)
+{
+    // Can only handle physical addresses 1 octet long, which is the physical node address
+    return addresslen == 1 && address[0] == this->_thisAddress;
+}
+
+////////////////////////////////////////////////////////////////////
+template <class Driver, class Traits>
+bool RHMeshT<Driver, Traits>::recvfromAck(uint8_t* buf, uint8_t* len, uint8_t* source, uint8_t* dest, uint8_t* id, uint8_t* flags)
+{     
+    uint8_t tmpMessageLen = sizeof(_tmpMessage);
+    uint8_t _source;
+    uint8_t _dest;
+    uint8_t _id;
+    uint8_t _flags;
+    if (RHRouterT<Driver, Traits>::recvfromAck(_tmpMessage, &tmpMessageLen, &_source, &_dest, &_id, &_flags))
+    {
+	MeshMessageHeader* p = (MeshMessageHeader*)&_tmpMessage;
+
+	if (   tmpMessageLen >= 1 
+	    && p->msgType == RH_MESH_MESSAGE_TYPE_APPLICATION)
+	{
+	    MeshApplicationMessage* a = (MeshApplicationMessage*)p;
+	    // Handle application layer messages, presumably for our caller
+	    if (source) *source = _source;
+	    if (dest)   *dest   = _dest;
+	    if (id)     *id     = _id;
+	    if (flags)  *flags  = _flags;
+	    uint8_t msgLen = tmpMessageLen - sizeof(MeshMessageHeader);
+	    if (*len > msgLen)
+		*len = msgLen;
+	    memcpy(buf, a->data, *len);
+	    
+	    return true;
+	}
+	else if (   _dest == RH_BROADCAST_ADDRESS 
+		 && tmpMessageLen > 1 
+		 && p->msgType == RH_MESH_MESSAGE_TYPE_ROUTE_DISCOVERY_REQUEST)
+	{
+	    MeshRouteDiscoveryMessage* d = (MeshRouteDiscoveryMessage*)p;
+	    // Handle Route discovery requests
+	    // Message is an array of node addresses the route request has already passed through
+	    // If it originally came from us, ignore it
+	    if (_source == this->_thisAddress)
+		return false;
+	    
+	    uint8_t numRoutes = tmpMessageLen - sizeof(MeshMessageHeader) - 2;
+	    uint8_t i;
+	    // Are we already mentioned?
+	    for (i = 0; i < numRoutes; i++)
+		if (d->route[i] == this->_thisAddress)
+		    return false; // Already been through us. Discard
+	    
+	    // Hasnt been past us yet, record routes back to the earlier nodes
+	    this->addRouteTo(_source, this->headerFrom()); // The originator
+	    for (i = 0; i < numRoutes; i++)
+		this->addRouteTo(d->route[i], this->headerFrom());
+	    if (isPhysicalAddress(&d->dest, d->destlen))
+	    {
+		// This route discovery is for us. Unicast the whole route back to the originator
+		// as a RH_MESH_MESSAGE_TYPE_ROUTE_DISCOVERY_RESPONSE
+		// We are certain to have a route there, because we just got it
+		d->header.msgType = RH_MESH_MESSAGE_TYPE_ROUTE_DISCOVERY_RESPONSE;
+		RHRouterT<Driver, Traits>::sendtoWait((uint8_t*)d, tmpMessageLen, _source);
+	    }
+	    else if (i < this->_max_hops)
+	    {
+		// Its for someone else, rebroadcast it, after adding ourselves to the list
+		d->route[numRoutes] = this->_thisAddress;
+		tmpMessageLen++;
+		// Have to impersonate the source
+		// REVISIT: if this fails what can we do?
+		RHRouterT<Driver, Traits>::sendtoFromSourceWait(_tmpMessage, tmpMessageLen, RH_BROADCAST_ADDRESS, _source);
+	    }
+	}
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////
+template <class Driver, class Traits>
+bool RHMeshT<Driver, Traits>::recvfromAckTimeout(uint8_t* buf, uint8_t* len, uint16_t timeout, uint8_t* from, uint8_t* to, uint8_t* id, uint8_t* flags)
+{  
+    uint32_t starttime = RHClock::millis();
+    int32_t timeLeft;
+    while ((timeLeft = timeout - (RHClock::millis() - starttime)) > 0)
+    {
+	if (this->waitAvailableTimeout(timeLeft))
+	{
+	    if (recvfromAck(buf, len, from, to, id, flags))
+		return true;
+	    YIELD;
+	}
+    }
+    return false;
+}
+
+/// The manager for any driver, through its virtual functions
+typedef RHMeshT<RHGenericDriver> RHMesh;
+
+// Compiled once, in RHMesh.cpp
+extern template class RHMeshT<RHGenericDriver>;
+
 /// @example rf22_mesh_client.pde
 /// @example rf22_mesh_server1.pde
 /// @example rf22_mesh_server2.pde
@@ -20,8 +20,11 @@ bool RHNRFSPIDriver::init()
 
     // Initialise the slave select pin
     // On Maple, this must be _after_ spi.begin
-    pinMode(_slaveSelectPin, OUTPUT);
-    digitalWrite(_slaveSelectPin, HIGH);
+    if (_slaveSelectPin != RH_SPI_NO_SLAVE_SELECT)
+    {
+	pinMode(_slaveSelectPin, OUTPUT);
+	digitalWrite(_slaveSelectPin, HIGH);
+    }
 
     delay(100);
     return true;
@@ -31,29 +34,40 @@ bool RHNRFSPIDriver::init()
 uint8_t RHNRFSPIDriver::spiCommand(uint8_t command)
 {
     uint8_t status;
+#ifdef RH_HAVE_SPI_MESSAGES
+    status = spiMessage(command, NULL, NULL, 0);
+#else
     ATOMIC_BLOCK_START;
     digitalWrite(_slaveSelectPin, LOW);
     status = _spi.transfer(command);
     digitalWrite(_slaveSelectPin, HIGH);
     ATOMIC_BLOCK_END;
+#endif
     return status;
 }
 
 uint8_t RHNRFSPIDriver::spiRead(uint8_t reg)
 {
     uint8_t val;
+#ifdef RH_HAVE_SPI_MESSAGES
+    spiMessage(reg, NULL, &val, 1);
+#else
     ATOMIC_BLOCK_START;
     digitalWrite(_slaveSelectPin, LOW);
     _spi.transfer(reg); // Send the address, discard the status
     val = _spi.transfer(0); // The written value is ignored, reg value is read
     digitalWrite(_slaveSelectPin, HIGH);
     ATOMIC_BLOCK_END;
+#endif
     return val;
 }
 
 uint8_t RHNRFSPIDriver::spiWrite(uint8_t reg, uint8_t val)
 {
     uint8_t status = 0;
+#ifdef RH_HAVE_SPI_MESSAGES
+    status = spiMessage(reg, &val, NULL, 1);
+#else
     ATOMIC_BLOCK_START;
     digitalWrite(_slaveSelectPin, LOW);
     status = _spi.transfer(reg); // Send the address
@@ -66,12 +80,16 @@ delayMicroseconds(5);
 #endif
     digitalWrite(_slaveSelectPin, HIGH);
     ATOMIC_BLOCK_END;
+#endif
     return status;
 }
 
 uint8_t RHNRFSPIDriver::spiBurstRead(uint8_t reg, uint8_t* dest, uint8_t len)
 {
     uint8_t status = 0;
+#ifdef RH_HAVE_SPI_MESSAGES
+    status = spiMessage(reg, NULL, dest, len);
+#else
     ATOMIC_BLOCK_START;
     digitalWrite(_slaveSelectPin, LOW);
     status = _spi.transfer(reg); // Send the start address
@@ -79,12 +97,16 @@ uint8_t RHNRFSPIDriver::spiBurstRead(uint8_t reg, uint8_t* dest, uint8_t len)
 	*dest++ = _spi.transfer(0);
     digitalWrite(_slaveSelectPin, HIGH);
     ATOMIC_BLOCK_END;
+#endif
     return status;
 }
 
 uint8_t RHNRFSPIDriver::spiBurstWrite(uint8_t reg, const uint8_t* src, uint8_t len)
 {
     uint8_t status = 0;
+#ifdef RH_HAVE_SPI_MESSAGES
+    status = spiMessage(reg, src, NULL, len);
+#else
     ATOMIC_BLOCK_START;
     digitalWrite(_slaveSelectPin, LOW);
     status = _spi.transfer(reg); // Send the start address
@@ -92,8 +114,25 @@ uint8_t RHNRFSPIDriver::spiBurstWrite(uint8_t reg, const uint8_t* src, uint8_t l
 	_spi.transfer(*src++);
     digitalWrite(_slaveSelectPin, HIGH);
     ATOMIC_BLOCK_END;
+#endif
+    return status;
+}
+
+#ifdef RH_HAVE_SPI_MESSAGES
+uint8_t RHNRFSPIDriver::spiMessage(uint8_t command, const uint8_t* src, uint8_t* dest, uint8_t len)
+{
+    uint8_t status;
+    RHGenericSPI::Transfer transfers[2] = 
+    {
+	{ &command, &status, 1, false },
+	{ src, dest, len, true }
+    };
+    ATOMIC_BLOCK_START;
+    _spi.transferMessage(_slaveSelectPin, transfers, len ? 2 : 1);
+    ATOMIC_BLOCK_END;
     return status;
 }
+#endif
 
 void RHNRFSPIDriver::setSlaveSelectPin(uint8_t slaveSelectPin)
 {
@@ -85,6 +85,16 @@ public:
     void setSlaveSelectPin(uint8_t slaveSelectPin);
 
 protected:
+#ifdef RH_HAVE_SPI_MESSAGES
+    /// Sends a command or register address then transfers len octets, in one SPI message
+    /// \param[in] command The command or register address
+    /// \param[in] src Octets to send after the command, NULL to send zeros
+    /// \param[in] dest Where to store the octets received after the command, NULL to discard them
+    /// \param[in] len Number of octets after the command
+    /// \return The status octet received with the command
+    uint8_t           spiMessage(uint8_t command, const uint8_t* src, uint8_t* dest, uint8_t len);
+#endif
+
     /// Reference to the RHGenericSPI instance to use to trasnfer data with teh SPI device
     RHGenericSPI&       _spi;
 
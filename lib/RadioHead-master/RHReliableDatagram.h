@@ -8,6 +8,7 @@
 #define RHReliableDatagram_h
 
 #include <RHDatagram.h>
+#include <RHManagerTraits.h>
 
 // The acknowledgement bit in the FLAGS
 // The top 4 bits of the flags are reserved for RadioHead. The lower 4 bits are reserved
@@ -21,7 +22,75 @@
 #define RH_DEFAULT_RETRIES 3
 
 /////////////////////////////////////////////////////////////////////
-/// \class RHReliableDatagram RHReliableDatagram.h <RHReliableDatagram.h>
+/// \class RHSeenIds RHReliableDatagram.h <RHReliableDatagram.h>
+/// \brief The ID of the last message received from each of up to Nodes nodes, for duplicate detection.
+///
+/// Keeps the Nodes nodes heard from most recently, ordered from the least recently heard: when full,
+/// a new node replaces the one silent for longest. A node that was dropped is heard as new,
+/// so a retransmission from it may be delivered twice, but never a new message discarded.
+template <uint16_t Nodes>
+class RHSeenIds
+{
+    static_assert(Nodes >= 1 && Nodes <= 256, "Traits::seenNodes must be 1 to 256");
+
+public:
+    RHSeenIds() : _count(0) {}
+
+    /// \return true if id is the ID of the last message received from node from
+    bool isSeen(uint8_t from, uint8_t id) const
+    {
+	for (uint8_t i = 0; i < _count; i++)
+	    if (_from[i] == from)
+		return _id[i] == id;
+	return false;
+    }
+
+    /// Records id as the ID of the last message received from node from, which becomes the most recently heard
+    void set(uint8_t from, uint8_t id)
+    {
+	uint8_t i;
+	for (i = 0; i < _count; i++)
+	    if (_from[i] == from)
+		break;
+	if (i == _count)
+	{
+	    // New node: use a free entry, or replace the least recently heard one
+	    if (_count < Nodes)
+		_count++;
+	    else
+		i = 0;
+	}
+	// Move it to the end, after the nodes heard since
+	for (; i + 1 < _count; i++)
+	{
+	    _from[i] = _from[i + 1];
+	    _id[i] = _id[i + 1];
+	}
+	_from[i] = from;
+	_id[i] = id;
+    }
+
+private:
+    uint8_t _from[Nodes];
+    uint8_t _id[Nodes];
+    uint8_t _count; // Entries in use, least recently heard first
+};
+
+/// One entry per node address, as RHReliableDatagram has always had
+template <>
+class RHSeenIds<256>
+{
+public:
+    RHSeenIds() { memset(_ids, 0, sizeof(_ids)); }
+    bool isSeen(uint8_t from, uint8_t id) const { return _ids[from] == id; }
+    void set(uint8_t from, uint8_t id) { _ids[from] = id; }
+
+private:
+    uint8_t _ids[256];
+};
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHReliableDatagramT RHReliableDatagram.h <RHReliableDatagram.h>
 /// \brief RHDatagram subclass for sending addressed, acknowledged, retransmitted datagrams.
 ///
 /// Manager class that extends RHDatagram to define addressed, reliable datagrams with acknowledgement and retransmission.
@@ -75,13 +144,14 @@
 /// to process the acknowledgement. Best practice is to use the same processors (and
 /// radios) throughout your network.
 ///
-class RHReliableDatagram : public RHDatagram
+template <class Driver, class Traits = RHDefaultTraits>
+class RHReliableDatagramT : public RHDatagramT<Driver>
 {
 public:
     /// Constructor. 
     /// \param[in] driver The RadioHead driver to use to transport messages.
     /// \param[in] thisAddress The address to assign to this node. Defaults to 0
-    RHReliableDatagram(RHGenericDriver& driver, uint8_t thisAddress = 0);
+    RHReliableDatagramT(Driver& driver, uint8_t thisAddress = 0);
 
     /// Sets the minimum retransmit timeout. If sendtoWait is waiting for an ack 
     /// longer than this time (in milliseconds), 
@@ -189,13 +259,202 @@ private:
     /// Defaults to 3
     uint8_t _retries;
 
-    /// Array of the last seen sequence number indexed by node address that sent it
+    /// The last seen sequence number of each node that sent one (of up to Traits::seenNodes nodes)
     /// It is used for duplicate detection. Duplicated messages are re-acknowledged when received 
     /// (this is generally due to lost ACKs, causing the sender to retransmit, even though we have already
     /// received that message)
-    uint8_t _seenIds[256];
+    RHSeenIds<Traits::seenNodes> _seenIds;
 };
 
+////////////////////////////////////////////////////////////////////
+// Constructors
+template <class Driver, class Traits>
+RHReliableDatagramT<Driver, Traits>::RHReliableDatagramT(Driver& driver, uint8_t thisAddress) 
+    : RHDatagramT<Driver>(driver, thisAddress)
+{
+    _retransmissions = 0;
+    _lastSequenceNumber = 0;
+    _timeout = RH_DEFAULT_TIMEOUT;
+    _retries = RH_DEFAULT_RETRIES;
+}
+
+////////////////////////////////////////////////////////////////////
+// Public methods
+template <class Driver, class Traits>
+void RHReliableDatagramT<Driver, Traits>::setTimeout(uint16_t timeout)
+{
+    _timeout = timeout;
+}
+
+////////////////////////////////////////////////////////////////////
+template <class Driver, class Traits>
+void RHReliableDatagramT<Driver, Traits>::setRetries(uint8_t retries)
+{
+    _retries = retries;
+}
+
+////////////////////////////////////////////////////////////////////
+template <class Driver, class Traits>
+uint8_t RHReliableDatagramT<Driver, Traits>::retries()
+{
+    return _retries;
+}
+
+////////////////////////////////////////////////////////////////////
+template <class Driver, class Traits>
+bool RHReliableDatagramT<Driver, Traits>::sendtoWait(uint8_t* buf, uint8_t len, uint8_t address)
+{
+    // Assemble the message
+    uint8_t thisSequenceNumber = ++_lastSequenceNumber;
+    uint8_t retries = 0;
+    while (retries++ <= _retries)
+    {
+	this->setHeaderId(thisSequenceNumber);
+	this->setHeaderFlags(RH_FLAGS_NONE, RH_FLAGS_ACK); // Clear the ACK flag
+	this->sendto(buf, len, address);
+	this->waitPacketSent();
+
+	// Never wait for ACKS to broadcasts:
+	if (address == RH_BROADCAST_ADDRESS)
+	    return true;
+
+	if (retries > 1)
+	    _retransmissions++;
+	uint32_t thisSendTime = RHClock::millis(); // Timeout does not include original transmit time
+
+	// Compute a new timeout, random between _timeout and _timeout*2
+	// This is to prevent collisions on every retransmit
+	// if 2 nodes try to transmit at the same time
+#if (RH_PLATFORM == RH_PLATFORM_RASPI) // use standard library random(), bugs in random(min, max)
+	uint16_t timeout = _timeout + (_timeout * (random() & 0xFF) / 256);
+#else
+	uint16_t timeout = _timeout + (_timeout * random(0, 256) / 256);
+#endif
+	int32_t timeLeft;
+        while ((timeLeft = timeout - (RHClock::millis() - thisSendTime)) > 0)
+	{
+	    if (this->waitAvailableTimeout(timeLeft))
+	    {
+		uint8_t from, to, id, flags;
+		if (this->recvfrom(0, 0, &from, &to, &id, &flags)) // Discards the message
+		{
+		    // Now have a message: is it our ACK?
+		    if (   from == address 
+			   && to == this->_thisAddress 
+			   && (flags & RH_FLAGS_ACK) 
+			   && (id == thisSequenceNumber))
+		    {
+			// Its the ACK we are waiting for
+			return true;
+		    }
+		    else if (   !(flags & RH_FLAGS_ACK)
+				&& _seenIds.isSeen(from, id))
+		    {
+			// This is a request we have already received. ACK it again
+			acknowledge(id, from);
+		    }
+		    // Else discard it
+		}
+	    }
+	    // Not the one we are waiting for, maybe keep waiting until timeout exhausted
+	    YIELD;
+	}
+	// Timeout exhausted, maybe retry
+	YIELD;
+    }
+    // Retries exhausted
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////
+template <class Driver, class Traits>
+bool RHReliableDatagramT<Driver, Traits>::recvfromAck(uint8_t* buf, uint8_t* len, uint8_t* from, uint8_t* to, uint8_t* id, uint8_t* flags)
+{  
+    uint8_t _from;
+    uint8_t _to;
+    uint8_t _id;
+    uint8_t _flags;
+    // Get the message before its clobbered by the ACK (shared rx and tx buffer in some drivers
+    if (this->available() && this->recvfrom(buf, len, &_from, &_to, &_id, &_flags))
+    {
+	// Never ACK an ACK
+	if (!(_flags & RH_FLAGS_ACK))
+	{
+	    // Its a normal message not an ACK
+	    if (_to ==this->_thisAddress)
+	    {
+	        // Its for this node and
+		// Its not a broadcast, so ACK it
+		// Acknowledge message with ACK set in flags and ID set to received ID
+		acknowledge(_id, _from);
+	    }
+	    // If we have not seen this message before, then we are interested in it
+	    if (!_seenIds.isSeen(_from, _id))
+	    {
+		if (from)  *from =  _from;
+		if (to)    *to =    _to;
+		if (id)    *id =    _id;
+		if (flags) *flags = _flags;
+		_seenIds.set(_from, _id);
+		return true;
+	    }
+	    // Else just re-ack it and wait for a new one
+	}
+    }
+    // No message for us available
+    return false;
+}
+
+template <class Driver, class Traits>
+bool RHReliableDatagramT<Driver, Traits>::recvfromAckTimeout(uint8_t* buf, uint8_t* len, uint16_t timeout, uint8_t* from, uint8_t* to, uint8_t* id, uint8_t* flags)
+{
+    uint32_t starttime = RHClock::millis();
+    int32_t timeLeft;
+    while ((timeLeft = timeout - (RHClock::millis() - starttime)) > 0)
+    {
+	if (this->waitAvailableTimeout(timeLeft))
+	{
+	    if (recvfromAck(buf, len, from, to, id, flags))
+		return true;
+	}
+	YIELD;
+    }
+    return false;
+}
+
+template <class Driver, class Traits>
+uint32_t RHReliableDatagramT<Driver, Traits>::retransmissions()
+{
+    return _retransmissions;
+}
+
+template <class Driver, class Traits>
+void RHReliableDatagramT<Driver, Traits>::resetRetransmissions()
+{
+    _retransmissions = 0;
+}
+ 
+template <class Driver, class Traits>
+void RHReliableDatagramT<Driver, Traits>::acknowledge(uint8_t id, uint8_t from)
+{
+    this->setHeaderId(id);
+    this->setHeaderFlags(RH_FLAGS_ACK);
+    // We would prefer to send a zero length ACK,
+    // but if an RH_RF22 receives a 0 length message with a CRC error, it will never receive
+    // a 0 length message again, until its reset, which makes everything hang :-(
+    // So we send an ACK of 1 octet
+    // REVISIT: should we send the RSSI for the information of the sender?
+    uint8_t ack = '!';
+    this->sendto(&ack, sizeof(ack), from); 
+    this->waitPacketSent();
+}
+
+/// The manager for any driver, through its virtual functions
+typedef RHReliableDatagramT<RHGenericDriver> RHReliableDatagram;
+
+// Compiled once, in RHReliableDatagram.cpp
+extern template class RHReliableDatagramT<RHGenericDriver>;
+
 /// @example rf22_reliable_datagram_client.pde
 /// @example rf22_reliable_datagram_server.pde
 
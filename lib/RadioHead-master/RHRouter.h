@@ -9,12 +9,6 @@
 
 #include <RHReliableDatagram.h>
 
-// Default max number of hops we will route
-#define RH_DEFAULT_MAX_HOPS 30
-
-// The default size of the routing table we keep
-#define RH_ROUTING_TABLE_SIZE 10
-
 // Error codes
 #define RH_ROUTER_ERROR_NONE              0
 #define RH_ROUTER_ERROR_INVALID_LENGTH    1
@@ -25,7 +19,7 @@
 
 // This size of RH_ROUTER_MAX_MESSAGE_LEN is OK for Arduino Mega, but too big for
 // Duemilanova. Size of 50 works with the sample router programs on Duemilanova.
-#define RH_ROUTER_MAX_MESSAGE_LEN (RH_MAX_MESSAGE_LEN - sizeof(RHRouter::RoutedMessageHeader))
+#define RH_ROUTER_MAX_MESSAGE_LEN (RH_MAX_MESSAGE_LEN - sizeof(RHRouterTypes::RoutedMessageHeader))
 //#define RH_ROUTER_MAX_MESSAGE_LEN 50
 
 // These allow us to define a simulated network topology for testing purposes
@@ -36,7 +30,49 @@
 //#define RH_TEST_NETWORK 4
 
 /////////////////////////////////////////////////////////////////////
-/// \class RHRouter RHRouter.h <RHRouter.h>
+/// \class RHRouterTypes RHRouter.h <RHRouter.h>
+/// \brief The message and routing table types of RHRouterT, which don't depend on the driver.
+class RHRouterTypes
+{
+public:
+
+    /// Defines the structure of the RHRouter message header, used to keep track of end-to-end delivery parameters
+    typedef struct
+    {
+	uint8_t    dest;       ///< Destination node address
+	uint8_t    source;     ///< Originator node address
+	uint8_t    hops;       ///< Hops traversed so far
+	uint8_t    id;         ///< Originator sequence number
+	uint8_t    flags;      ///< Originator flags
+	// Data follows, Length is implicit in the overall message length
+    } RoutedMessageHeader;
+
+    /// Defines the structure of a RHRouter message
+    typedef struct
+    {
+	RoutedMessageHeader header;    ///< end-to-end delivery header
+	uint8_t             data[RH_ROUTER_MAX_MESSAGE_LEN]; ///< Application payload data
+    } RoutedMessage;
+
+    /// Values for the possible states for routes
+    typedef enum
+    {
+	Invalid = 0,           ///< No valid route is known
+	Discovering,           ///< Discovering a route (not currently used)
+	Valid                  ///< Route is valid
+    } RouteState;
+
+    /// Defines an entry in the routing table
+    typedef struct
+    {
+	uint8_t      dest;      ///< Destination node address
+	uint8_t      next_hop;  ///< Send via this next hop address
+	uint8_t      state;     ///< State of this route, one of RouteState
+    } RoutingTableEntry;
+};
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHRouterT RHRouter.h <RHRouter.h>
 /// \brief RHReliableDatagram subclass for sending addressed, optionally acknowledged datagrams
 /// multi-hop routed across a network.
 ///
@@ -90,8 +126,9 @@
 /// You can also use addRouteTo() to change a route and 
 /// deleteRouteTo() to delete a route at run time. Youcan also clear the entire routing table
 ///
-/// The Routing Table has limited capacity for entries (defined by RH_ROUTING_TABLE_SIZE, which is 10)
-/// if more than RH_ROUTING_TABLE_SIZE are added, the oldest (first) one will be removed by calling 
+/// The Routing Table has limited capacity for entries (defined by Traits::routingTableSize, which is 
+/// RH_ROUTING_TABLE_SIZE, 10, by default, see RHManagerTraits.h)
+/// if more than that are added, the oldest (first) one will be removed by calling 
 /// retireOldestRoute()
 ///
 /// \par Message Format
@@ -129,52 +166,21 @@
 ///
 /// Part of the Arduino RH library for operating with HopeRF RH compatible transceivers 
 /// (see http://www.hoperf.com)
-class RHRouter : public RHReliableDatagram
+template <class Driver, class Traits = RHDefaultTraits>
+class RHRouterT : public RHReliableDatagramT<Driver, Traits>, public RHRouterTypes
 {
-public:
-
-    /// Defines the structure of the RHRouter message header, used to keep track of end-to-end delivery parameters
-    typedef struct
-    {
-	uint8_t    dest;       ///< Destination node address
-	uint8_t    source;     ///< Originator node address
-	uint8_t    hops;       ///< Hops traversed so far
-	uint8_t    id;         ///< Originator sequence number
-	uint8_t    flags;      ///< Originator flags
-	// Data follows, Length is implicit in the overall message length
-    } RoutedMessageHeader;
-
-    /// Defines the structure of a RHRouter message
-    typedef struct
-    {
-	RoutedMessageHeader header;    ///< end-to-end delivery header
-	uint8_t             data[RH_ROUTER_MAX_MESSAGE_LEN]; ///< Application payload data
-    } RoutedMessage;
-
-    /// Values for the possible states for routes
-    typedef enum
-    {
-	Invalid = 0,           ///< No valid route is known
-	Discovering,           ///< Discovering a route (not currently used)
-	Valid                  ///< Route is valid
-    } RouteState;
+    static_assert(Traits::routingTableSize >= 1 && Traits::routingTableSize <= 255, "Traits::routingTableSize must be 1 to 255");
 
-    /// Defines an entry in the routing table
-    typedef struct
-    {
-	uint8_t      dest;      ///< Destination node address
-	uint8_t      next_hop;  ///< Send via this next hop address
-	uint8_t      state;     ///< State of this route, one of RouteState
-    } RoutingTableEntry;
+public:
 
     /// Constructor. 
     /// \param[in] driver The RadioHead driver to use to transport messages.
     /// \param[in] thisAddress The address to assign to this node. Defaults to 0
-    RHRouter(RHGenericDriver& driver, uint8_t thisAddress = 0);
+    RHRouterT(Driver& driver, uint8_t thisAddress = 0);
 
     /// Initialises this instance and the radio module connected to it.
     /// Overrides the init() function in RH.
-    /// Sets max_hops to the default of RH_DEFAULT_MAX_HOPS (30)
+    /// Sets max_hops to the default of Traits::maxHops (RH_DEFAULT_MAX_HOPS, 30)
     bool init();
 
     /// Sets the max_hops to the given value
@@ -317,9 +323,323 @@ private:
     static RoutedMessage _tmpMessage;
 
     /// Local routing table
-    RoutingTableEntry    _routes[RH_ROUTING_TABLE_SIZE];
+    RoutingTableEntry    _routes[Traits::routingTableSize];
 };
 
+template <class Driver, class Traits>
+RHRouterTypes::RoutedMessage RHRouterT<Driver, Traits>::_tmpMessage;
+
+////////////////////////////////////////////////////////////////////
+// Constructors
+template <class Driver, class Traits>
+RHRouterT<Driver, Traits>::RHRouterT(Driver& driver, uint8_t thisAddress) 
+    : RHReliableDatagramT<Driver, Traits>(driver, thisAddress)
+{
+    _max_hops = Traits::maxHops;
+    clearRoutingTable();
+}
+
+////////////////////////////////////////////////////////////////////
+// Public methods
+template <class Driver, class Traits>
+bool RHRouterT<Driver, Traits>::init()
+{
+    bool ret = RHReliableDatagramT<Driver, Traits>::init();
+    if (ret)
+	_max_hops = Traits::maxHops;
+    return ret;
+}
+
+////////////////////////////////////////////////////////////////////
+template <class Driver, class Traits>
+void RHRouterT<Driver, Traits>::setMaxHops(uint8_t max_hops)
+{
+    _max_hops = max_hops;
+}
+
+////////////////////////////////////////////////////////////////////
+template <class Driver, class Traits>
+void RHRouterT<Driver, Traits>::addRouteTo(uint8_t dest, uint8_t next_hop, uint8_t state)
+{
+    uint8_t i;
+
+    // First look for an existing entry we can update
+    for (i = 0; i < Traits::routingTableSize; i++)
+    {
+	if (_routes[i].dest == dest)
+	{
+	    _routes[i].dest = dest;
+	    _routes[i].next_hop = next_hop;
+	    _routes[i].state = state;
+	    return;
+	}
+    }
+
+    // Look for an invalid entry we can use
+    for (i = 0; i < Traits::routingTableSize; i++)
+    {
+	if (_routes[i].state == Invalid)
+	{
+	    _routes[i].dest = dest;
+	    _routes[i].next_hop = next_hop;
+	    _routes[i].state = state;
+	    return;
+	}
+    }
+
+    // Need to make room for a new one
+    retireOldestRoute();
+    // Should be an invalid slot now
+    for (i = 0; i < Traits::routingTableSize; i++)
+    {
+	if (_routes[i].state == Invalid)
+	{
+	    _routes[i].dest = dest;
+	    _routes[i].next_hop = next_hop;
+	    _routes[i].state = state;
+	}
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+template <class Driver, class Traits>
+RHRouterTypes::RoutingTableEntry* RHRouterT<Driver, Traits>::getRouteTo(uint8_t dest)
+{
+    uint8_t i;
+    for (i = 0; i < Traits::routingTableSize; i++)
+	if (_routes[i].dest == dest && _routes[i].state != Invalid)
+	    return &_routes[i];
+    return NULL;
+}
+
+////////////////////////////////////////////////////////////////////
+template <class Driver, class Traits>
+void RHRouterT<Driver, Traits>::deleteRoute(uint8_t index)
+{
+    // Delete a route by copying following routes on top of it
+    memmove(&_routes[index], &_routes[index+1], 
+	   sizeof(RoutingTableEntry) * (Traits::routingTableSize - index - 1));
+    _routes[Traits::routingTableSize - 1].state = Invalid;
+}
+
+////////////////////////////////////////////////////////////////////
+template <class Driver, class Traits>
+void RHRouterT<Driver, Traits>::printRoutingTable()
+{
+#ifdef RH_HAVE_SERIAL
+    uint8_t i;
+    for (i = 0; i < Traits::routingTableSize; i++)
+    {
+	Serial.print(i, DEC);
+	Serial.print(" Dest: ");
+	Serial.print(_routes[i].dest, DEC);
+	Serial.print(" Next Hop: ");
+	Serial.print(_routes[i].next_hop, DEC);
+	Serial.print(" State: ");
+	Serial.println(_routes[i].state, DEC);
+    }
+#endif
+}
+
+////////////////////////////////////////////////////////////////////
+template <class Driver, class Traits>
+bool RHRouterT<Driver, Traits>::deleteRouteTo(uint8_t dest)
+{
+    uint8_t i;
+    for (i = 0; i < Traits::routingTableSize; i++)
+    {
+	if (_routes[i].dest == dest)
+	{
+	    deleteRoute(i);
+	    return true;
+	}
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////
+template <class Driver, class Traits>
+void RHRouterT<Driver, Traits>::retireOldestRoute()
+{
+    // We just obliterate the first in the table and clear the last
+    deleteRoute(0);
+}
+
+////////////////////////////////////////////////////////////////////
+template <class Driver, class Traits>
+void RHRouterT<Driver, Traits>::clearRoutingTable()
+{
+    uint8_t i;
+    for (i = 0; i < Traits::routingTableSize; i++)
+	_routes[i].state = Invalid;
+}
+
+
+template <class Driver, class Traits>
+uint8_t RHRouterT<Driver, Traits>::sendtoWait(uint8_t* buf, uint8_t len, uint8_t dest, uint8_t flags)
+{
+    return sendtoFromSourceWait(buf, len, dest, this->_thisAddress, flags);
+}
+
+////////////////////////////////////////////////////////////////////
+// Waits for delivery to the next hop (but not for delivery to the final destination)
+template <class Driver, class Traits>
+uint8_t RHRouterT<Driver, Traits>::sendtoFromSourceWait(uint8_t* buf, uint8_t len, uint8_t dest, uint8_t source, uint8_t flags)
+{
+    if (((uint16_t)len + sizeof(RoutedMessageHeader)) > this->_driver.maxMessageLength())
+	return RH_ROUTER_ERROR_INVALID_LENGTH;
+
+    // Construct a RH RouterMessage message
+    _tmpMessage.header.source = source;
+    _tmpMessage.header.dest = dest;
+    _tmpMessage.header.hops = 0;
+    _tmpMessage.header.id = _lastE2ESequenceNumber++;
+    _tmpMessage.header.flags = flags;
+    memcpy(_tmpMessage.data, buf, len);
+
+    return route(&_tmpMessage, sizeof(RoutedMessageHeader)+len);
+}
+
+////////////////////////////////////////////////////////////////////
+template <class Driver, class Traits>
+uint8_t RHRouterT<Driver, Traits>::route(RoutedMessage* message, uint8_t messageLen)
+{
+    // Reliably deliver it if possible. See if we have a route:
+    uint8_t next_hop = RH_BROADCAST_ADDRESS;
+    if (message->header.dest != RH_BROADCAST_ADDRESS)
+    {
+	RoutingTableEntry* route = getRouteTo(message->header.dest);
+	if (!route)
+	    return RH_ROUTER_ERROR_NO_ROUTE;
+	next_hop = route->next_hop;
+    }
+
+    if (!RHReliableDatagramT<Driver, Traits>::sendtoWait((uint8_t*)message, messageLen, next_hop))
+	return RH_ROUTER_ERROR_UNABLE_TO_DELIVER;
+
+    return RH_ROUTER_ERROR_NONE;
+}
+
+////////////////////////////////////////////////////////////////////
+// Subclasses may want to override this to peek at messages going past
+template <class Driver, class Traits>
+void RHRouterT<Driver, Traits>::peekAtMessage(RoutedMessage* message, uint8_t messageLen)
+{
+    // Default does nothing
+}
+
+////////////////////////////////////////////////////////////////////
+template <class Driver, class Traits>
+bool RHRouterT<Driver, Traits>::recvfromAck(uint8_t* buf, uint8_t* len, uint8_t* source, uint8_t* dest, uint8_t* id, uint8_t* flags)
+{  
+    uint8_t tmpMessageLen = sizeof(_tmpMessage);
+    uint8_t _from;
+    uint8_t _to;
+    uint8_t _id;
+    uint8_t _flags;
+    if (RHReliableDatagramT<Driver, Traits>::recvfromAck((uint8_t*)&_tmpMessage, &tmpMessageLen, &_from, &_to, &_id, &_flags))
+    {
+	// Here we simulate networks with limited visibility between nodes
+	// so we can test routing
+#ifdef RH_TEST_NETWORK
+	if (
+#if RH_TEST_NETWORK==1
+	    // This network looks like 1-2-3-4
+	       (this->_thisAddress == 1 && _from == 2)
+	    || (this->_thisAddress == 2 && (_from == 1 || _from == 3))
+	    || (this->_thisAddress == 3 && (_from == 2 || _from == 4))
+	    || (this->_thisAddress == 4 && _from == 3)
+	    
+#elif RH_TEST_NETWORK==2
+	       // This network looks like 1-2-4
+	       //                         | | |
+	       //                         --3--
+	       (this->_thisAddress == 1 && (_from == 2 || _from == 3))
+	    ||  this->_thisAddress == 2
+	    ||  this->_thisAddress == 3
+	    || (this->_thisAddress == 4 && (_from == 2 || _from == 3))
+
+#elif RH_TEST_NETWORK==3
+	       // This network looks like 1-2-4
+	       //                         |   |
+	       //                         --3--
+	       (this->_thisAddress == 1 && (_from == 2 || _from == 3))
+	    || (this->_thisAddress == 2 && (_from == 1 || _from == 4))
+	    || (this->_thisAddress == 3 && (_from == 1 || _from == 4))
+	    || (this->_thisAddress == 4 && (_from == 2 || _from == 3))
+
+#elif RH_TEST_NETWORK==4
+	       // This network looks like 1-2-3
+	       //                           |
+	       //                           4
+	       (this->_thisAddress == 1 && _from == 2)
+	    ||  this->_thisAddress == 2
+	    || (this->_thisAddress == 3 && _from == 2)
+	    || (this->_thisAddress == 4 && _from == 2)
+
+#endif
+)
+	{
+	    // OK
+	}
+	else
+	{
+	    return false; // Pretend we got nothing
+	}
+#endif
+
+	peekAtMessage(&_tmpMessage, tmpMessageLen);
+	// See if its for us or has to be routed
+	if (_tmpMessage.header.dest == this->_thisAddress || _tmpMessage.header.dest == RH_BROADCAST_ADDRESS)
+	{
+	    // Deliver it here
+	    if (source) *source  = _tmpMessage.header.source;
+	    if (dest)   *dest    = _tmpMessage.header.dest;
+	    if (id)     *id      = _tmpMessage.header.id;
+	    if (flags)  *flags   = _tmpMessage.header.flags;
+	    uint8_t msgLen = tmpMessageLen - sizeof(RoutedMessageHeader);
+	    if (*len > msgLen)
+		*len = msgLen;
+	    memcpy(buf, _tmpMessage.data, *len);
+	    return true; // Its for you!
+	}
+	else if (   _tmpMessage.header.dest != RH_BROADCAST_ADDRESS
+		 && _tmpMessage.header.hops++ < _max_hops)
+	{
+	    // Maybe it has to be routed to the next hop
+	    // REVISIT: if it fails due to no route or unable to deliver to the next hop, 
+	    // tell the originator. BUT HOW?
+	    route(&_tmpMessage, tmpMessageLen);
+	}
+	// Discard it and maybe wait for another
+    }
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////
+template <class Driver, class Traits>
+bool RHRouterT<Driver, Traits>::recvfromAckTimeout(uint8_t* buf, uint8_t* len, uint16_t timeout, uint8_t* source, uint8_t* dest, uint8_t* id, uint8_t* flags)
+{  
+    uint32_t starttime = RHClock::millis();
+    int32_t timeLeft;
+    while ((timeLeft = timeout - (RHClock::millis() - starttime)) > 0)
+    {
+	if (this->waitAvailableTimeout(timeLeft))
+	{
+	    if (recvfromAck(buf, len, source, dest, id, flags))
+		return true;
+	}
+	YIELD;
+    }
+    return false;
+}
+
+/// The manager for any driver, through its virtual functions
+typedef RHRouterT<RHGenericDriver> RHRouter;
+
+// Compiled once, in RHRouter.cpp
+extern template class RHRouterT<RHGenericDriver>;
+
 /// @example rf22_router_client.pde
 /// @example rf22_router_server1.pde
 /// @example rf22_router_server2.pde
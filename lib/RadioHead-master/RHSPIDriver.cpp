@@ -20,8 +20,11 @@ bool RHSPIDriver::init()
 
     // Initialise the slave select pin
     // On Maple, this must be _after_ spi.begin
-    pinMode(_slaveSelectPin, OUTPUT);
-    digitalWrite(_slaveSelectPin, HIGH);
+    if (_slaveSelectPin != RH_SPI_NO_SLAVE_SELECT)
+    {
+	pinMode(_slaveSelectPin, OUTPUT);
+	digitalWrite(_slaveSelectPin, HIGH);
+    }
 
     delay(100);
     return true;
@@ -30,30 +33,41 @@ bool RHSPIDriver::init()
 uint8_t RHSPIDriver::spiRead(uint8_t reg)
 {
     uint8_t val;
+#ifdef RH_HAVE_SPI_MESSAGES
+    spiMessage(reg & ~RH_SPI_WRITE_MASK, NULL, &val, 1);
+#else
     ATOMIC_BLOCK_START;
     digitalWrite(_slaveSelectPin, LOW);
     _spi.transfer(reg & ~RH_SPI_WRITE_MASK); // Send the address with the write mask off
     val = _spi.transfer(0); // The written value is ignored, reg value is read
     digitalWrite(_slaveSelectPin, HIGH);
     ATOMIC_BLOCK_END;
+#endif
     return val;
 }
 
 uint8_t RHSPIDriver::spiWrite(uint8_t reg, uint8_t val)
 {
     uint8_t status = 0;
+#ifdef RH_HAVE_SPI_MESSAGES
+    status = spiMessage(reg | RH_SPI_WRITE_MASK, &val, NULL, 1);
+#else
     ATOMIC_BLOCK_START;
     digitalWrite(_slaveSelectPin, LOW);
     status = _spi.transfer(reg | RH_SPI_WRITE_MASK); // Send the address with the write mask on
     _spi.transfer(val); // New value follows
     digitalWrite(_slaveSelectPin, HIGH);
     ATOMIC_BLOCK_END;
+#endif
     return status;
 }
 
 uint8_t RHSPIDriver::spiBurstRead(uint8_t reg, uint8_t* dest, uint8_t len)
 {
     uint8_t status = 0;
+#ifdef RH_HAVE_SPI_MESSAGES
+    status = spiMessage(reg & ~RH_SPI_WRITE_MASK, NULL, dest, len);
+#else
     ATOMIC_BLOCK_START;
     digitalWrite(_slaveSelectPin, LOW);
     status = _spi.transfer(reg & ~RH_SPI_WRITE_MASK); // Send the start address with the write mask off
@@ -61,12 +75,16 @@ uint8_t RHSPIDriver::spiBurstRead(uint8_t reg, uint8_t* dest, uint8_t len)
 	*dest++ = _spi.transfer(0);
     digitalWrite(_slaveSelectPin, HIGH);
     ATOMIC_BLOCK_END;
+#endif
     return status;
 }
 
 uint8_t RHSPIDriver::spiBurstWrite(uint8_t reg, const uint8_t* src, uint8_t len)
 {
     uint8_t status = 0;
+#ifdef RH_HAVE_SPI_MESSAGES
+    status = spiMessage(reg | RH_SPI_WRITE_MASK, src, NULL, len);
+#else
     ATOMIC_BLOCK_START;
     digitalWrite(_slaveSelectPin, LOW);
     status = _spi.transfer(reg | RH_SPI_WRITE_MASK); // Send the start address with the write mask on
@@ -74,8 +92,58 @@ uint8_t RHSPIDriver::spiBurstWrite(uint8_t reg, const uint8_t* src, uint8_t len)
 	_spi.transfer(*src++);
     digitalWrite(_slaveSelectPin, HIGH);
     ATOMIC_BLOCK_END;
+#endif
+    return status;
+}
+
+void RHSPIDriver::spiWriteRegisters(const uint8_t* regs, uint8_t count)
+{
+#ifdef RH_HAVE_SPI_MESSAGES
+    uint8_t out[RH_SPI_MAX_REGISTERS * 2];
+    RHGenericSPI::Transfer transfers[RH_SPI_MAX_REGISTERS];
+    while (count)
+    {
+	// Longer sequences take one message per RH_SPI_MAX_REGISTERS registers
+	uint8_t n = count < RH_SPI_MAX_REGISTERS ? count : RH_SPI_MAX_REGISTERS;
+	for (uint8_t i = 0; i < n; i++)
+	{
+	    out[i * 2] = regs[i * 2] | RH_SPI_WRITE_MASK;
+	    out[i * 2 + 1] = regs[i * 2 + 1];
+	    transfers[i].tx = out + i * 2;
+	    transfers[i].rx = NULL;
+	    transfers[i].len = 2;
+	    transfers[i].deselect = true;
+	}
+	ATOMIC_BLOCK_START;
+	_spi.transferMessage(_slaveSelectPin, transfers, n);
+	ATOMIC_BLOCK_END;
+	regs += n * 2;
+	count -= n;
+    }
+#else
+    while (count--)
+    {
+	spiWrite(regs[0], regs[1]);
+	regs += 2;
+    }
+#endif
+}
+
+#ifdef RH_HAVE_SPI_MESSAGES
+uint8_t RHSPIDriver::spiMessage(uint8_t address, const uint8_t* src, uint8_t* dest, uint8_t len)
+{
+    uint8_t status;
+    RHGenericSPI::Transfer transfers[2] = 
+    {
+	{ &address, &status, 1, false },
+	{ src, dest, len, true }
+    };
+    ATOMIC_BLOCK_START;
+    _spi.transferMessage(_slaveSelectPin, transfers, 2);
+    ATOMIC_BLOCK_END;
     return status;
 }
+#endif
 
 void RHSPIDriver::setSlaveSelectPin(uint8_t slaveSelectPin)
 {
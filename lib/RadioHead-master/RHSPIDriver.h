@@ -12,6 +12,9 @@
 // This is the bit in the SPI address that marks it as a write
 #define RH_SPI_WRITE_MASK 0x80
 
+// Max number of registers spiWriteRegisters() writes in one message. Longer sequences take several
+#define RH_SPI_MAX_REGISTERS 8
+
 class RHGenericSPI;
 
 /////////////////////////////////////////////////////////////////////
@@ -41,6 +44,7 @@ public:
     /// Constructor
     /// \param[in] slaveSelectPin The controler pin to use to select the desired SPI device. This pin will be driven LOW
     /// during SPI communications with the SPI device that uis iused by this Driver.
+    /// RH_SPI_NO_SLAVE_SELECT if the SPI interface selects the device itself (eg RHLinuxSPI).
     /// \param[in] spi Reference to the SPI interface to use. The default is to use a default built-in Hardware interface.
     RHSPIDriver(uint8_t slaveSelectPin = SS, RHGenericSPI& spi = hardware_spi);
 
@@ -77,6 +81,13 @@ public:
     ///  it may or may not be meaningfule depending on the the type of device being accessed.
     uint8_t           spiBurstWrite(uint8_t reg, const uint8_t* src, uint8_t len);
 
+    /// Writes a sequence of registers, in order, each with its own slave select.
+    /// Where RH_HAVE_SPI_MESSAGES is defined, they go to the SPI interface as one message
+    /// per RH_SPI_MAX_REGISTERS registers.
+    /// \param[in] regs count pairs of register number and value
+    /// \param[in] count Number of registers
+    void              spiWriteRegisters(const uint8_t* regs, uint8_t count);
+
     /// Set or change the pin to be used for SPI slave select.
     /// This can be called at any time to change the
     /// pin that will be used for slave select in subsquent SPI operations.
@@ -84,6 +95,16 @@ public:
     void setSlaveSelectPin(uint8_t slaveSelectPin);
 
 protected:
+#ifdef RH_HAVE_SPI_MESSAGES
+    /// Sends an address then transfers len octets, in one SPI message
+    /// \param[in] address The register address, with the write mask set for writes
+    /// \param[in] src Octets to send after the address, NULL to send zeros
+    /// \param[in] dest Where to store the octets received after the address, NULL to discard them
+    /// \param[in] len Number of octets after the address
+    /// \return The status octet received with the address
+    uint8_t           spiMessage(uint8_t address, const uint8_t* src, uint8_t* dest, uint8_t len);
+#endif
+
     /// Reference to the RHGenericSPI instance to use to transfer data with teh SPI device
     RHGenericSPI&       _spi;
 
@@ -448,6 +448,13 @@ bool RH_ASK::available()
     return _rxBufValid;
 }
 
+// The FCS is checked here rather than by the interrupt handler
+void RH_ASK::pollEvents()
+{
+    if (_rxBufFull)
+	available();
+}
+
 bool RH_ASK::recv(uint8_t* buf, uint8_t* len)
 {
     if (!available())
@@ -485,22 +492,22 @@ bool RH_ASK::send(const uint8_t* data, uint8_t len)
     if (!waitCAD()) 
 	return false;  // Check channel activity
 
+    // The CRC covers the byte count, headers and user data
+    uint8_t header[1 + RH_ASK_HEADER_LEN] = { count, _txHeaderTo, _txHeaderFrom, _txHeaderId, _txHeaderFlags };
+    crc = RHCrcCcitt::update(crc, header, sizeof(header));
+    crc = RHCrcCcitt::update(crc, data, len);
+
     // Encode the message length
-    crc = RHcrc_ccitt_update(crc, count);
     p[index++] = symbols[count >> 4];
     p[index++] = symbols[count & 0xf];
 
     // Encode the headers
-    crc = RHcrc_ccitt_update(crc, _txHeaderTo);
     p[index++] = symbols[_txHeaderTo >> 4];
     p[index++] = symbols[_txHeaderTo & 0xf];
-    crc = RHcrc_ccitt_update(crc, _txHeaderFrom);
     p[index++] = symbols[_txHeaderFrom >> 4];
     p[index++] = symbols[_txHeaderFrom & 0xf];
-    crc = RHcrc_ccitt_update(crc, _txHeaderId);
     p[index++] = symbols[_txHeaderId >> 4];
     p[index++] = symbols[_txHeaderId & 0xf];
-    crc = RHcrc_ccitt_update(crc, _txHeaderFlags);
     p[index++] = symbols[_txHeaderFlags >> 4];
     p[index++] = symbols[_txHeaderFlags & 0xf];
 
@@ -508,7 +515,6 @@ bool RH_ASK::send(const uint8_t* data, uint8_t len)
     // 2 6-bit symbols, high nybble first, low nybble second
     for (i = 0; i < len; i++)
     {
-	crc = RHcrc_ccitt_update(crc, data[i]);
 	p[index++] = symbols[data[i] >> 4];
 	p[index++] = symbols[data[i] & 0xf];
     }
@@ -695,10 +701,8 @@ uint8_t INTERRUPT_ATTR RH_ASK::symbol_6to4(uint8_t symbol)
 // since it is slow
 void RH_ASK::validateRxBuf()
 {
-    uint16_t crc = 0xffff;
     // The CRC covers the byte count, headers and user data
-    for (uint8_t i = 0; i < _rxBufLen; i++)
-	crc = RHcrc_ccitt_update(crc, _rxBuf[i]);
+    uint16_t crc = RHCrcCcitt::update(0xffff, _rxBuf, _rxBufLen);
     if (crc != 0xf0b8) // CRC when buffer and expected CRC are CRC'd
     {
 	// Reject and drop the message
@@ -718,6 +722,7 @@ void RH_ASK::validateRxBuf()
     {
 	_rxGood++;
 	_rxBufValid = true;
+	raiseEvent(RH_EVENT_RECEIVE);
     }
 }
 
@@ -822,6 +827,7 @@ void INTERRUPT_ATTR RH_ASK::transmitTimer()
 	{
 	    setModeIdle();
 	    _txGood++;
+	    raiseEvent(RH_EVENT_TX_DONE);
 	}
 	else
 	{
@@ -342,6 +342,10 @@ protected:
     /// since it is slow
     void            validateRxBuf();
 
+    /// Checks a message collected by the receiver handler with validateRxBuf(),
+    /// which raises RH_EVENT_RECEIVE if it is valid
+    virtual void    pollEvents();
+
     /// Configure bit rate in bits per second
     uint16_t        _speed;
 
@@ -446,8 +446,8 @@ bool RH_MRF89::verifyPLLLock()
     uint8_t ftpriVal = spiReadRegister(RH_MRF89_REG_0E_FTPRIREG);
     spiWriteRegister(RH_MRF89_REG_0E_FTPRIREG, ftpriVal | RH_MRF89_LSTSPLL); // Clear PLL lock bit
     setOpMode(RH_MRF89_CMOD_FS);
-    unsigned long ulStartTime = millis();
-    while ((millis() - ulStartTime < 1000))
+    uint32_t ulStartTime = RHClock::millis();
+    while ((RHClock::millis() - ulStartTime < 1000))
     {
         ftpriVal = spiReadRegister(RH_MRF89_REG_0E_FTPRIREG);
         if ((ftpriVal & RH_MRF89_LSTSPLL) != 0)
@@ -5,31 +5,38 @@
 
 #include <RH_RF95.h>
 
-// Interrupt vectors for the 3 Arduino interrupt pins
+// Interrupt vectors for the 3 Arduino interrupt pins (8 GPIO lines on Linux)
 // Each interrupt can be handled by a different instance of RH_RF95, allowing you to have
 // 2 or more LORAs per Arduino
-RH_RF95* RH_RF95::_deviceForInterrupt[RH_RF95_NUM_INTERRUPTS] = {0, 0, 0};
+RH_RF95* RH_RF95::_deviceForInterrupt[RH_RF95_NUM_INTERRUPTS] = {0};
 uint8_t RH_RF95::_interruptCount = 0; // Index into _deviceForInterrupt for next device
 
+static_assert((RH_RF95_RX_QUEUE_LENGTH & (RH_RF95_RX_QUEUE_LENGTH - 1)) == 0 && RH_RF95_RX_QUEUE_LENGTH > 0,
+	      "RH_RF95_RX_QUEUE_LENGTH must be a power of 2");
+
 // These are indexed by the values of ModemConfigChoice
 // Stored in flash (program) memory to save SRAM
-PROGMEM static const RH_RF95::ModemConfig MODEM_CONFIG_TABLE[] =
+// Built at compile time, so LowDataRateOptimize is set where the symbol time requires it
+PROGMEM static constexpr RH_RF95::ModemConfig MODEM_CONFIG_TABLE[] =
 {
-    //  1d,     1e,      26
-    { 0x72,   0x74,    0x00}, // Bw125Cr45Sf128 (the chip default)
-    { 0x92,   0x74,    0x00}, // Bw500Cr45Sf128
-    { 0x48,   0x94,    0x00}, // Bw31_25Cr48Sf512
-    { 0x78,   0xc4,    0x00}, // Bw125Cr48Sf4096
+    //                   sf  bandwidth             cr
+    RH_RF95::modemConfig( 7, RH_RF95::Bw125kHz,    5), // Bw125Cr45Sf128 (the chip default)
+    RH_RF95::modemConfig( 7, RH_RF95::Bw500kHz,    5), // Bw500Cr45Sf128
+    RH_RF95::modemConfig( 9, RH_RF95::Bw31_25kHz,  8), // Bw31_25Cr48Sf512
+    RH_RF95::modemConfig(12, RH_RF95::Bw125kHz,    8), // Bw125Cr48Sf4096
     
 };
 
 RH_RF95::RH_RF95(uint8_t slaveSelectPin, uint8_t interruptPin, RHGenericSPI& spi)
     :
     RHSPIDriver(slaveSelectPin, spi),
-    _rxBufValid(0)
+    _rxHead(0),
+    _rxTail(0),
+    _usingHFport(false)
 {
     _interruptPin = interruptPin;
     _myInterruptIndex = 0xff; // Not allocated yet
+    memset(&_lastPacketInfo, 0, sizeof(_lastPacketInfo));
 }
 
 bool RH_RF95::init()
@@ -71,20 +78,13 @@ bool RH_RF95::init()
     if (_myInterruptIndex == 0xff)
     {
 	// First run, no interrupt allocated yet
-	if (_interruptCount <= RH_RF95_NUM_INTERRUPTS)
+	if (_interruptCount < RH_RF95_NUM_INTERRUPTS)
 	    _myInterruptIndex = _interruptCount++;
 	else
 	    return false; // Too many devices, not enough interrupt vectors
     }
     _deviceForInterrupt[_myInterruptIndex] = this;
-    if (_myInterruptIndex == 0)
-	attachInterrupt(interruptNumber, isr0, RISING);
-    else if (_myInterruptIndex == 1)
-	attachInterrupt(interruptNumber, isr1, RISING);
-    else if (_myInterruptIndex == 2)
-	attachInterrupt(interruptNumber, isr2, RISING);
-    else
-	return false; // Too many devices, not enough interrupt vectors
+    attachInterrupt(interruptNumber, _isrs[_myInterruptIndex], RISING);
 
     // Set up FIFO
     // We configure so that we can use the entire 256 byte FIFO for either receive
@@ -128,29 +128,65 @@ void RH_RF95::handleInterrupt()
     }
     else if (_mode == RHModeRx && irq_flags & RH_RF95_RX_DONE)
     {
-	// Have received a packet
-	uint8_t len = spiRead(RH_RF95_REG_13_RX_NB_BYTES);
-
-	// Reset the fifo read ptr to the beginning of the packet
-	spiWrite(RH_RF95_REG_0D_FIFO_ADDR_PTR, spiRead(RH_RF95_REG_10_FIFO_RX_CURRENT_ADDR));
-	spiBurstRead(RH_RF95_REG_00_FIFO, _buf, len);
-	_bufLen = len;
-	spiWrite(RH_RF95_REG_12_IRQ_FLAGS, 0xff); // Clear all IRQ flags
-
-	// Remember the RSSI of this packet
-	// this is according to the doc, but is it really correct?
-	// weakest receiveable signals are reported RSSI at about -66
-	_lastRssi = spiRead(RH_RF95_REG_1A_PKT_RSSI_VALUE) - 137;
-
-	// We have received a message.
-	validateRxBuf(); 
-	if (_rxBufValid)
-	    setModeIdle(); // Got one 
+	// Have received a packet. It goes in the next free slot of the queue, which recv()
+	// collects without disabling interrupts.
+	// The receiver is stopped when the queue fills, so it is only full here if available()
+	// restarted it just before we filled the queue. Then the packet is dropped
+	uint8_t head = _rxHead;
+	if ((uint8_t)(head - _rxTail) < RH_RF95_RX_QUEUE_LENGTH)
+	{
+	    RH_MEMORY_BARRIER; // recv() has finished with the slot we saw it hand back
+	    RxSlot* slot = &_rxQueue[head % RH_RF95_RX_QUEUE_LENGTH];
+	    slot->info.timestampUs = RHClock::micros();
+	    uint8_t len = spiRead(RH_RF95_REG_13_RX_NB_BYTES);
+
+	    // Reset the fifo read ptr to the beginning of the packet
+	    spiWrite(RH_RF95_REG_0D_FIFO_ADDR_PTR, spiRead(RH_RF95_REG_10_FIFO_RX_CURRENT_ADDR));
+	    spiBurstRead(RH_RF95_REG_00_FIFO, slot->buf, len);
+	    slot->len = len;
+	    spiWrite(RH_RF95_REG_12_IRQ_FLAGS, 0xff); // Clear all IRQ flags
+
+	    // Remember the SNR and RSSI of this packet. They are adjacent, so read both in one burst.
+	    // Per the SX1276/77/78/79 datasheet section 5.5.5, below the noise floor the packet
+	    // RSSI must be corrected with the SNR
+	    uint8_t quality[2];
+	    spiBurstRead(RH_RF95_REG_19_PKT_SNR_VALUE, quality, sizeof(quality));
+	    slot->info.snr = (int8_t)quality[0];
+	    int16_t rssi = quality[1];
+	    if (slot->info.snr < 0)
+		rssi += slot->info.snr / 4;
+	    else
+		rssi = rssi * 16 / 15;
+	    rssi -= _usingHFport ? 157 : 164;
+	    slot->info.rssi = rssi;
+
+	    // Keep the raw frequency error, recv() converts it to Hz outside the interrupt
+	    uint8_t fei[3];
+	    spiBurstRead(RH_RF95_REG_28_FEI_MSB, fei, sizeof(fei));
+	    slot->info.frequencyError = ((int32_t)(fei[0] & 0x0f) << 16) | ((uint16_t)fei[1] << 8) | fei[2];
+
+	    // We have received a message.
+	    if (validateRxBuf(slot->buf, len))
+	    {
+		RH_MEMORY_BARRIER; // The slot is complete before recv() can see it
+		_rxHead = ++head;
+		if ((uint8_t)(head - _rxTail) == RH_RF95_RX_QUEUE_LENGTH)
+		    setModeIdle(); // No room for another until recv() collects one
+		raiseEvent(RH_EVENT_RECEIVE);
+	    }
+	}
     }
     else if (_mode == RHModeTx && irq_flags & RH_RF95_TX_DONE)
     {
 	_txGood++;
 	setModeIdle();
+	raiseEvent(RH_EVENT_TX_DONE);
+    }
+    else if (_mode == RHModeCad && irq_flags & RH_RF95_CAD_DONE)
+    {
+	_cad = irq_flags & RH_RF95_CAD_DETECTED;
+	setModeIdle();
+	raiseEvent(RH_EVENT_CAD_DONE);
     }
     
     spiWrite(RH_RF95_REG_12_IRQ_FLAGS, 0xff); // Clear all IRQ flags
@@ -159,89 +195,138 @@ void RH_RF95::handleInterrupt()
 // These are low level functions that call the interrupt handler for the correct
 // instance of RH_RF95.
 // 3 interrupts allows us to have 3 different devices
-void RH_RF95::isr0()
+template <uint8_t index>
+void RH_RF95::isr()
 {
-    if (_deviceForInterrupt[0])
-	_deviceForInterrupt[0]->handleInterrupt();
+    if (_deviceForInterrupt[index])
+	_deviceForInterrupt[index]->handleInterrupt();
 }
-void RH_RF95::isr1()
+
+static_assert(RH_RF95_NUM_INTERRUPTS == 3 || RH_RF95_NUM_INTERRUPTS == 8,
+	      "RH_RF95_NUM_INTERRUPTS must be 3 or 8, the sizes _isrs is written for");
+
+void (* const RH_RF95::_isrs[RH_RF95_NUM_INTERRUPTS])() =
+{
+    isr<0>, isr<1>, isr<2>,
+#if RH_RF95_NUM_INTERRUPTS > 3
+    isr<3>, isr<4>, isr<5>, isr<6>, isr<7>
+#endif
+};
+
+#if (RH_PLATFORM == RH_PLATFORM_RASPI)
+int RH_RF95::eventFd()
 {
-    if (_deviceForInterrupt[1])
-	_deviceForInterrupt[1]->handleInterrupt();
+    return gpioInterruptFd();
 }
-void RH_RF95::isr2()
+
+void RH_RF95::pollEvents()
 {
-    if (_deviceForInterrupt[2])
-	_deviceForInterrupt[2]->handleInterrupt();
+    gpioServiceInterrupts(0);
 }
+#endif
 
-// Check whether the latest received message is complete and uncorrupted
-void RH_RF95::validateRxBuf()
+// Check whether a received message is complete and addressed to us
+bool RH_RF95::validateRxBuf(const uint8_t* buf, uint8_t len)
 {
-    if (_bufLen < 4)
-	return; // Too short to be a real message
-    // Extract the 4 headers
-    _rxHeaderTo    = _buf[0];
-    _rxHeaderFrom  = _buf[1];
-    _rxHeaderId    = _buf[2];
-    _rxHeaderFlags = _buf[3];
+    if (len < RH_RF95_HEADER_LEN)
+	return false; // Too short to be a real message
     if (_promiscuous ||
-	_rxHeaderTo == _thisAddress ||
-	_rxHeaderTo == RH_BROADCAST_ADDRESS)
+	buf[0] == _thisAddress ||
+	buf[0] == RH_BROADCAST_ADDRESS)
     {
 	_rxGood++;
-	_rxBufValid = true;
+	return true;
     }
+    return false;
 }
 
 bool RH_RF95::available()
 {
     if (_mode == RHModeTx)
 	return false;
-    setModeRx();
-    return _rxBufValid; // Will be set by the interrupt handler when a good message is received
+    uint8_t queued = _rxHead - _rxTail; // Queued by the interrupt handler when good messages are received
+    if (queued < RH_RF95_RX_QUEUE_LENGTH)
+	setModeRx();
+    return queued != 0;
 }
 
 void RH_RF95::clearRxBuf()
 {
-    ATOMIC_BLOCK_START;
-    _rxBufValid = false;
-    _bufLen = 0;
-    ATOMIC_BLOCK_END;
+    _rxTail = _rxHead;
 }
 
 bool RH_RF95::recv(uint8_t* buf, uint8_t* len)
 {
     if (!available())
 	return false;
+    uint8_t tail = _rxTail;
+    RH_MEMORY_BARRIER; // available() saw _rxHead move past the slot, so it is complete
+    const RxSlot* slot = &_rxQueue[tail % RH_RF95_RX_QUEUE_LENGTH];
+    _rxHeaderTo    = slot->buf[0];
+    _rxHeaderFrom  = slot->buf[1];
+    _rxHeaderId    = slot->buf[2];
+    _rxHeaderFlags = slot->buf[3];
     if (buf && len)
     {
-	ATOMIC_BLOCK_START;
-	// Skip the 4 headers that are at the beginning of the rxBuf
-	if (*len > _bufLen-RH_RF95_HEADER_LEN)
-	    *len = _bufLen-RH_RF95_HEADER_LEN;
-	memcpy(buf, _buf+RH_RF95_HEADER_LEN, *len);
-	ATOMIC_BLOCK_END;
+	// Skip the 4 headers that are at the beginning of the slot
+	if (*len > slot->len-RH_RF95_HEADER_LEN)
+	    *len = slot->len-RH_RF95_HEADER_LEN;
+	memcpy(buf, slot->buf+RH_RF95_HEADER_LEN, *len);
     }
-    clearRxBuf(); // This message accepted and cleared
+    _lastPacketInfo = slot->info;
+    RH_MEMORY_BARRIER; // Done with the slot before handing it back
+    _rxTail = tail + 1; // This message accepted and cleared
+    setModeRx(); // The interrupt handler stops the receiver on a full queue, and there is room now
+    _lastRssi = _lastPacketInfo.rssi;
+
+    // Frequency error is a signed 20 bit value.
+    // Ferr = FreqError * 2^24 / Fxosc * Bw / 500 kHz, per the SX1276/77/78/79 datasheet section 4.1.5
+    int32_t fei = _lastPacketInfo.frequencyError;
+    if (fei & 0x80000)
+	fei -= 0x100000;
+    uint8_t bw = spiRead(RH_RF95_REG_1D_MODEM_CONFIG1) >> 4;
+    if (bw > Bw500kHz)
+	bw = Bw500kHz;
+    _lastPacketInfo.frequencyError = ((int64_t)fei * bandwidthHz((Bandwidth)bw) << 24) / ((int64_t)RH_RF95_FXOSC * 500000);
     return true;
 }
 
+int8_t RH_RF95::lastSNR()
+{
+    return _lastPacketInfo.snr / 4;
+}
+
+int32_t RH_RF95::frequencyError()
+{
+    return _lastPacketInfo.frequencyError;
+}
+
+const RH_RF95::PacketInfo& RH_RF95::lastPacketInfo()
+{
+    return _lastPacketInfo;
+}
+
 bool RH_RF95::send(const uint8_t* data, uint8_t len)
 {
     if (len > RH_RF95_MAX_MESSAGE_LEN)
 	return false;
 
     waitPacketSent(); // Make sure we dont interrupt an outgoing message
+    // Check channel activity
+    if (!waitCAD())
+	return false;
     setModeIdle();
 
-    // Position at the beginning of the FIFO
-    spiWrite(RH_RF95_REG_0D_FIFO_ADDR_PTR, 0);
-    // The headers
-    spiWrite(RH_RF95_REG_00_FIFO, _txHeaderTo);
-    spiWrite(RH_RF95_REG_00_FIFO, _txHeaderFrom);
-    spiWrite(RH_RF95_REG_00_FIFO, _txHeaderId);
-    spiWrite(RH_RF95_REG_00_FIFO, _txHeaderFlags);
+    // Position at the beginning of the FIFO, then the headers
+    uint8_t regs[] =
+    {
+	RH_RF95_REG_0D_FIFO_ADDR_PTR, 0,
+	RH_RF95_REG_00_FIFO,          _txHeaderTo,
+	RH_RF95_REG_00_FIFO,          _txHeaderFrom,
+	RH_RF95_REG_00_FIFO,          _txHeaderId,
+	RH_RF95_REG_00_FIFO,          _txHeaderFlags
+    };
+    spiWriteRegisters(regs, sizeof(regs) / 2);
     // The message data
     spiBurstWrite(RH_RF95_REG_00_FIFO, data, len);
     spiWrite(RH_RF95_REG_22_PAYLOAD_LENGTH, len + RH_RF95_HEADER_LEN);
@@ -276,13 +361,19 @@ bool RH_RF95::setFrequency(float centre)
 {
     // Frf = FRF / FSTEP
     uint32_t frf = (centre * 1000000.0) / RH_RF95_FSTEP;
-    spiWrite(RH_RF95_REG_06_FRF_MSB, (frf >> 16) & 0xff);
-    spiWrite(RH_RF95_REG_07_FRF_MID, (frf >> 8) & 0xff);
-    spiWrite(RH_RF95_REG_08_FRF_LSB, frf & 0xff);
+    setFrequencyRegisters(frf);
 
     return true;
 }
 
+void RH_RF95::setFrequencyRegisters(uint32_t frf)
+{
+    // FRF_MSB, FRF_MID and FRF_LSB are consecutive. The new frequency takes effect when FRF_LSB is written
+    uint8_t regs[3] = { (uint8_t)(frf >> 16), (uint8_t)(frf >> 8), (uint8_t)frf };
+    spiBurstWrite(RH_RF95_REG_06_FRF_MSB, regs, sizeof(regs));
+    _usingHFport = (frf >= frequencyToFrf(RH_RF95_HF_PORT_MIN_FREQUENCY * 1000000));
+}
+
 void RH_RF95::setModeIdle()
 {
     if (_mode != RHModeIdle)
@@ -306,8 +397,12 @@ void RH_RF95::setModeRx()
 {
     if (_mode != RHModeRx)
     {
-	spiWrite(RH_RF95_REG_01_OP_MODE, RH_RF95_MODE_RXCONTINUOUS);
-	spiWrite(RH_RF95_REG_40_DIO_MAPPING1, 0x00); // Interrupt on RxDone
+	static const uint8_t regs[] =
+	{
+	    RH_RF95_REG_01_OP_MODE,      RH_RF95_MODE_RXCONTINUOUS,
+	    RH_RF95_REG_40_DIO_MAPPING1, 0x00 // Interrupt on RxDone
+	};
+	spiWriteRegisters(regs, sizeof(regs) / 2);
 	_mode = RHModeRx;
     }
 }
@@ -316,12 +411,38 @@ void RH_RF95::setModeTx()
 {
     if (_mode != RHModeTx)
     {
-	spiWrite(RH_RF95_REG_01_OP_MODE, RH_RF95_MODE_TX);
-	spiWrite(RH_RF95_REG_40_DIO_MAPPING1, 0x40); // Interrupt on TxDone
+	static const uint8_t regs[] =
+	{
+	    RH_RF95_REG_01_OP_MODE,      RH_RF95_MODE_TX,
+	    RH_RF95_REG_40_DIO_MAPPING1, 0x40 // Interrupt on TxDone
+	};
+	spiWriteRegisters(regs, sizeof(regs) / 2);
 	_mode = RHModeTx;
     }
 }
 
+void RH_RF95::setModeCad()
+{
+    if (_mode != RHModeCad)
+    {
+	static const uint8_t regs[] =
+	{
+	    RH_RF95_REG_40_DIO_MAPPING1, 0x80, // Interrupt on CadDone
+	    RH_RF95_REG_01_OP_MODE,      RH_RF95_MODE_CAD
+	};
+	spiWriteRegisters(regs, sizeof(regs) / 2);
+	_mode = RHModeCad;
+    }
+}
+
+bool RH_RF95::isChannelActive()
+{
+    setModeCad();
+    while (_mode == RHModeCad)
+	YIELD;
+    return _cad;
+}
+
 void RH_RF95::setTxPower(int8_t power, bool useRFO)
 {
     // Sigh, different behaviours depending on whther the module use PA_BOOST or the RFO pin
@@ -381,6 +502,7 @@ void RH_RF95::setSpreadingFactor(int8_t sf)
   }
 
   spiWrite(RH_RF95_REG_1E_MODEM_CONFIG2, (spiRead(RH_RF95_REG_1E_MODEM_CONFIG2) & 0x0f) | ((sf << 4) & 0xf0));
+  setLowDatarate();
 }
 
 void RH_RF95::setSignalBandwidth(long sbw)
@@ -410,6 +532,19 @@ void RH_RF95::setSignalBandwidth(long sbw)
   }
 
   spiWrite(RH_RF95_REG_1D_MODEM_CONFIG1, (spiRead(RH_RF95_REG_1D_MODEM_CONFIG1) & 0x0f) | (bw << 4));
+  setLowDatarate();
+}
+
+// Semtech AN1200.13: the LowDataRateOptimize bit compensates for reference oscillator
+// drift over long symbols. It is mandatory once the symbol time exceeds 16 ms.
+void RH_RF95::setLowDatarate()
+{
+    uint8_t bw = spiRead(RH_RF95_REG_1D_MODEM_CONFIG1) >> 4; // Bw is in bits 7..4
+    uint8_t sf = spiRead(RH_RF95_REG_1E_MODEM_CONFIG2) >> 4; // Sf is in bits 7..4
+    uint8_t reg_26 = spiRead(RH_RF95_REG_26_MODEM_CONFIG3) & ~RH_RF95_LOW_DATA_RATE_OPTIMIZE;
+    if (bw <= Bw500kHz && lowDataRateOptimizeRequired(sf, (Bandwidth)bw))
+	reg_26 |= RH_RF95_LOW_DATA_RATE_OPTIMIZE;
+    spiWrite(RH_RF95_REG_26_MODEM_CONFIG3, reg_26);
 }
 
 void RH_RF95::setCodingRate4(int8_t denominator)
@@ -432,9 +567,20 @@ void RH_RF95::setSyncWord(int sw)
 // Sets registers from a canned modem configuration structure
 void RH_RF95::setModemRegisters(const ModemConfig* config)
 {
-    spiWrite(RH_RF95_REG_1D_MODEM_CONFIG1,       config->reg_1d);
-    spiWrite(RH_RF95_REG_1E_MODEM_CONFIG2,       config->reg_1e);
-    spiWrite(RH_RF95_REG_26_MODEM_CONFIG3,       config->reg_26);
+    uint8_t regs[] =
+    {
+	RH_RF95_REG_1D_MODEM_CONFIG1, config->reg_1d,
+	RH_RF95_REG_1E_MODEM_CONFIG2, config->reg_1e,
+	RH_RF95_REG_26_MODEM_CONFIG3, config->reg_26
+    };
+    spiWriteRegisters(regs, sizeof(regs) / 2);
+}
+
+RH_RF95::ModemConfig RH_RF95::invalidModemConfig()
+{
+    ModemConfig cfg;
+    memcpy_P(&cfg, &MODEM_CONFIG_TABLE[Bw125Cr45Sf128], sizeof(RH_RF95::ModemConfig));
+    return cfg;
 }
 
 // Set one of the canned FSK Modem configs
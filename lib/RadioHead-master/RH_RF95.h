@@ -14,9 +14,26 @@
 
 #include <RHSPIDriver.h>
 
-// This is the maximum number of interrupts the driver can support
-// Most Arduinos can handle 2, Megas can handle more
-#define RH_RF95_NUM_INTERRUPTS 3
+// This is the maximum number of interrupts the driver can support, 3 or 8
+// Most Arduinos can handle 2, Megas can handle more. On Linux every GPIO line can interrupt,
+// and a gateway may run more radios
+#ifndef RH_RF95_NUM_INTERRUPTS
+ #if (RH_PLATFORM == RH_PLATFORM_RASPI) || (RH_PLATFORM == RH_PLATFORM_UNIX)
+  #define RH_RF95_NUM_INTERRUPTS 8
+ #else
+  #define RH_RF95_NUM_INTERRUPTS 3
+ #endif
+#endif
+
+// Number of received packets the interrupt handler can hold until recv() collects them.
+// Must be a power of 2. Each takes RH_RF95_MAX_PAYLOAD_LEN octets of SRAM and a few more
+#ifndef RH_RF95_RX_QUEUE_LENGTH
+ #if defined(__AVR__)
+  #define RH_RF95_RX_QUEUE_LENGTH 1
+ #else
+  #define RH_RF95_RX_QUEUE_LENGTH 4
+ #endif
+#endif
 
 // Max number of octets the LORA Rx/Tx FIFO can hold
 #define RH_RF95_FIFO_SIZE 255
@@ -42,6 +59,9 @@
 // The Frequency Synthesizer step = RH_RF95_FXOSC / 2^^19
 #define RH_RF95_FSTEP  (RH_RF95_FXOSC / 524288)
 
+// Frequencies at or above this (in MHz) use the HF RF port, which has a different RSSI offset
+#define RH_RF95_HF_PORT_MIN_FREQUENCY 779.0
+
 
 // Register names (LoRa Mode, from table 85)
 #define RH_RF95_REG_00_FIFO                                0x00
@@ -83,6 +103,9 @@
 #define RH_RF95_REG_24_HOP_PERIOD                          0x24
 #define RH_RF95_REG_25_FIFO_RX_BYTE_ADDR                   0x25
 #define RH_RF95_REG_26_MODEM_CONFIG3                       0x26
+#define RH_RF95_REG_28_FEI_MSB                             0x28
+#define RH_RF95_REG_29_FEI_MID                             0x29
+#define RH_RF95_REG_2A_FEI_LSB                             0x2a
 
 #define RH_RF95_REG_31_DETECTION_OPTIMIZE   0x31
 #define RH_RF95_REG_37_DETECTION_THRESHOLD  0x37
@@ -182,19 +205,24 @@
 #define RH_RF95_FHSS_PRESENT_CHANNEL                  0x3f
 
 // RH_RF95_REG_1D_MODEM_CONFIG1                       0x1d
-#define RH_RF95_BW                                    0xc0
-#define RH_RF95_BW_125KHZ                             0x00
-#define RH_RF95_BW_250KHZ                             0x40
-#define RH_RF95_BW_500KHZ                             0x80
-#define RH_RF95_BW_RESERVED                           0xc0
-#define RH_RF95_CODING_RATE                           0x38
-#define RH_RF95_CODING_RATE_4_5                       0x00
-#define RH_RF95_CODING_RATE_4_6                       0x08
-#define RH_RF95_CODING_RATE_4_7                       0x10
-#define RH_RF95_CODING_RATE_4_8                       0x18
-#define RH_RF95_IMPLICIT_HEADER_MODE_ON               0x04
-#define RH_RF95_RX_PAYLOAD_CRC_ON                     0x02
-#define RH_RF95_LOW_DATA_RATE_OPTIMIZE                0x01
+// Bit layout is per the SX1276/77/78/79 (RFM95/96/97/98) datasheet
+#define RH_RF95_BW                                    0xf0
+#define RH_RF95_BW_7_8KHZ                             0x00
+#define RH_RF95_BW_10_4KHZ                            0x10
+#define RH_RF95_BW_15_6KHZ                            0x20
+#define RH_RF95_BW_20_8KHZ                            0x30
+#define RH_RF95_BW_31_25KHZ                           0x40
+#define RH_RF95_BW_41_7KHZ                            0x50
+#define RH_RF95_BW_62_5KHZ                            0x60
+#define RH_RF95_BW_125KHZ                             0x70
+#define RH_RF95_BW_250KHZ                             0x80
+#define RH_RF95_BW_500KHZ                             0x90
+#define RH_RF95_CODING_RATE                           0x0e
+#define RH_RF95_CODING_RATE_4_5                       0x02
+#define RH_RF95_CODING_RATE_4_6                       0x04
+#define RH_RF95_CODING_RATE_4_7                       0x06
+#define RH_RF95_CODING_RATE_4_8                       0x08
+#define RH_RF95_IMPLICIT_HEADER_MODE_ON               0x01
 
 // RH_RF95_REG_1E_MODEM_CONFIG2                       0x1e
 #define RH_RF95_SPREADING_FACTOR                      0xf0
@@ -205,10 +233,17 @@
 #define RH_RF95_SPREADING_FACTOR_1024CPS              0xa0
 #define RH_RF95_SPREADING_FACTOR_2048CPS              0xb0
 #define RH_RF95_SPREADING_FACTOR_4096CPS              0xc0
-#define RH_RF95_TX_CONTINUOUS_MOE                     0x08
-#define RH_RF95_AGC_AUTO_ON                           0x04
+#define RH_RF95_TX_CONTINUOUS_MODE                    0x08
+#define RH_RF95_PAYLOAD_CRC_ON                        0x04
 #define RH_RF95_SYM_TIMEOUT_MSB                       0x03
 
+// RH_RF95_REG_26_MODEM_CONFIG3                       0x26
+#define RH_RF95_LOW_DATA_RATE_OPTIMIZE                0x08
+#define RH_RF95_AGC_AUTO_ON                           0x04
+
+// The LoRa symbol time above which RH_RF95_LOW_DATA_RATE_OPTIMIZE is mandatory, in ms
+#define RH_RF95_LDRO_SYMBOL_TIME_MS                   16
+
 // RH_RF95_REG_4D_PA_DAC                              0x4d
 #define RH_RF95_PA_DAC_DISABLE                        0x04
 #define RH_RF95_PA_DAC_ENABLE                         0x07
@@ -420,6 +455,12 @@
 /// and from that other device.  Use cli() to disable interrupts and sei() to
 /// reenable them.
 ///
+/// Received packets are queued by the interrupt service routine, up to RH_RF95_RX_QUEUE_LENGTH of
+/// them (1 on AVR, 4 elsewhere), and recv() collects them without disabling interrupts, so it adds
+/// nothing to the interrupt latency of the rest of the program. The receiver keeps running until
+/// the queue is full. Headers, lastRssi() and lastPacketInfo() describe the packet last collected
+/// by recv().
+///
 /// \par Memory
 ///
 /// The RH_RF95 driver requires non-trivial amounts of memory. The sample
@@ -531,8 +572,8 @@ public:
   
     /// Choices for setModemConfig() for a selected subset of common
     /// data rates. If you need another configuration,
-    /// determine the necessary settings and call setModemRegisters() with your
-    /// desired settings. It might be helpful to use the LoRa calculator mentioned in 
+    /// build it with modemConfig() and call setModemRegisters() with the result.
+    /// It might be helpful to use the LoRa calculator mentioned in 
     /// http://www.semtech.com/images/datasheet/LoraDesignGuide_STD.pdf
     /// These are indexes into MODEM_CONFIG_TABLE. We strongly recommend you use these symbolic
     /// definitions and not their integer equivalents: its possible that new values will be
@@ -547,10 +588,156 @@ public:
 	Bw125Cr48Sf4096,           ///< Bw = 125 kHz, Cr = 4/8, Sf = 4096chips/symbol, CRC on. Slow+long range
     } ModemConfigChoice;
 
+    /// \brief RF metadata for one received packet
+    ///
+    /// Captured by the interrupt handler when the packet arrives, and made available
+    /// through lastPacketInfo() once the packet has been collected with recv().
+    typedef struct
+    {
+	int16_t    rssi;           ///< Packet RSSI in dBm, corrected with the SNR per the SX1276 datasheet
+	int8_t     snr;            ///< Packet SNR in units of 0.25 dB (signed)
+	int32_t    frequencyError; ///< Estimated frequency error of the transmitter in Hz
+	uint32_t   timestampUs;    ///< RHClock::micros() when the RxDone interrupt was handled
+    } PacketInfo;
+
+    /// \brief Signal bandwidths supported by the LoRa modem
+    ///
+    /// Choices for the bandwidth argument of modemConfig(). The values are the
+    /// Bw field of RH_RF95_REG_1D_MODEM_CONFIG1.
+    typedef enum
+    {
+	Bw7_8kHz = 0,              ///< 7.8 kHz
+	Bw10_4kHz,                 ///< 10.4 kHz
+	Bw15_6kHz,                 ///< 15.6 kHz
+	Bw20_8kHz,                 ///< 20.8 kHz
+	Bw31_25kHz,                ///< 31.25 kHz
+	Bw41_7kHz,                 ///< 41.7 kHz
+	Bw62_5kHz,                 ///< 62.5 kHz
+	Bw125kHz,                  ///< 125 kHz
+	Bw250kHz,                  ///< 250 kHz
+	Bw500kHz,                  ///< 500 kHz
+    } Bandwidth;
+
+    /// \brief How modemConfig() sets the LowDataRateOptimize bit
+    typedef enum
+    {
+	LdroAuto = 0,              ///< On if the symbol time exceeds RH_RF95_LDRO_SYMBOL_TIME_MS
+	LdroOff,                   ///< Always off
+	LdroOn,                    ///< Always on
+    } LowDataRateOptimize;
+
+    /// Returns the nominal width of a Bandwidth choice.
+    /// \param[in] bw The bandwidth
+    /// \return The bandwidth in Hz
+    static constexpr uint32_t bandwidthHz(Bandwidth bw)
+    {
+	return bw == Bw7_8kHz   ? 7800   : bw == Bw10_4kHz  ? 10400  :
+	       bw == Bw15_6kHz  ? 15600  : bw == Bw20_8kHz  ? 20800  :
+	       bw == Bw31_25kHz ? 31250  : bw == Bw41_7kHz  ? 41700  :
+	       bw == Bw62_5kHz  ? 62500  : bw == Bw125kHz   ? 125000 :
+	       bw == Bw250kHz   ? 250000 : 500000;
+    }
+
+    /// Returns the duration of one LoRa symbol, 2^sf / bandwidth.
+    /// \param[in] sf Spreading factor, 6 to 12
+    /// \param[in] bw The bandwidth
+    /// \return Symbol time in microseconds
+    static constexpr uint32_t symbolTimeUs(uint8_t sf, Bandwidth bw)
+    {
+	return ((1000000UL << sf) + bandwidthHz(bw) / 2) / bandwidthHz(bw);
+    }
+
+    /// Computes the value of the RH_RF95_REG_06_FRF_MSB..RH_RF95_REG_08_FRF_LSB registers for a
+    /// centre frequency, in integer arithmetic. Intended for building channel tables at compile time,
+    /// so that retuning with setFrequencyRegisters() needs no floating point.
+    /// \param[in] hz Centre frequency in Hz
+    /// \return The 24 bit Frf value, hz / RH_RF95_FSTEP rounded to nearest
+    static constexpr uint32_t frequencyToFrf(uint32_t hz)
+    {
+	return (uint32_t)((((uint64_t)hz << 19) + (uint64_t)RH_RF95_FXOSC / 2) / (uint64_t)RH_RF95_FXOSC);
+    }
+
+    /// Returns the number of payload symbols in a LoRa packet in explicit header mode,
+    /// per the SX1276/77/78/79 datasheet section 4.1.1.7
+    /// \param[in] len Payload length in octets, including the RH_RF95_HEADER_LEN octets of RadioHead headers
+    /// \param[in] sf Spreading factor
+    /// \param[in] crDenominator Coding rate denominator, 5 to 8
+    /// \param[in] crc true if the payload CRC is on
+    /// \param[in] ldro true if LowDataRateOptimize is on
+    /// \return Number of symbols after the preamble
+    static constexpr uint16_t payloadSymbols(uint8_t len, uint8_t sf, uint8_t crDenominator, bool crc, bool ldro)
+    {
+	return 8 + payloadBlocks((int16_t)(8 * len - 4 * sf + 28 + (crc ? 16 : 0)), 4 * (sf - (ldro ? 2 : 0))) * crDenominator;
+    }
+
+    /// Returns the time on air of a LoRa packet in explicit header mode.
+    /// \param[in] len Payload length in octets, including the RH_RF95_HEADER_LEN octets of RadioHead headers
+    /// \param[in] sf Spreading factor
+    /// \param[in] bw The bandwidth
+    /// \param[in] crDenominator Coding rate denominator, 5 to 8
+    /// \param[in] preambleLength Preamble length in symbols, as setPreambleLength()
+    /// \param[in] crc true if the payload CRC is on
+    /// \return Time on air in microseconds, assuming LowDataRateOptimize is set as modemConfig() sets it by default
+    static constexpr uint32_t timeOnAirUs(uint8_t len, uint8_t sf, Bandwidth bw, uint8_t crDenominator,
+					  uint16_t preambleLength = 8, bool crc = true)
+    {
+	return ((uint32_t)(preambleLength * 4 + 17) * symbolTimeUs(sf, bw)) / 4
+	    + (uint32_t)payloadSymbols(len, sf, crDenominator, crc, lowDataRateOptimizeRequired(sf, bw)) * symbolTimeUs(sf, bw);
+    }
+
+    /// Tells whether the LowDataRateOptimize bit is required for a spreading factor and bandwidth,
+    /// ie if the symbol time exceeds RH_RF95_LDRO_SYMBOL_TIME_MS (SF11 and SF12 at 125 kHz).
+    /// \param[in] sf Spreading factor
+    /// \param[in] bw The bandwidth
+    /// \return true if LowDataRateOptimize must be on
+    static constexpr bool lowDataRateOptimizeRequired(uint8_t sf, Bandwidth bw)
+    {
+	return (1000UL << sf) > (uint32_t)RH_RF95_LDRO_SYMBOL_TIME_MS * bandwidthHz(bw);
+    }
+
+    /// Tells whether modemConfig() can build a configuration from these arguments.
+    /// Spreading factor 6 is not valid, since it requires implicit header mode, which this driver does not use.
+    /// \param[in] sf Spreading factor, 7 to 12
+    /// \param[in] bw The bandwidth
+    /// \param[in] crDenominator Coding rate denominator, 5 to 8 (ie 4/5 to 4/8)
+    /// \return true if the arguments are valid
+    static constexpr bool modemConfigValid(uint8_t sf, Bandwidth bw, uint8_t crDenominator)
+    {
+	return sf >= 7 && sf <= 12 && bw <= Bw500kHz && crDenominator >= 5 && crDenominator <= 8;
+    }
+
+    /// Builds the modem configuration register values for an arbitrary spreading factor,
+    /// bandwidth and coding rate, for use with setModemRegisters().
+    /// Can be evaluated at compile time: invalid arguments in a constant expression
+    /// (eg when initialising a constexpr ModemConfig) are a compile error. Invalid arguments at run time
+    /// produce the configuration for Bw125Cr45Sf128. Use modemConfigValid() to check run time values.
+    /// \code
+    /// constexpr RH_RF95::ModemConfig sf9 = RH_RF95::modemConfig(9, RH_RF95::Bw125kHz, 5);
+    /// driver.setModemRegisters(&sf9);
+    /// \endcode
+    /// \param[in] sf Spreading factor, 7 to 12
+    /// \param[in] bw The bandwidth
+    /// \param[in] crDenominator Coding rate denominator, 5 to 8 (ie 4/5 to 4/8)
+    /// \param[in] crc true to enable the payload CRC
+    /// \param[in] ldro How to set the LowDataRateOptimize bit. The default sets it when the radio requires it.
+    /// \return The register values
+    static constexpr ModemConfig modemConfig(uint8_t sf, Bandwidth bw, uint8_t crDenominator,
+					     bool crc = true, LowDataRateOptimize ldro = LdroAuto)
+    {
+	return modemConfigValid(sf, bw, crDenominator)
+	    ? ModemConfig{ (uint8_t)((bw << 4) | ((crDenominator - 4) << 1)),
+			   (uint8_t)((sf << 4) | (crc ? RH_RF95_PAYLOAD_CRC_ON : 0)),
+			   (uint8_t)((ldro == LdroOn || (ldro == LdroAuto && lowDataRateOptimizeRequired(sf, bw)))
+				     ? RH_RF95_LOW_DATA_RATE_OPTIMIZE : 0) }
+	    : invalidModemConfig();
+    }
+
     /// Constructor. You can have multiple instances, but each instance must have its own
     /// interrupt and slave select pin. After constructing, you must call init() to initialise the interface
-    /// and the radio module. A maximum of 3 instances can co-exist on one processor, provided there are sufficient
-    /// distinct interrupt lines, one for each instance.
+    /// and the radio module. A maximum of RH_RF95_NUM_INTERRUPTS instances (3, or 8 on Linux) can co-exist on one
+    /// processor, provided there are sufficient distinct interrupt lines, one for each instance.
+    /// On Linux, where each thread services the interrupts it attached (see RHutil/RasPi.h), call init() in the
+    /// thread that runs the instance, and not in two threads at once.
     /// \param[in] slaveSelectPin the Arduino pin number of the output to use to select the RH_RF22 before
     /// accessing it. Defaults to the normal SS pin for your Arduino (D10 for Diecimila, Uno etc, D53 for Mega, D10 for Maple)
     /// \param[in] interruptPin The interrupt Pin number that is connected to the RFM DIO0 interrupt line. 
@@ -638,6 +825,13 @@ public:
     /// \return true if the selected frquency centre is within range
     bool        setFrequency(float centre);
 
+    /// Sets the transmitter and receiver centre frequency from a precomputed Frf register value,
+    /// as returned by frequencyToFrf(). Avoids the floating point arithmetic in setFrequency(),
+    /// and writes all three registers in one SPI burst, so it is suitable for frequent retuning
+    /// such as frequency hopping.
+    /// \param[in] frf The 24 bit Frf value
+    void           setFrequencyRegisters(uint32_t frf);
+
     /// If current mode is Rx or Tx changes it to Idle. If the transmitter or receiver is running, 
     /// disables them.
     void           setModeIdle();
@@ -650,6 +844,16 @@ public:
     /// Starts the transmitter in the RF95/96/97/98.
     void           setModeTx();
 
+    /// Starts a channel activity detection, which takes about 2 symbol times.
+    /// The interrupt handler raises RH_EVENT_CAD_DONE at the end and leaves the radio in Idle mode.
+    /// Then cadDetected() tells whether a LoRa preamble was detected.
+    void           setModeCad();
+
+    /// Detects channel activity, blocking until the detection is finished.
+    /// Used by waitCAD() before send() when setCADTimeout() was called.
+    /// \return true if a LoRa preamble was detected on the channel
+    virtual bool   isChannelActive();
+
     /// Sets the transmitter power output level, and configures the transmitter pin.
     /// Be a good neighbour and set the lowest power level you need.
     /// Some SX1276/77/78/79 and compatible modules (such as RFM95/96/97/98) 
@@ -670,10 +874,34 @@ public:
     /// \param[in] useRFO If true, enables the use of the RFO transmitter pins instead of
     /// the PA_BOOST pin (false). Choose the correct setting for your module.
     void           setTxPower(int8_t power, bool useRFO = false);
+
+    /// Sets the spreading factor, leaving the other modem settings unchanged.
+    /// The LowDataRateOptimize bit is updated to suit the new symbol time.
+    /// \param[in] sf Spreading factor, 6 to 12. Out of range values are clamped
     void           setSpreadingFactor(int8_t sf);
+
+    /// Sets the signal bandwidth, leaving the other modem settings unchanged.
+    /// The LowDataRateOptimize bit is updated to suit the new symbol time.
+    /// \param[in] sbw Bandwidth in Hz. Rounded up to the next bandwidth supported by the radio
     void           setSignalBandwidth(long sbw);
+
+    /// Sets the coding rate, leaving the other modem settings unchanged.
+    /// \param[in] denominator Coding rate denominator, 5 to 8 (ie 4/5 to 4/8)
     void           setCodingRate4(int8_t denominator);
     void           setSyncWord(int sw);
+    /// Returns the signal to noise ratio of the last packet collected with recv().
+    /// \return SNR in dB. Negative values mean the packet was received below the noise floor
+    int8_t         lastSNR();
+
+    /// Returns the frequency error of the last packet collected with recv(), ie the
+    /// offset of the transmitter from our centre frequency, as measured by the receiver.
+    /// \return Frequency error in Hz
+    int32_t        frequencyError();
+
+    /// Returns the RF metadata of the last packet collected with recv().
+    /// \return Reference to the metadata, valid until the next successful recv()
+    const PacketInfo& lastPacketInfo();
+
     /// Sets the radio into low-power sleep mode.
     /// If successful, the transport will stay in sleep mode until woken by 
     /// changing mode it idle, transmit or receive (eg by calling send(), recv(), available() etc)
@@ -681,29 +909,56 @@ public:
     /// \return true if sleep mode was successfully entered.
     virtual bool    sleep();
 
+#if (RH_PLATFORM == RH_PLATFORM_RASPI)
+    /// Returns the file descriptor of the GPIO interrupts (see RHutil/RHLinuxGpio.h),
+    /// readable when DIO0 has risen
+    /// \return The file descriptor
+    virtual int     eventFd();
+#endif
+
 protected:
+#if (RH_PLATFORM == RH_PLATFORM_RASPI)
+    /// Runs the interrupt handlers of the edges waiting on the GPIO interrupt file descriptor
+    virtual void    pollEvents();
+#endif
+
     /// This is a low level function to handle the interrupts for one instance of RH_RF95.
     /// Called automatically by isr*()
     /// Should not need to be called by user code.
     void           handleInterrupt();
 
-    /// Examine the revceive buffer to determine whether the message is for this node
-    void validateRxBuf();
+    /// Examine a received packet to determine whether the message is for this node
+    /// \param[in] buf The packet, headers first
+    /// \param[in] len Number of octets in buf
+    /// \return true if the packet is to be passed to recv()
+    bool validateRxBuf(const uint8_t* buf, uint8_t len);
 
-    /// Clear our local receive buffer
+    /// Discards the received packets that recv() has not collected yet
     void clearRxBuf();
 
+    /// Sets or clears the LowDataRateOptimize bit according to the spreading factor and
+    /// bandwidth currently programmed in the radio. Called after either of them is changed.
+    void setLowDatarate();
+
 private:
-    /// Low level interrupt service routine for device connected to interrupt 0
-    static void         isr0();
+    /// Rounds a number of payload bits up to whole blocks of symbols, none if it is not positive.
+    static constexpr uint16_t payloadBlocks(int16_t bits, uint8_t bitsPerBlock)
+    {
+	return bits > 0 ? (bits + bitsPerBlock - 1) / bitsPerBlock : 0;
+    }
+
+    /// Fallback for modemConfig() when called with invalid arguments.
+    /// Deliberately not constexpr, so that reaching it during constant evaluation is a compile error.
+    static ModemConfig  invalidModemConfig();
 
-    /// Low level interrupt service routine for device connected to interrupt 1
-    static void         isr1();
+    /// Low level interrupt service routine for the device in _deviceForInterrupt[index]
+    template <uint8_t index>
+    static void         isr();
 
-    /// Low level interrupt service routine for device connected to interrupt 1
-    static void         isr2();
+    /// The isr() of each entry of _deviceForInterrupt
+    static void         (* const _isrs[RH_RF95_NUM_INTERRUPTS])();
 
-    /// Array of instances connected to interrupts 0 and 1
+    /// Array of instances connected to interrupts 0 to RH_RF95_NUM_INTERRUPTS - 1
     static RH_RF95*     _deviceForInterrupt[];
 
     /// Index of next interrupt number to use in _deviceForInterrupt
@@ -716,14 +971,34 @@ private:
     /// else 0xff
     uint8_t             _myInterruptIndex;
 
-    /// Number of octets in the buffer
-    volatile uint8_t    _bufLen;
-    
-    /// The receiver/transmitter buffer
-    uint8_t             _buf[RH_RF95_MAX_PAYLOAD_LEN];
-
-    /// True when there is a valid message in the buffer
-    volatile bool       _rxBufValid;
+    /// A received packet waiting in _rxQueue
+    typedef struct
+    {
+	uint8_t         len;                          ///< Number of octets in buf
+	uint8_t         buf[RH_RF95_MAX_PAYLOAD_LEN]; ///< The packet, headers first
+	/// Captured by the interrupt handler. frequencyError holds the raw 20 bit
+	/// RH_RF95_REG_28_FEI_MSB value until recv() converts it
+	PacketInfo      info;
+    } RxSlot;
+
+    /// Received packets, handed from the interrupt handler to recv() without disabling interrupts.
+    /// Slot _rxTail % RH_RF95_RX_QUEUE_LENGTH is the oldest; only the interrupt handler fills slots,
+    /// and only recv() and clearRxBuf() empty them
+    RxSlot              _rxQueue[RH_RF95_RX_QUEUE_LENGTH];
+
+    /// Number of packets ever put in _rxQueue, modulo 256. Written by the interrupt handler only,
+    /// after the slot, so a new value tells the main line the slot is complete
+    volatile uint8_t    _rxHead;
+
+    /// Number of packets ever taken from _rxQueue, modulo 256. Written by the main line only,
+    /// after it has finished with the slot, so a new value hands the slot back to the interrupt handler
+    volatile uint8_t    _rxTail;
+
+    /// True if the centre frequency is served by the HF RF port (affects RSSI calculation)
+    bool                _usingHFport;
+
+    /// Metadata of the last packet collected by recv()
+    PacketInfo          _lastPacketInfo;
 };
 
 /// @example rf95_client.pde
@@ -38,9 +38,21 @@ bool RH_Serial::available()
     return _rxBufValid;
 }
 
+void RH_Serial::pollEvents()
+{
+    available();
+}
+
+#if (RH_PLATFORM == RH_PLATFORM_UNIX) || (RH_PLATFORM == RH_PLATFORM_RASPI)
+int RH_Serial::eventFd()
+{
+    return _serial.fileDescriptor();
+}
+#endif
+
 void RH_Serial::waitAvailable()
 {
-#if (RH_PLATFORM == RH_PLATFORM_UNIX)
+#if (RH_PLATFORM == RH_PLATFORM_UNIX) || (RH_PLATFORM == RH_PLATFORM_RASPI)
     // Unix version driver in RHutil/HardwareSerial knows how to wait without polling
     while (!available())
 	_serial.waitAvailable();
@@ -51,12 +63,12 @@ void RH_Serial::waitAvailable()
 
 bool RH_Serial::waitAvailableTimeout(uint16_t timeout)
 {
-#if (RH_PLATFORM == RH_PLATFORM_UNIX)
+#if (RH_PLATFORM == RH_PLATFORM_UNIX) || (RH_PLATFORM == RH_PLATFORM_RASPI)
     // Unix version driver in RHutil/HardwareSerial knows how to wait without polling
-    unsigned long starttime = millis();
-    while ((millis() - starttime) < timeout)
+    uint32_t starttime = RHClock::millis();
+    while ((RHClock::millis() - starttime) < timeout)
     {
-	_serial.waitAvailableTimeout(timeout - (millis() - starttime));
+	_serial.waitAvailableTimeout(timeout - (RHClock::millis() - starttime));
         if (available())
            return true;
 	YIELD;
@@ -105,8 +117,8 @@ void  RH_Serial::handleRx(uint8_t ch)
 	    if (ch == ETX)
 	    {
 		// add fcs for DLE, ETX
-		_rxFcs = RHcrc_ccitt_update(_rxFcs, DLE);
-		_rxFcs = RHcrc_ccitt_update(_rxFcs, ETX);
+		_rxFcs = RHCrcCcitt::update(_rxFcs, DLE);
+		_rxFcs = RHCrcCcitt::update(_rxFcs, ETX);
 		_rxState = RxStateWaitFCS1; // End frame
 	    }
 	    else if (ch == DLE)
@@ -152,7 +164,7 @@ void RH_Serial::appendRxBuf(uint8_t ch)
     {
 	// Normal data, save and add to FCS
 	_rxBuf[_rxBufLen++] = ch;
-	_rxFcs = RHcrc_ccitt_update(_rxFcs, ch);
+	_rxFcs = RHCrcCcitt::update(_rxFcs, ch);
     }
     // If the buffer overflows, we dont record the trailing data, and the FCS will be wrong,
     // causing the message to be dropped when the FCS is received
@@ -178,6 +190,7 @@ void RH_Serial::validateRxBuf()
     {
 	_rxGood++;
 	_rxBufValid = true;
+	raiseEvent(RH_EVENT_RECEIVE);
     }
 }
 
@@ -216,13 +229,14 @@ bool RH_Serial::send(const uint8_t* data, uint8_t len)
 	txData(*data++);
     // End of message
     _serial.write(DLE);
-    _txFcs = RHcrc_ccitt_update(_txFcs, DLE);
+    _txFcs = RHCrcCcitt::update(_txFcs, DLE);
     _serial.write(ETX);
-    _txFcs = RHcrc_ccitt_update(_txFcs, ETX);
+    _txFcs = RHCrcCcitt::update(_txFcs, ETX);
 
     // Now send the calculated FCS for this message
     _serial.write((_txFcs >> 8) & 0xff);
     _serial.write(_txFcs & 0xff);
+    raiseEvent(RH_EVENT_TX_DONE); // Handed over to the serial port
     return true;
 }
 
@@ -231,7 +245,7 @@ void  RH_Serial::txData(uint8_t ch)
     if (ch == DLE)    // DLE stuffing required?
 	_serial.write(DLE); // Not in FCS
     _serial.write(ch);
-    _txFcs = RHcrc_ccitt_update(_txFcs, ch);
+    _txFcs = RHCrcCcitt::update(_txFcs, ch);
 }
 
 uint8_t RH_Serial::maxMessageLength()
@@ -106,7 +106,7 @@ class HardwareSerial;
 /// - Serial2: on pins 0 (Rx) and 1 (Tx)
 /// - Serial3: on pins 29 (Tx) and 30 (Rx)
 ///
-/// On Linux and OSX there can be any number of serial ports.
+/// On Linux (including Raspberry Pi) and OSX there can be any number of serial ports.
 /// - On Linux, names like /dev/ttyUSB0 (for a FTDO USB-serial converter)
 /// - On OSX, names like /dev/tty.usbserial-A501YSWL (for a FTDO USB-serial converter)
 ///
@@ -194,8 +194,17 @@ public:
     /// \return The maximum legal message length
     virtual uint8_t maxMessageLength();
 
+#if (RH_PLATFORM == RH_PLATFORM_UNIX) || (RH_PLATFORM == RH_PLATFORM_RASPI)
+    /// Returns the file descriptor of the serial port, which is readable when characters arrive
+    /// \return The file descriptor, or -1 if the port is not open
+    virtual int eventFd();
+#endif
 
 protected:
+    /// Reads the characters received by the serial port, raising RH_EVENT_RECEIVE
+    /// when they complete a message
+    virtual void pollEvents();
+
     /// \brief Defines different receiver states in teh receiver state machine
     typedef enum
     {
@@ -171,9 +171,11 @@ void RH_TCP::checkForEvents()
 		// check for other message types here
 		// Now remove the used message by copying the trailing bytes (maybe start of a new message?)
 		// to the top of the buffer
-		memcpy(socketBuf, socketBuf + messageLen, sizeof(socketBuf) - messageLen);
+		memmove(socketBuf, socketBuf + messageLen, sizeof(socketBuf) - messageLen);
 		socketBufLen -= messageLen;
 	    }
+	    else
+		break; // Wait for the rest of the message
 	}
     }
 }
@@ -187,6 +189,7 @@ void RH_TCP::validateRxBuf()
     {
 	_rxGood++;
 	_rxBufValid = true;
+	raiseEvent(RH_EVENT_RECEIVE);
     }
 }
 
@@ -203,6 +206,16 @@ bool RH_TCP::available()
     return _rxBufValid;
 }
 
+void RH_TCP::pollEvents()
+{
+    available();
+}
+
+int RH_TCP::eventFd()
+{
+    return _socket;
+}
+
 // Block until something is available
 void RH_TCP::waitAvailable()
 {
@@ -259,6 +272,8 @@ bool RH_TCP::send(const uint8_t* data, uint8_t len)
 
     bool ret = sendPacket(data, len);
     delay(10); // Wait for transmit to succeed. REVISIT: depends on length and speed
+    if (ret)
+	raiseEvent(RH_EVENT_TX_DONE);
     return ret;
 }
 
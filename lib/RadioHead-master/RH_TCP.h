@@ -134,7 +134,15 @@ public:
     /// \param[in] address The address of this node.
     void setThisAddress(uint8_t address);
 
+    /// Returns the socket connected to the ether simulator server, which becomes readable
+    /// when messages arrive
+    /// \return The socket, or -1 if not connected
+    virtual int eventFd();
+
 protected:
+    /// Reads the messages from the ether simulator server, raising RH_EVENT_RECEIVE
+    /// when one is for this node
+    virtual void pollEvents();
 
 private:
     /// Connect to the address and port specified by the server constructor argument.
@@ -4,7 +4,7 @@
 // $Id: HardwareSerial.cpp,v 1.3 2015/08/13 02:45:47 mikem Exp mikem $
 
 #include <RadioHead.h>
-#if (RH_PLATFORM == RH_PLATFORM_UNIX)
+#if (RH_PLATFORM == RH_PLATFORM_UNIX) || (RH_PLATFORM == RH_PLATFORM_RASPI)
 
 #include <HardwareSerial.h>
 
@@ -209,6 +209,11 @@ bool HardwareSerial::setBaud(int baud)
     return true;
 }
 
+int HardwareSerial::fileDescriptor()
+{
+    return _device;
+}
+
 // Block until something is available
 void HardwareSerial::waitAvailable()
 {
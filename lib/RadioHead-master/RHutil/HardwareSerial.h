@@ -86,6 +86,10 @@ public:
     /// \return true if a message is available as reported by available()
     bool waitAvailableTimeout(uint16_t timeout);
 
+    /// Returns the file descriptor of the open port, to wait for several ports with select() or epoll
+    /// \return The file descriptor, or -1 if the port is not open
+    int fileDescriptor();
+
 protected:
     bool openDevice();
     bool closeDevice();
@@ -0,0 +1,273 @@
+// RHBenchmark.cpp
+//
+// Microbenchmark harness for RadioHead code built with tools/simBuild
+// Copyright (C) 2019 desplega.com
+
+#include <RHutil/RHBenchmark.h>
+#if (RH_PLATFORM == RH_PLATFORM_UNIX)
+
+#include <regex.h>
+#include <time.h>
+#include <unistd.h>
+
+// The registered benchmarks, in order of registration
+static RHBenchmark* benchmarks = NULL;
+
+// Runs longer than this many iterations are not attempted
+#define RH_BENCHMARK_MAX_ITERATIONS 1000000000ULL
+
+static uint64_t clockNanos(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+RHBenchmarkState::RHBenchmarkState(uint64_t iterations, int64_t arg)
+    :
+    _iterations(iterations),
+    _remaining(iterations),
+    _arg(arg),
+    _realNanos(0),
+    _cpuNanos(0),
+    _realStart(0),
+    _cpuStart(0),
+    _bytes(0),
+    _items(0),
+    _error(NULL)
+{
+}
+
+bool RHBenchmarkState::keepRunning()
+{
+    if (_remaining == _iterations)
+	resumeTiming(); // First call
+    if (_remaining > 0 && !_error)
+    {
+	_remaining--;
+	return true;
+    }
+    pauseTiming();
+    return false;
+}
+
+void RHBenchmarkState::pauseTiming()
+{
+    _realNanos += clockNanos(CLOCK_MONOTONIC) - _realStart;
+    _cpuNanos += clockNanos(CLOCK_PROCESS_CPUTIME_ID) - _cpuStart;
+}
+
+void RHBenchmarkState::resumeTiming()
+{
+    _realStart = clockNanos(CLOCK_MONOTONIC);
+    _cpuStart = clockNanos(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+void RHBenchmarkState::skipWithError(const char* message)
+{
+    _error = message;
+}
+
+RHBenchmark::RHBenchmark(const char* name, RHBenchmarkFunction function)
+    :
+    _name(name),
+    _function(function),
+    _numArgs(0),
+    _next(NULL)
+{
+    RHBenchmark** p = &benchmarks;
+    while (*p)
+	p = &(*p)->_next;
+    *p = this;
+}
+
+RHBenchmark* RHBenchmark::arg(int64_t value)
+{
+    if (_numArgs < RH_BENCHMARK_MAX_ARGS)
+	_args[_numArgs++] = value;
+    return this;
+}
+
+// Prints a rate with an SI prefix, as Google Benchmark does
+static void printRate(const char* name, double perSecond)
+{
+    static const char* prefixes[] = {"", "k", "M", "G", "T"};
+    uint8_t i = 0;
+    while (perSecond >= 1000 && i < 4)
+    {
+	perSecond /= 1000;
+	i++;
+    }
+    printf(" %s=%.4g%s/s", name, perSecond, prefixes[i]);
+}
+
+// Writes one result as a JSON object
+static void writeJson(FILE* out, bool first, const char* name, uint16_t repetitions, uint16_t repetition,
+		      const RHBenchmarkState& state)
+{
+    fprintf(out, "%s    {\n", first ? "" : ",\n");
+    fprintf(out, "      \"name\": \"%s\",\n", name);
+    fprintf(out, "      \"run_name\": \"%s\",\n", name);
+    fprintf(out, "      \"run_type\": \"iteration\",\n");
+    fprintf(out, "      \"repetitions\": %u,\n", repetitions);
+    fprintf(out, "      \"repetition_index\": %u,\n", repetition);
+    if (state._error)
+    {
+	fprintf(out, "      \"error_occurred\": true,\n");
+	fprintf(out, "      \"error_message\": \"%s\"\n", state._error);
+    }
+    else
+    {
+	double seconds = state._realNanos / 1e9;
+	fprintf(out, "      \"iterations\": %llu,\n", (unsigned long long)state._iterations);
+	fprintf(out, "      \"real_time\": %.6g,\n", (double)state._realNanos / state._iterations);
+	fprintf(out, "      \"cpu_time\": %.6g,\n", (double)state._cpuNanos / state._iterations);
+	if (state._bytes)
+	    fprintf(out, "      \"bytes_per_second\": %.6g,\n", state._bytes / seconds);
+	if (state._items)
+	    fprintf(out, "      \"items_per_second\": %.6g,\n", state._items / seconds);
+	fprintf(out, "      \"time_unit\": \"ns\"\n");
+    }
+    fprintf(out, "    }");
+}
+
+// Writes the start of the JSON results, up to the opening of the benchmarks array
+static void writeJsonContext(FILE* out, const char* executable)
+{
+    char date[32];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+    char host[64] = "";
+    gethostname(host, sizeof(host) - 1);
+    fprintf(out, "{\n  \"context\": {\n");
+    fprintf(out, "    \"date\": \"%s\",\n", date);
+    fprintf(out, "    \"host_name\": \"%s\",\n", host);
+    fprintf(out, "    \"executable\": \"%s\",\n", executable);
+    fprintf(out, "    \"num_cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+#ifdef __OPTIMIZE__
+    fprintf(out, "    \"library_build_type\": \"release\"\n");
+#else
+    fprintf(out, "    \"library_build_type\": \"debug\"\n");
+#endif
+    fprintf(out, "  },\n  \"benchmarks\": [\n");
+}
+
+int RHBenchmark::runAll(int argc, char** argv)
+{
+    const char* filter = NULL;
+    const char* outFile = NULL;
+    bool json = false;
+    double minTime = 0.5;
+    uint16_t repetitions = 1;
+    for (int i = 1; i < argc; i++)
+    {
+	if (strncmp(argv[i], "--benchmark_filter=", 19) == 0)
+	    filter = argv[i] + 19;
+	else if (strncmp(argv[i], "--benchmark_min_time=", 21) == 0)
+	    minTime = atof(argv[i] + 21);
+	else if (strncmp(argv[i], "--benchmark_repetitions=", 24) == 0)
+	    repetitions = atoi(argv[i] + 24) > 0 ? atoi(argv[i] + 24) : 1;
+	else if (strncmp(argv[i], "--benchmark_out=", 16) == 0)
+	    outFile = argv[i] + 16;
+	else if (strcmp(argv[i], "--benchmark_format=json") == 0)
+	    json = true;
+	else
+	{
+	    fprintf(stderr, "usage: %s [--benchmark_filter=regex] [--benchmark_min_time=seconds] "
+		    "[--benchmark_repetitions=n] [--benchmark_out=file] [--benchmark_format=json]\n", argv[0]);
+	    return 1;
+	}
+    }
+
+    regex_t regex;
+    if (filter && regcomp(&regex, filter, REG_EXTENDED | REG_NOSUB) != 0)
+    {
+	fprintf(stderr, "Invalid --benchmark_filter regex: %s\n", filter);
+	return 1;
+    }
+    FILE* out = outFile ? fopen(outFile, "w") : NULL;
+    if (outFile && !out)
+    {
+	fprintf(stderr, "Can't write %s\n", outFile);
+	return 1;
+    }
+    if (out)
+	writeJsonContext(out, argv[0]);
+    if (json)
+	writeJsonContext(stdout, argv[0]);
+    else
+	printf("%-40s %15s %15s %12s\n", "Benchmark", "Time", "CPU", "Iterations");
+
+    int status = 0;
+    bool first = true;
+    for (RHBenchmark* b = benchmarks; b; b = b->_next)
+    {
+	for (uint8_t a = 0; a < (b->_numArgs ? b->_numArgs : 1); a++)
+	{
+	    char name[128];
+	    if (b->_numArgs)
+		snprintf(name, sizeof(name), "%s/%lld", b->_name, (long long)b->_args[a]);
+	    else
+		snprintf(name, sizeof(name), "%s", b->_name);
+	    if (filter && regexec(&regex, name, 0, NULL, 0) != 0)
+		continue;
+
+	    for (uint16_t r = 0; r < repetitions; r++)
+	    {
+		// Grow the number of iterations until a run takes minTime, as Google Benchmark does
+		uint64_t iterations = 1;
+		RHBenchmarkState state(iterations, b->_numArgs ? b->_args[a] : 0);
+		while (true)
+		{
+		    state = RHBenchmarkState(iterations, b->_numArgs ? b->_args[a] : 0);
+		    b->_function(state);
+		    double seconds = state._realNanos / 1e9;
+		    if (state._error || seconds >= minTime || iterations >= RH_BENCHMARK_MAX_ITERATIONS)
+			break;
+		    double multiplier = seconds > 0 ? minTime * 1.4 / seconds : 10;
+		    if (multiplier > 10 || seconds / minTime <= 0.1)
+			multiplier = 10;
+		    uint64_t next = (uint64_t)(iterations * multiplier);
+		    iterations = next > iterations ? next : iterations + 1;
+		    if (iterations > RH_BENCHMARK_MAX_ITERATIONS)
+			iterations = RH_BENCHMARK_MAX_ITERATIONS;
+		}
+
+		if (state._error)
+		    status = 1;
+		if (out)
+		    writeJson(out, first, name, repetitions, r, state);
+		if (json)
+		    writeJson(stdout, first, name, repetitions, r, state);
+		first = false;
+		if (json)
+		    continue;
+		if (state._error)
+		{
+		    printf("%-40s ERROR: %s\n", name, state._error);
+		    continue;
+		}
+		printf("%-40s %12.1f ns %12.1f ns %12llu", name, (double)state._realNanos / state._iterations,
+		       (double)state._cpuNanos / state._iterations, (unsigned long long)state._iterations);
+		if (state._bytes)
+		    printRate("bytes_per_second", state._bytes / (state._realNanos / 1e9));
+		if (state._items)
+		    printRate("items_per_second", state._items / (state._realNanos / 1e9));
+		printf("\n");
+	    }
+	}
+    }
+
+    if (out)
+    {
+	fprintf(out, "\n  ]\n}\n");
+	fclose(out);
+    }
+    if (json)
+	printf("\n  ]\n}\n");
+    if (filter)
+	regfree(&regex);
+    return status;
+}
+
+#endif
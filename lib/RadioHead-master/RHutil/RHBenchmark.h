@@ -0,0 +1,138 @@
+// RHBenchmark.h
+//
+// Microbenchmark harness for RadioHead code built with tools/simBuild
+// Copyright (C) 2019 desplega.com
+
+#ifndef RHBenchmark_h
+#define RHBenchmark_h
+
+#include <RadioHead.h>
+#if (RH_PLATFORM == RH_PLATFORM_UNIX)
+
+// Maximum number of arguments one benchmark can be run with
+#define RH_BENCHMARK_MAX_ARGS 8
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHBenchmarkState RHBenchmark.h <RHutil/RHBenchmark.h>
+/// \brief Passed to a benchmark function: runs its timed loop and collects its counters.
+///
+/// The function does its setup, then repeats the code being measured while keepRunning() returns true.
+/// The harness calls it with more and more iterations until a run takes long enough to be timed.
+class RHBenchmarkState
+{
+public:
+    /// Constructor, for the harness
+    RHBenchmarkState(uint64_t iterations, int64_t arg);
+
+    /// Starts the clock on the first call, counts iterations, and stops the clock after the last one
+    /// \return true while there are iterations left
+    bool     keepRunning();
+
+    /// The argument the benchmark is run with (see RHBenchmark::arg()), 0 if it has none
+    int64_t  arg() const { return _arg; }
+
+    /// Stops the clock, eg while preparing the input of the next iteration
+    void     pauseTiming();
+
+    /// Starts the clock again after pauseTiming()
+    void     resumeTiming();
+
+    /// Sets the octets processed by the whole run, reported per second
+    void     setBytesProcessed(int64_t bytes) { _bytes = bytes; }
+
+    /// Sets the items (eg packets) processed by the whole run, reported per second
+    void     setItemsProcessed(int64_t items) { _items = items; }
+
+    /// Number of iterations of this run
+    uint64_t iterations() const { return _iterations; }
+
+    /// Flags the run as failed, eg because the code under test returned an error
+    /// \param[in] message Reported instead of the timings
+    void     skipWithError(const char* message);
+
+    // For the harness
+    uint64_t _iterations;
+    uint64_t _remaining;
+    int64_t  _arg;
+    uint64_t _realNanos;
+    uint64_t _cpuNanos;
+    uint64_t _realStart;
+    uint64_t _cpuStart;
+    int64_t  _bytes;
+    int64_t  _items;
+    const char* _error;
+};
+
+typedef void (*RHBenchmarkFunction)(RHBenchmarkState& state);
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHBenchmark RHBenchmark.h <RHutil/RHBenchmark.h>
+/// \brief A registered benchmark, in the style of Google Benchmark.
+///
+/// \code
+/// static void BM_crc(RHBenchmarkState& state)
+/// {
+///     uint8_t buf[255] = {0};
+///     while (state.keepRunning())
+///         rhDoNotOptimize(RHCrcCcitt::update(0xffff, buf, state.arg()));
+///     state.setBytesProcessed(state.iterations() * state.arg());
+/// }
+/// RH_BENCHMARK(BM_crc)->arg(16)->arg(255);
+///
+/// void setup()
+/// {
+///     exit(RHBenchmark::runAll(_simulator_argc, _simulator_argv));
+/// }
+/// \endcode
+///
+/// runAll() prints a table, and writes the results as JSON in the format of Google Benchmark
+/// (so its tools/compare.py can compare two runs) with these options:
+/// - --benchmark_filter=regex   Only runs the benchmarks whose name (eg BM_crc/16) matches
+/// - --benchmark_min_time=s     Minimum time of a run in seconds, 0.5 by default
+/// - --benchmark_repetitions=n  Runs each benchmark n times
+/// - --benchmark_out=file       Writes the JSON results to file
+/// - --benchmark_format=json    Prints the JSON results instead of the table
+class RHBenchmark
+{
+public:
+    /// Constructor. Use RH_BENCHMARK()
+    RHBenchmark(const char* name, RHBenchmarkFunction function);
+
+    /// Adds an argument to run the benchmark with, as RHBenchmarkState::arg()
+    /// \return this, for chaining
+    RHBenchmark* arg(int64_t value);
+
+    /// Runs the registered benchmarks selected by the command line
+    /// \return The exit status: 0 if all of them ran, 1 otherwise
+    static int   runAll(int argc, char** argv);
+
+private:
+    const char*          _name;
+    RHBenchmarkFunction  _function;
+    int64_t              _args[RH_BENCHMARK_MAX_ARGS];
+    uint8_t              _numArgs;
+    RHBenchmark*         _next;
+};
+
+#define RH_BENCHMARK_NAME2(line) rhBenchmark##line
+#define RH_BENCHMARK_NAME(line) RH_BENCHMARK_NAME2(line)
+
+/// Registers a benchmark function
+#define RH_BENCHMARK(function) \
+    static RHBenchmark* RH_BENCHMARK_NAME(__LINE__) __attribute__((unused)) = (new RHBenchmark(#function, function))
+
+/// Keeps the compiler from optimising away a value the benchmark computes
+template <class T>
+inline void rhDoNotOptimize(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/// Makes the compiler assume memory changed, so stores to buffers are not optimised away
+inline void rhClobberMemory()
+{
+    asm volatile("" : : : "memory");
+}
+
+#endif
+#endif
@@ -0,0 +1,170 @@
+// RHLinuxGpio.cpp
+//
+// Copyright (C) 2019 desplega.com
+
+#if defined(__linux__)
+
+#include <RHutil/RHLinuxGpio.h>
+#include <linux/gpio.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Events read from a line in one go
+#define RH_LINUX_GPIO_READ_EVENTS 16
+
+RHLinuxGpio::RHLinuxGpio(const char* chip)
+    :
+    _chipName(chip),
+    _chip(-1),
+    _epoll(-1)
+{
+    if (!_chipName)
+	_chipName = getenv("RH_GPIOCHIP");
+    if (!_chipName)
+	_chipName = "/dev/gpiochip0";
+    for (uint8_t i = 0; i < RH_LINUX_GPIO_MAX_LINES; i++)
+    {
+	_fds[i] = -1;
+	_handlers[i] = NULL;
+    }
+}
+
+RHLinuxGpio::~RHLinuxGpio()
+{
+    for (uint8_t i = 0; i < RH_LINUX_GPIO_MAX_LINES; i++)
+	detach(i);
+    if (_epoll >= 0)
+	close(_epoll);
+    if (_chip >= 0)
+	close(_chip);
+}
+
+bool RHLinuxGpio::openChip()
+{
+    if (_chip >= 0)
+	return true;
+    _chip = open(_chipName, O_RDONLY | O_CLOEXEC);
+    if (_chip < 0)
+    {
+	fprintf(stderr, "RHLinuxGpio: could not open %s: %s\n", _chipName, strerror(errno));
+	return false;
+    }
+    return true;
+}
+
+bool RHLinuxGpio::openEpoll()
+{
+    if (_epoll >= 0)
+	return true;
+    _epoll = epoll_create1(EPOLL_CLOEXEC);
+    if (_epoll < 0)
+    {
+	fprintf(stderr, "RHLinuxGpio: epoll_create1 failed: %s\n", strerror(errno));
+	return false;
+    }
+    return true;
+}
+
+bool RHLinuxGpio::attach(uint8_t line, Handler handler, int mode)
+{
+    if (line >= RH_LINUX_GPIO_MAX_LINES || !openChip())
+	return false;
+
+    struct gpio_v2_line_request request;
+    memset(&request, 0, sizeof(request));
+    request.offsets[0] = line;
+    request.num_lines = 1;
+    strncpy(request.consumer, "RadioHead", sizeof(request.consumer) - 1);
+    request.config.flags = GPIO_V2_LINE_FLAG_INPUT;
+    if (mode == RH_LINUX_GPIO_RISING || mode == RH_LINUX_GPIO_CHANGE)
+	request.config.flags |= GPIO_V2_LINE_FLAG_EDGE_RISING;
+    if (mode == RH_LINUX_GPIO_FALLING || mode == RH_LINUX_GPIO_CHANGE)
+	request.config.flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING;
+    if (ioctl(_chip, GPIO_V2_GET_LINE_IOCTL, &request) < 0)
+    {
+	fprintf(stderr, "RHLinuxGpio: could not request line %d of %s: %s\n", line, _chipName, strerror(errno));
+	return false;
+    }
+    return attachFd(line, request.fd, handler);
+}
+
+bool RHLinuxGpio::attachFd(uint8_t line, int fd, Handler handler)
+{
+    if (line >= RH_LINUX_GPIO_MAX_LINES || !openEpoll())
+    {
+	close(fd);
+	return false;
+    }
+    detach(line);
+
+    // service() reads until there is nothing left
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u32 = line;
+    if (epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &event) < 0)
+    {
+	fprintf(stderr, "RHLinuxGpio: could not watch line %d: %s\n", line, strerror(errno));
+	close(fd);
+	return false;
+    }
+    _fds[line] = fd;
+    _handlers[line] = handler;
+    return true;
+}
+
+void RHLinuxGpio::detach(uint8_t line)
+{
+    if (line >= RH_LINUX_GPIO_MAX_LINES || _fds[line] < 0)
+	return;
+    epoll_ctl(_epoll, EPOLL_CTL_DEL, _fds[line], NULL);
+    close(_fds[line]); // Releases the line
+    _fds[line] = -1;
+    _handlers[line] = NULL;
+}
+
+int RHLinuxGpio::fd()
+{
+    openEpoll();
+    return _epoll;
+}
+
+int RHLinuxGpio::service(int timeout)
+{
+    if (!openEpoll())
+	return -1;
+
+    struct epoll_event ready[RH_LINUX_GPIO_MAX_LINES];
+    int count = epoll_wait(_epoll, ready, RH_LINUX_GPIO_MAX_LINES, timeout);
+    if (count < 0)
+	return errno == EINTR ? 0 : -1;
+
+    int calls = 0;
+    for (int i = 0; i < count; i++)
+    {
+	uint8_t line = ready[i].data.u32;
+	struct gpio_v2_line_event events[RH_LINUX_GPIO_READ_EVENTS];
+	ssize_t len = -1;
+	// A handler may detach its own line
+	while (_fds[line] >= 0 && (len = read(_fds[line], events, sizeof(events))) > 0)
+	{
+	    for (ssize_t j = 0; j < len / (ssize_t)sizeof(events[0]) && _handlers[line]; j++)
+	    {
+		_handlers[line]();
+		calls++;
+	    }
+	}
+	if (len == 0)
+	    detach(line); // The writer of an attachFd() descriptor went away
+    }
+    return calls;
+}
+
+#endif
@@ -0,0 +1,117 @@
+// RHLinuxGpio.h
+//
+// Interrupts from GPIO lines through the Linux GPIO character device
+// Copyright (C) 2019 desplega.com
+
+#ifndef RHLinuxGpio_h
+#define RHLinuxGpio_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Number of GPIO lines that can have a handler: covers the 54 lines of the BCM283x
+#ifndef RH_LINUX_GPIO_MAX_LINES
+ #define RH_LINUX_GPIO_MAX_LINES 64
+#endif
+
+// Edges to interrupt on, as for attachInterrupt() on Arduino
+#define RH_LINUX_GPIO_CHANGE  1
+#define RH_LINUX_GPIO_FALLING 2
+#define RH_LINUX_GPIO_RISING  3
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHLinuxGpio RHLinuxGpio.h <RHutil/RHLinuxGpio.h>
+/// \brief Delivers edges on GPIO lines to interrupt handlers, through the Linux GPIO character device
+///
+/// Linux programs can't take real interrupts. This class requests lines from a GPIO chip
+/// (eg /dev/gpiochip0) with edge detection (GPIO v2 uAPI, Linux 5.10 and later), and the kernel queues
+/// an event for each edge. All the lines are watched by one epoll file descriptor, fd(). service()
+/// waits on it and calls the handler of each line once per edge, like an interrupt would, but from
+/// the calling thread. So the handlers don't race with the main line, and ATOMIC_BLOCK_START
+/// has nothing to disable.
+///
+/// On RH_PLATFORM_RASPI, attachInterrupt() uses one for the drivers (eg RH_RF95), and yield() (called by
+/// the driver spin loops through YIELD) services it without waiting. A program that has nothing else to do
+/// waits for the radio with no CPU use:
+/// \code
+/// rf95.setModeRx();
+/// while (1)
+/// {
+///     gpioServiceInterrupts(-1); // Sleeps until DIO0 rises and calls the RH_RF95 interrupt handler
+///     if (rf95.available())
+///     ...
+/// }
+/// \endcode
+/// or adds rf95.eventFd() to its own epoll or select() loop, and calls rf95.handleEvents() when it is readable.
+///
+/// The chip is named by the constructor, else by the RH_GPIOCHIP environment variable, else /dev/gpiochip0.
+/// It can be one made by the gpio-sim kernel module for tests, whose lines are driven through configfs
+/// and sysfs. attachFd() can also take any file descriptor that delivers struct gpio_v2_line_event
+/// records, such as a pipe written by a test.
+///
+/// Errors are reported on stderr.
+class RHLinuxGpio
+{
+public:
+    /// The type of interrupt handlers
+    typedef void (*Handler)(void);
+
+    /// Constructor. Opens nothing until the first attach()
+    /// \param[in] chip Path of the GPIO chip device, NULL for $RH_GPIOCHIP or /dev/gpiochip0
+    RHLinuxGpio(const char* chip = NULL);
+
+    /// Releases the lines and closes the chip
+    ~RHLinuxGpio();
+
+    /// Requests a line of the chip as an input with edge detection, and calls handler for each edge.
+    /// \param[in] line Offset of the line on the chip, eg the BCM GPIO number on a Raspberry Pi
+    /// \param[in] handler Function to call
+    /// \param[in] mode Edges to detect, one of RH_LINUX_GPIO_*
+    /// \return true if the line could be requested
+    bool attach(uint8_t line, Handler handler, int mode);
+
+    /// Calls handler for the events read from fd, instead of requesting the line from the chip.
+    /// Takes ownership of fd, which is closed by detach().
+    /// \param[in] line Number the handler is attached to, for detach()
+    /// \param[in] fd A file descriptor that delivers struct gpio_v2_line_event records
+    /// \param[in] handler Function to call
+    /// \return true if successful
+    bool attachFd(uint8_t line, int fd, Handler handler);
+
+    /// Stops calling the handler of line, and releases it
+    /// \param[in] line The line passed to attach() or attachFd()
+    void detach(uint8_t line);
+
+    /// Returns the epoll file descriptor that becomes readable when an edge is waiting to be serviced
+    /// \return The file descriptor, or -1 if it could not be created
+    int  fd();
+
+    /// Waits for edges and calls their handlers
+    /// \param[in] timeout Milliseconds to wait for the first edge: 0 only looks, -1 waits for ever
+    /// \return The number of handler calls, 0 on timeout, -1 on error
+    int  service(int timeout);
+
+private:
+    /// Opens the chip, on first use
+    bool openChip();
+
+    /// Opens the epoll file descriptor, on first use
+    bool openEpoll();
+
+    /// Path of the chip device
+    const char* _chipName;
+
+    /// The chip device, -1 if not open
+    int         _chip;
+
+    /// The epoll file descriptor, -1 if not open
+    int         _epoll;
+
+    /// The line requests (or attachFd() descriptors), -1 when not attached
+    int         _fds[RH_LINUX_GPIO_MAX_LINES];
+
+    /// The handlers of the lines
+    Handler     _handlers[RH_LINUX_GPIO_MAX_LINES];
+};
+
+#endif
@@ -0,0 +1,96 @@
+// RHLinuxSPI.cpp
+//
+// Copyright (C) 2019 desplega.com
+
+#if defined(__linux__)
+
+#include <RHutil/RHLinuxSPI.h>
+#include <linux/spi/spidev.h>
+#include <sys/ioctl.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+RHLinuxSPI::RHLinuxSPI(const char* device, Frequency frequency, BitOrder bitOrder, DataMode dataMode)
+    :
+    RHGenericSPI(frequency, bitOrder, dataMode),
+    _device(device),
+    _fd(-1),
+    _messages(0)
+{
+}
+
+uint8_t RHLinuxSPI::transfer(uint8_t data)
+{
+    uint8_t val = 0;
+    Transfer t = { &data, &val, 1, true };
+    transferMessage(RH_SPI_NO_SLAVE_SELECT, &t, 1);
+    return val;
+}
+
+void RHLinuxSPI::transferMessage(uint8_t slaveSelectPin, const Transfer* transfers, uint8_t count)
+{
+    (void)slaveSelectPin;
+    if (_fd < 0)
+	return;
+
+    struct spi_ioc_transfer messages[RH_LINUX_SPI_MAX_TRANSFERS];
+    while (count)
+    {
+	uint8_t n = count < RH_LINUX_SPI_MAX_TRANSFERS ? count : RH_LINUX_SPI_MAX_TRANSFERS;
+	memset(messages, 0, n * sizeof(messages[0]));
+	for (uint8_t i = 0; i < n; i++)
+	{
+	    // NULL buffers: the kernel sends zeros and discards what is received
+	    messages[i].tx_buf = (unsigned long)transfers[i].tx;
+	    messages[i].rx_buf = (unsigned long)transfers[i].rx;
+	    messages[i].len = transfers[i].len;
+	    // The kernel deselects the device at the end of each ioctl, where cs_change would keep it selected
+	    messages[i].cs_change = transfers[i].deselect && i != n - 1;
+	}
+	_messages++;
+	if (ioctl(_fd, SPI_IOC_MESSAGE(n), messages) < 0)
+	    fprintf(stderr, "RHLinuxSPI: transfer on %s failed: %s\n", _device, strerror(errno));
+	transfers += n;
+	count -= n;
+    }
+}
+
+void RHLinuxSPI::begin()
+{
+    if (_fd >= 0)
+	return;
+    _fd = open(_device, O_RDWR | O_CLOEXEC);
+    if (_fd < 0)
+    {
+	fprintf(stderr, "RHLinuxSPI: could not open %s: %s\n", _device, strerror(errno));
+	return;
+    }
+
+    static const uint8_t modes[] = { SPI_MODE_0, SPI_MODE_1, SPI_MODE_2, SPI_MODE_3 };
+    uint8_t mode = modes[_dataMode];
+    uint8_t lsbFirst = _bitOrder == BitOrderLSBFirst;
+    uint8_t bits = 8;
+    uint32_t speed = 1000000UL << _frequency; // 1, 2, 4, 8 or 16 MHz
+    if (ioctl(_fd, SPI_IOC_WR_MODE, &mode) < 0
+	|| ioctl(_fd, SPI_IOC_WR_LSB_FIRST, &lsbFirst) < 0
+	|| ioctl(_fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0
+	|| ioctl(_fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) < 0)
+	fprintf(stderr, "RHLinuxSPI: could not configure %s: %s\n", _device, strerror(errno));
+}
+
+void RHLinuxSPI::end()
+{
+    if (_fd >= 0)
+	close(_fd);
+    _fd = -1;
+}
+
+uint32_t RHLinuxSPI::messages()
+{
+    return _messages;
+}
+
+#endif
@@ -0,0 +1,79 @@
+// RHLinuxSPI.h
+//
+// SPI interface on the Linux spidev driver
+// Copyright (C) 2019 desplega.com
+
+#ifndef RHLinuxSPI_h
+#define RHLinuxSPI_h
+
+#include <RHGenericSPI.h>
+
+// Max number of transfers in one system call. Longer messages take several
+#ifndef RH_LINUX_SPI_MAX_TRANSFERS
+ #define RH_LINUX_SPI_MAX_TRANSFERS 16
+#endif
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHLinuxSPI RHLinuxSPI.h <RHutil/RHLinuxSPI.h>
+/// \brief SPI interface on a Linux spidev device, such as /dev/spidev0.0 on a Raspberry Pi
+///
+/// The kernel drives the chip select of the device (CE0 for /dev/spidev0.0), so give the driver
+/// RH_SPI_NO_SLAVE_SELECT as its slave select pin:
+/// \code
+/// RHLinuxSPI spi("/dev/spidev0.0", RHGenericSPI::Frequency8MHz);
+/// RH_RF95 rf95(RH_SPI_NO_SLAVE_SELECT, 25, spi); // DIO0 on GPIO 25
+/// \endcode
+/// transferMessage() turns a whole message (for RHSPIDriver, a register address and the octets
+/// of a burst, or a sequence of register writes from spiWriteRegisters()) into one SPI_IOC_MESSAGE ioctl,
+/// where the bcm2835 SPIClass takes a call for each octet. Each transfer(uint8_t) is a message of its
+/// own, with the chip selected for that octet only, so drivers must use transferMessage(), as RHSPIDriver
+/// and RHNRFSPIDriver do on Linux.
+///
+/// Errors are reported on stderr.
+class RHLinuxSPI : public RHGenericSPI
+{
+public:
+    /// Constructor
+    /// \param[in] device Path of the spidev device
+    /// \param[in] frequency SPI bus frequency, one of RHGenericSPI::Frequency
+    /// \param[in] bitOrder Select the SPI bus bit order, one of RHGenericSPI::BitOrder
+    /// \param[in] dataMode Selects the SPI bus data mode. One of RHGenericSPI::DataMode
+    RHLinuxSPI(const char* device = "/dev/spidev0.0", Frequency frequency = Frequency1MHz,
+	       BitOrder bitOrder = BitOrderMSBFirst, DataMode dataMode = DataMode0);
+
+    /// Transfers a single octet, selecting the device for it
+    /// \param[in] data The octet to send
+    /// \return The octet read while data was sent, 0 on error
+    uint8_t transfer(uint8_t data);
+
+    /// Transfers a message with one ioctl (per RH_LINUX_SPI_MAX_TRANSFERS transfers).
+    /// The device is deselected between two ioctls, so a transfer that does not deselect (eg the register
+    /// address of a burst) must not be the last of a chunk of RH_LINUX_SPI_MAX_TRANSFERS: a register access
+    /// cannot straddle a chunk boundary. RHSPIDriver never sends more than RH_SPI_MAX_REGISTERS per message
+    /// \param[in] slaveSelectPin Ignored: the kernel selects the device
+    /// \param[in] transfers The transfers
+    /// \param[in] count Number of transfers
+    void transferMessage(uint8_t slaveSelectPin, const Transfer* transfers, uint8_t count);
+
+    /// Opens the device and configures it with the bus frequency, bit order and data mode
+    void begin();
+
+    /// Closes the device
+    void end();
+
+    /// Returns the number of ioctls made, to measure the system calls per packet
+    /// \return The number of SPI_IOC_MESSAGE ioctls since the constructor
+    uint32_t messages();
+
+private:
+    /// Path of the device
+    const char* _device;
+
+    /// The open device, -1 if not open
+    int         _fd;
+
+    /// Number of SPI_IOC_MESSAGE ioctls
+    uint32_t    _messages;
+};
+
+#endif
@@ -0,0 +1,478 @@
+// RHSimSX1276.cpp
+//
+// Register level model of a Semtech SX1276 LoRa radio, for running RH_RF95 in the simulator
+// Copyright (C) 2019 desplega.com
+
+#include <RHutil/RHSimSX1276.h>
+#if (RH_PLATFORM == RH_PLATFORM_UNIX)
+
+#include <RH_RF95.h>
+#include <RHTcpProtocol.h>
+#include <errno.h>
+#include <netdb.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// Registers the driver may not write
+#define RH_SIM_READ_ONLY(reg) ((reg) == RH_RF95_REG_10_FIFO_RX_CURRENT_ADDR \
+			       || ((reg) >= RH_RF95_REG_13_RX_NB_BYTES && (reg) <= RH_RF95_REG_1C_HOP_CHANNEL) \
+			       || (reg) == RH_RF95_REG_25_FIFO_RX_BYTE_ADDR \
+			       || ((reg) >= RH_RF95_REG_28_FEI_MSB && (reg) <= RH_RF95_REG_2A_FEI_LSB) \
+			       || (reg) == RH_RF95_REG_42_VERSION)
+
+// Noise floor reported in RH_RF95_REG_1B_RSSI_VALUE, in dBm
+#define RH_SIM_NOISE_FLOOR -120
+
+// Monotonic time in microseconds
+static uint64_t nowUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+RHSimSX1276::RHSimSX1276(RHSimEther& ether, uint8_t slaveSelectPin, uint8_t interruptPin)
+    :
+    _ether(ether),
+    _slaveSelectPin(slaveSelectPin),
+    _interruptPin(interruptPin),
+    _selected(false),
+    _addressPhase(false),
+    _writing(false),
+    _address(0),
+    _txPending(false),
+    _txDoneAt(0),
+    _airtime(false),
+    _dio0(false)
+{
+    // Reset values from the SX1276/77/78/79 datasheet, LoRa page
+    memset(_registers, 0, sizeof(_registers));
+    memset(_fifo, 0, sizeof(_fifo));
+    _registers[RH_RF95_REG_01_OP_MODE] = 0x09; // FSK, low frequency mode, standby
+    _registers[RH_RF95_REG_06_FRF_MSB] = 0x6c;
+    _registers[RH_RF95_REG_07_FRF_MID] = 0x80;
+    _registers[RH_RF95_REG_09_PA_CONFIG] = 0x4f;
+    _registers[RH_RF95_REG_0A_PA_RAMP] = 0x09;
+    _registers[RH_RF95_REG_0B_OCP] = 0x2b;
+    _registers[RH_RF95_REG_0C_LNA] = 0x20;
+    _registers[RH_RF95_REG_0E_FIFO_TX_BASE_ADDR] = 0x80;
+    _registers[RH_RF95_REG_1B_RSSI_VALUE] = RH_SIM_NOISE_FLOOR + 164;
+    _registers[RH_RF95_REG_1D_MODEM_CONFIG1] = 0x72;
+    _registers[RH_RF95_REG_1E_MODEM_CONFIG2] = 0x70;
+    _registers[RH_RF95_REG_1F_SYMB_TIMEOUT_LSB] = 0x64;
+    _registers[RH_RF95_REG_21_PREAMBLE_LSB] = 0x08;
+    _registers[RH_RF95_REG_22_PAYLOAD_LENGTH] = 0x01;
+    _registers[RH_RF95_REG_23_MAX_PAYLOAD_LENGTH] = 0xff;
+    _registers[RH_RF95_REG_39_SYNC_WORD] = 0x12;
+    _registers[RH_RF95_REG_42_VERSION] = 0x12;
+    resetStats();
+    _ether.attach(this);
+}
+
+uint8_t RHSimSX1276::transfer(uint8_t data)
+{
+    _stats.spiBytes++;
+    if (!_selected)
+	return 0; // Not driven: the chip ignores the bus
+    if (_addressPhase)
+    {
+	_address = data & ~RH_SPI_WRITE_MASK;
+	_writing = data & RH_SPI_WRITE_MASK;
+	_addressPhase = false;
+	return 0;
+    }
+
+    uint8_t ret = 0;
+    if (_writing)
+	writeRegister(_address, data);
+    else
+	ret = readRegister(_address);
+    // Bursts auto increment the address, except in the FIFO
+    if (_address != RH_RF95_REG_00_FIFO)
+	_address = (_address + 1) & ~RH_SPI_WRITE_MASK;
+    return ret;
+}
+
+bool RHSimSX1276::spiTransfer(uint8_t data, uint8_t* result)
+{
+    if (!_selected)
+	return false;
+    *result = transfer(data);
+    return true;
+}
+
+void RHSimSX1276::pinChanged(uint8_t pin, uint8_t value)
+{
+    if (pin != _slaveSelectPin)
+	return;
+    if (value == LOW && !_selected)
+    {
+	_stats.spiTransactions++;
+	_addressPhase = true;
+    }
+    _selected = value == LOW;
+}
+
+void RHSimSX1276::poll()
+{
+    _ether.poll();
+    if (_txPending && (!_airtime || nowUs() >= _txDoneAt))
+	completeTransmit();
+
+    // The driver's handler runs on the rising edge of DIO0
+    bool dio0 = dio0Level();
+    if (dio0 && !_dio0)
+    {
+	uint64_t start = nowUs();
+	if (simulatorInterrupt(digitalPinToInterrupt(_interruptPin)))
+	{
+	    _stats.interrupts++;
+	    _stats.isrNanos += (nowUs() - start) * 1000;
+	}
+	// The handler normally clears the flags
+	dio0 = dio0Level();
+    }
+    _dio0 = dio0;
+}
+
+void RHSimSX1276::setAirtime(bool airtime)
+{
+    _airtime = airtime;
+}
+
+uint8_t RHSimSX1276::registerValue(uint8_t reg)
+{
+    return _registers[reg & ~RH_SPI_WRITE_MASK];
+}
+
+const RHSimSX1276::Stats& RHSimSX1276::stats()
+{
+    return _stats;
+}
+
+void RHSimSX1276::resetStats()
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+bool RHSimSX1276::transmitting()
+{
+    return _txPending;
+}
+
+bool RHSimSX1276::compatible(RHSimSX1276& other)
+{
+    return memcmp(_registers + RH_RF95_REG_06_FRF_MSB, other._registers + RH_RF95_REG_06_FRF_MSB, 3) == 0
+	&& (_registers[RH_RF95_REG_1D_MODEM_CONFIG1] & RH_RF95_BW) == (other._registers[RH_RF95_REG_1D_MODEM_CONFIG1] & RH_RF95_BW)
+	&& (_registers[RH_RF95_REG_1E_MODEM_CONFIG2] & RH_RF95_SPREADING_FACTOR) == (other._registers[RH_RF95_REG_1E_MODEM_CONFIG2] & RH_RF95_SPREADING_FACTOR)
+	&& _registers[RH_RF95_REG_39_SYNC_WORD] == other._registers[RH_RF95_REG_39_SYNC_WORD];
+}
+
+void RHSimSX1276::receive(const uint8_t* data, uint8_t len, int8_t snr, int16_t rssi)
+{
+    uint8_t mode = _registers[RH_RF95_REG_01_OP_MODE] & RH_RF95_MODE;
+    if (mode != RH_RF95_MODE_RXCONTINUOUS && mode != RH_RF95_MODE_RXSINGLE)
+	return;
+
+    // Received octets are written from the RX base address, wrapping around the FIFO
+    uint8_t addr = _registers[RH_RF95_REG_0F_FIFO_RX_BASE_ADDR];
+    for (uint8_t i = 0; i < len; i++)
+	_fifo[(uint8_t)(addr + i)] = data[i];
+    _registers[RH_RF95_REG_10_FIFO_RX_CURRENT_ADDR] = addr;
+    _registers[RH_RF95_REG_13_RX_NB_BYTES] = len;
+    _registers[RH_RF95_REG_25_FIFO_RX_BYTE_ADDR] = addr + len;
+
+    // Inverse of the packet RSSI formula of the SX1276/77/78/79 datasheet section 5.5.5
+    bool hf = (((uint32_t)_registers[RH_RF95_REG_06_FRF_MSB] << 16) | ((uint16_t)_registers[RH_RF95_REG_07_FRF_MID] << 8)
+	       | _registers[RH_RF95_REG_08_FRF_LSB]) >= RH_RF95_HF_PORT_MIN_FREQUENCY * 1000000.0 / RH_RF95_FSTEP;
+    int16_t value = rssi + (hf ? 157 : 164);
+    if (snr < 0)
+	value -= snr / 4;
+    else
+	value = value * 15 / 16;
+    _registers[RH_RF95_REG_19_PKT_SNR_VALUE] = snr;
+    _registers[RH_RF95_REG_1A_PKT_RSSI_VALUE] = value < 0 ? 0 : value > 255 ? 255 : value;
+
+    uint16_t count = ((uint16_t)_registers[RH_RF95_REG_16_RX_PACKET_CNT_VALUE_MSB] << 8 | _registers[RH_RF95_REG_17_RX_PACKET_CNT_VALUE_LSB]) + 1;
+    _registers[RH_RF95_REG_14_RX_HEADER_CNT_VALUE_MSB] = _registers[RH_RF95_REG_16_RX_PACKET_CNT_VALUE_MSB] = count >> 8;
+    _registers[RH_RF95_REG_15_RX_HEADER_CNT_VALUE_LSB] = _registers[RH_RF95_REG_17_RX_PACKET_CNT_VALUE_LSB] = count;
+
+    _registers[RH_RF95_REG_12_IRQ_FLAGS] |= RH_RF95_VALID_HEADER | RH_RF95_RX_DONE;
+    if (mode == RH_RF95_MODE_RXSINGLE)
+	_registers[RH_RF95_REG_01_OP_MODE] = (_registers[RH_RF95_REG_01_OP_MODE] & ~RH_RF95_MODE) | RH_RF95_MODE_STDBY;
+    _stats.rxPackets++;
+}
+
+void RHSimSX1276::writeRegister(uint8_t reg, uint8_t value)
+{
+    if (reg == RH_RF95_REG_00_FIFO)
+	_fifo[_registers[RH_RF95_REG_0D_FIFO_ADDR_PTR]++] = value;
+    else if (reg == RH_RF95_REG_01_OP_MODE)
+	setMode(value);
+    else if (reg == RH_RF95_REG_12_IRQ_FLAGS)
+	_registers[reg] &= ~value; // Flags are cleared by writing 1
+    else if (!RH_SIM_READ_ONLY(reg))
+	_registers[reg] = value;
+}
+
+uint8_t RHSimSX1276::readRegister(uint8_t reg)
+{
+    if (reg == RH_RF95_REG_00_FIFO)
+	return _fifo[_registers[RH_RF95_REG_0D_FIFO_ADDR_PTR]++];
+    return _registers[reg];
+}
+
+void RHSimSX1276::setMode(uint8_t opMode)
+{
+    uint8_t old = _registers[RH_RF95_REG_01_OP_MODE];
+    // LongRangeMode can only be changed in or on the way into sleep mode
+    if ((old & RH_RF95_MODE) != RH_RF95_MODE_SLEEP && (opMode & RH_RF95_MODE) != RH_RF95_MODE_SLEEP)
+	opMode = (opMode & ~RH_RF95_LONG_RANGE_MODE) | (old & RH_RF95_LONG_RANGE_MODE);
+    _registers[RH_RF95_REG_01_OP_MODE] = opMode;
+
+    uint8_t mode = opMode & RH_RF95_MODE;
+    if (mode == (old & RH_RF95_MODE))
+	return;
+    _txPending = false;
+    if (mode == RH_RF95_MODE_TX)
+    {
+	_txPending = true;
+	uint8_t config1 = _registers[RH_RF95_REG_1D_MODEM_CONFIG1];
+	uint8_t config2 = _registers[RH_RF95_REG_1E_MODEM_CONFIG2];
+	_txDoneAt = nowUs() + RH_RF95::timeOnAirUs(_registers[RH_RF95_REG_22_PAYLOAD_LENGTH], config2 >> 4,
+						    (RH_RF95::Bandwidth)(config1 >> 4), ((config1 & RH_RF95_CODING_RATE) >> 1) + 4,
+						    ((uint16_t)_registers[RH_RF95_REG_20_PREAMBLE_MSB] << 8) | _registers[RH_RF95_REG_21_PREAMBLE_LSB],
+						    config2 & RH_RF95_PAYLOAD_CRC_ON);
+    }
+    else if (mode == RH_RF95_MODE_CAD)
+    {
+	// Detection takes a couple of symbols, report it at the next yield()
+	_registers[RH_RF95_REG_12_IRQ_FLAGS] |= RH_RF95_CAD_DONE | (_ether.channelActive(this) ? RH_RF95_CAD_DETECTED : 0);
+	_registers[RH_RF95_REG_01_OP_MODE] = (opMode & ~RH_RF95_MODE) | RH_RF95_MODE_STDBY;
+    }
+}
+
+void RHSimSX1276::completeTransmit()
+{
+    _txPending = false;
+    uint8_t packet[256];
+    uint8_t len = _registers[RH_RF95_REG_22_PAYLOAD_LENGTH];
+    uint8_t addr = _registers[RH_RF95_REG_0E_FIFO_TX_BASE_ADDR];
+    for (uint8_t i = 0; i < len; i++)
+	packet[i] = _fifo[(uint8_t)(addr + i)];
+    _registers[RH_RF95_REG_12_IRQ_FLAGS] |= RH_RF95_TX_DONE;
+    _registers[RH_RF95_REG_01_OP_MODE] = (_registers[RH_RF95_REG_01_OP_MODE] & ~RH_RF95_MODE) | RH_RF95_MODE_STDBY;
+    _stats.txPackets++;
+    _ether.transmit(this, packet, len);
+}
+
+bool RHSimSX1276::dio0Level()
+{
+    uint8_t flag;
+    switch (_registers[RH_RF95_REG_40_DIO_MAPPING1] >> 6)
+    {
+    case 0:
+	flag = RH_RF95_RX_DONE;
+	break;
+    case 1:
+	flag = RH_RF95_TX_DONE;
+	break;
+    case 2:
+	flag = RH_RF95_CAD_DONE;
+	break;
+    default:
+	return false;
+    }
+    return (_registers[RH_RF95_REG_12_IRQ_FLAGS] & flag) && !(_registers[RH_RF95_REG_11_IRQ_FLAGS_MASK] & flag);
+}
+
+////////////////////////////////////////////////////////////////////
+// RHSimEther
+RHSimEther::RHSimEther()
+    :
+    _numChips(0),
+    _snr(40),
+    _rssi(-60),
+    _lossPercent(0)
+{
+}
+
+void RHSimEther::setLink(int8_t snr, int16_t rssi)
+{
+    _snr = snr;
+    _rssi = rssi;
+}
+
+void RHSimEther::setLossPercent(uint8_t percent)
+{
+    _lossPercent = percent;
+}
+
+bool RHSimEther::attach(RHSimSX1276* chip)
+{
+    if (_numChips >= RH_SIM_ETHER_MAX_CHIPS)
+    {
+	fprintf(stderr, "RHSimEther::attach too many chips\n");
+	return false;
+    }
+    _chips[_numChips++] = chip;
+    return true;
+}
+
+void RHSimEther::transmit(RHSimSX1276* from, const uint8_t* data, uint8_t len)
+{
+    deliver(from, data, len);
+}
+
+bool RHSimEther::channelActive(RHSimSX1276* listener)
+{
+    for (uint8_t i = 0; i < _numChips; i++)
+	if (_chips[i] != listener && _chips[i]->transmitting() && _chips[i]->compatible(*listener))
+	    return true;
+    return false;
+}
+
+void RHSimEther::deliver(RHSimSX1276* from, const uint8_t* data, uint8_t len)
+{
+    for (uint8_t i = 0; i < _numChips; i++)
+    {
+	if (_chips[i] == from || (from && !_chips[i]->compatible(*from)))
+	    continue;
+	if (_lossPercent && random(100) < _lossPercent)
+	    continue;
+	_chips[i]->receive(data, len, _snr, _rssi);
+    }
+}
+
+////////////////////////////////////////////////////////////////////
+// RHSimTcpEther
+RHSimTcpEther::RHSimTcpEther(const char* server)
+    :
+    _server(server),
+    _socket(-1),
+    _thisAddress(-1),
+    _socketBufLen(0)
+{
+}
+
+bool RHSimTcpEther::init()
+{
+    std::string server(_server);
+    std::string port("4000");
+    size_t indexOfSeparator = server.find_first_of(':');
+    if (indexOfSeparator != std::string::npos)
+    {
+	port = server.substr(indexOfSeparator+1);
+	server.erase(indexOfSeparator);
+    }
+
+    struct addrinfo hints;
+    struct addrinfo *result, *rp;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int s = getaddrinfo(server.c_str(), port.c_str(), &hints, &result);
+    if (s != 0)
+    {
+	fprintf(stderr, "RHSimTcpEther::init getaddrinfo failed: %s\n", gai_strerror(s));
+	return false;
+    }
+    for (rp = result; rp != NULL; rp = rp->ai_next)
+    {
+	_socket = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+	if (_socket == -1)
+	    continue;
+	if (connect(_socket, rp->ai_addr, rp->ai_addrlen) == 0)
+	    break;
+	close(_socket);
+	_socket = -1;
+    }
+    freeaddrinfo(result);
+    if (_socket < 0)
+    {
+	fprintf(stderr, "RHSimTcpEther::init could not connect to %s\n", _server);
+	return false;
+    }
+
+    int on = 1;
+    if (ioctl(_socket, FIONBIO, (char *)&on) < 0)
+    {
+	fprintf(stderr, "RHSimTcpEther::init failed to set socket non-blocking: %s\n", strerror(errno));
+	close(_socket);
+	_socket = -1;
+	return false;
+    }
+    return true;
+}
+
+void RHSimTcpEther::transmit(RHSimSX1276* from, const uint8_t* data, uint8_t len)
+{
+    deliver(from, data, len);
+    if (_socket < 0 || len < RH_TCP_HEADER_LEN)
+	return;
+
+    // Announce our address from the FROM header, so the simulator can apply link probabilities
+    if (_thisAddress != data[1])
+    {
+	RHTcpThisAddress m;
+	m.length = htonl(2);
+	m.type = RH_TCP_MESSAGE_TYPE_THISADDRESS;
+	m.thisAddress = _thisAddress = data[1];
+	if (write(_socket, &m, sizeof(m)) != sizeof(m))
+	    fprintf(stderr, "RHSimTcpEther::transmit write failed: %s\n", strerror(errno));
+    }
+
+    // The FIFO contents are laid out as the to, from, id, flags and payload of an RHTcpPacket
+    RHTcpTypeMessage m;
+    m.length = htonl(len + 1);
+    m.type = RH_TCP_MESSAGE_TYPE_PACKET;
+    memcpy(m.payload, data, len);
+    if (write(_socket, &m, len + 5) != len + 5)
+	fprintf(stderr, "RHSimTcpEther::transmit write failed: %s\n", strerror(errno));
+}
+
+void RHSimTcpEther::poll()
+{
+    if (_socket < 0)
+	return;
+    ssize_t count = read(_socket, _socketBuf + _socketBufLen, sizeof(_socketBuf) - _socketBufLen);
+    if (count < 0)
+    {
+	if (errno != EAGAIN)
+	    fprintf(stderr, "RHSimTcpEther::poll read error: %s\n", strerror(errno));
+	return;
+    }
+    if (count == 0)
+    {
+	fprintf(stderr, "RHSimTcpEther::poll server closed the connection\n");
+	close(_socket);
+	_socket = -1;
+	return;
+    }
+    _socketBufLen += count;
+
+    while (_socketBufLen >= 5)
+    {
+	RHTcpTypeMessage* message = (RHTcpTypeMessage*)_socketBuf;
+	uint32_t len = ntohl(message->length);
+	if (len > sizeof(_socketBuf) - sizeof(message->length))
+	{
+	    fprintf(stderr, "RHSimTcpEther::poll corrupt message stream, disconnecting\n");
+	    close(_socket);
+	    _socket = -1;
+	    return;
+	}
+	uint32_t messageLen = len + sizeof(message->length);
+	if (_socketBufLen < messageLen)
+	    break; // Wait for the rest of the message
+	if (message->type == RH_TCP_MESSAGE_TYPE_PACKET && len >= 1 + RH_TCP_HEADER_LEN && len - 1 <= RH_RF95_FIFO_SIZE)
+	    deliver(NULL, message->payload, len - 1);
+	memmove(_socketBuf, _socketBuf + messageLen, _socketBufLen - messageLen);
+	_socketBufLen -= messageLen;
+    }
+}
+
+#endif
@@ -0,0 +1,240 @@
+// RHSimSX1276.h
+//
+// Register level model of a Semtech SX1276 LoRa radio, for running RH_RF95 in the simulator
+// Copyright (C) 2019 desplega.com
+
+#ifndef RHSimSX1276_h
+#define RHSimSX1276_h
+
+#include <RadioHead.h>
+#if (RH_PLATFORM == RH_PLATFORM_UNIX)
+
+#include <RHGenericSPI.h>
+
+// Maximum number of chips that can share one RHSimEther
+#define RH_SIM_ETHER_MAX_CHIPS 8
+
+class RHSimEther;
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHSimSX1276 RHSimSX1276.h <RHutil/RHSimSX1276.h>
+/// \brief Simulated SX1276 behind a simulated SPI bus, so that the real RH_RF95 driver
+/// can be run, tested and measured on Linux with tools/simBuild.
+///
+/// Pass an instance to the RH_RF95 constructor in place of hardware_spi, with the same
+/// slave select and interrupt pins:
+/// \code
+/// RHSimEther ether;
+/// RHSimSX1276 chip(ether, 10, 2);
+/// RH_RF95 driver(10, 2, chip);
+/// \endcode
+/// A chip also answers on the simulated hardware SPI bus while its slave select is low, so
+/// code that uses the default hardware_spi (eg the firmware in the native build) runs unchanged.
+///
+/// The model covers what RH_RF95 relies on: the register file, SPI framing on chip select
+/// (address byte with write bit, burst address auto increment, FIFO access through
+/// RH_RF95_REG_0D_FIFO_ADDR_PTR), IRQ flags and their mask, the DIO0 mapping, and the
+/// SLEEP, STDBY, TX, RXCONTINUOUS, RXSINGLE and CAD modes. Entering TX sends
+/// RH_RF95_REG_22_PAYLOAD_LENGTH octets from RH_RF95_REG_0E_FIFO_TX_BASE_ADDR to the ether, which
+/// writes them into the FIFO of every other chip that is receiving on the same frequency, modem
+/// configuration and sync word.
+///
+/// DIO0 is a level computed from the IRQ flags, and its rising edge calls the interrupt
+/// handler attached to the interrupt pin. Edges are only delivered from yield(), which the
+/// simulator calls from delay() and the driver spin loops, never during an SPI transaction.
+///
+/// By default a transmission completes at the next yield(). With setAirtime(true) it takes its
+/// real time on air, which makes timeouts, CAD and duty cycle behave as on hardware.
+///
+/// stats() counts the SPI transactions and octets the driver issued and the time spent in its
+/// interrupt handler, which makes driver performance regressions measurable.
+class RHSimSX1276 : public RHGenericSPI, public SimulatorDevice
+{
+public:
+    /// \brief Driver cost counters
+    typedef struct
+    {
+	uint32_t   spiTransactions;  ///< Number of chip select assertions
+	uint32_t   spiBytes;         ///< Octets transferred, including address octets
+	uint32_t   interrupts;       ///< Number of DIO0 rising edges delivered
+	uint64_t   isrNanos;         ///< Wall time spent in the interrupt handler
+	uint32_t   txPackets;        ///< Packets transmitted
+	uint32_t   rxPackets;        ///< Packets written into the FIFO
+    } Stats;
+
+    /// Constructor.
+    /// \param[in] ether The ether to transmit into and receive from
+    /// \param[in] slaveSelectPin The pin the driver uses as chip select
+    /// \param[in] interruptPin The pin DIO0 is connected to
+    RHSimSX1276(RHSimEther& ether, uint8_t slaveSelectPin = SS, uint8_t interruptPin = 2);
+
+    /// Transfers an octet over the simulated SPI bus
+    /// \param[in] data The octet from the driver
+    /// \return The octet from the chip
+    uint8_t transfer(uint8_t data);
+
+    /// Simulated SPI needs no setup
+    void begin() {}
+
+    /// Simulated SPI needs no setup
+    void end() {}
+
+    /// Tracks chip select
+    void pinChanged(uint8_t pin, uint8_t value);
+
+    /// Answers transfers on the hardware SPI bus while selected
+    bool spiTransfer(uint8_t data, uint8_t* result);
+
+    /// Completes transmissions and delivers DIO0 edges
+    void poll();
+
+    /// Makes transmissions take their real time on air
+    /// \param[in] airtime true to simulate time on air
+    void setAirtime(bool airtime);
+
+    /// Returns the value of a register without counting an SPI transaction
+    /// \param[in] reg The register address
+    uint8_t registerValue(uint8_t reg);
+
+    /// Returns the counters accumulated since construction or the last resetStats()
+    const Stats& stats();
+
+    /// Zeroes the counters
+    void resetStats();
+
+    /// Tells whether the chip is transmitting
+    bool transmitting();
+
+    /// Tells whether two chips are tuned so that one can receive the other:
+    /// same frequency, bandwidth, spreading factor and sync word
+    bool compatible(RHSimSX1276& other);
+
+    /// Called by the ether: writes a packet into the FIFO if the chip is receiving
+    /// \param[in] data The packet, starting with the RadioHead headers
+    /// \param[in] len Number of octets in data
+    /// \param[in] snr SNR to report, in units of 0.25 dB
+    /// \param[in] rssi Packet RSSI to report in dBm
+    void receive(const uint8_t* data, uint8_t len, int8_t snr, int16_t rssi);
+
+protected:
+    /// Applies a write from the SPI bus to a register
+    void    writeRegister(uint8_t reg, uint8_t value);
+
+    /// Serves a read from the SPI bus
+    uint8_t readRegister(uint8_t reg);
+
+    /// Starts or stops activity after RH_RF95_REG_01_OP_MODE changed
+    void    setMode(uint8_t opMode);
+
+    /// Sends the packet in the FIFO to the ether
+    void    completeTransmit();
+
+    /// Returns the level of DIO0: the IRQ flag selected by RH_RF95_REG_40_DIO_MAPPING1, unless masked
+    bool    dio0Level();
+
+private:
+    RHSimEther&  _ether;
+    uint8_t      _slaveSelectPin;
+    uint8_t      _interruptPin;
+    bool         _selected;
+    bool         _addressPhase;
+    bool         _writing;
+    uint8_t      _address;
+    uint8_t      _registers[0x80];
+    uint8_t      _fifo[256];
+    bool         _txPending;
+    uint64_t     _txDoneAt;
+    bool         _airtime;
+    bool         _dio0;
+    Stats        _stats;
+};
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHSimEther RHSimSX1276.h <RHutil/RHSimSX1276.h>
+/// \brief Connects RHSimSX1276 chips in one process.
+///
+/// Every packet a chip transmits is delivered to all other compatible chips, with the configured
+/// SNR and RSSI, unless dropped by the configured loss rate.
+class RHSimEther
+{
+public:
+    /// Constructor
+    RHSimEther();
+
+    /// Destructor
+    virtual ~RHSimEther() {}
+
+    /// Sets the signal quality receivers report
+    /// \param[in] snr SNR in units of 0.25 dB
+    /// \param[in] rssi Packet RSSI in dBm
+    void         setLink(int8_t snr, int16_t rssi);
+
+    /// Sets the share of packets lost on the way to each receiver
+    /// \param[in] percent 0 to 100
+    void         setLossPercent(uint8_t percent);
+
+    /// Called by RHSimSX1276 on construction
+    bool         attach(RHSimSX1276* chip);
+
+    /// Delivers a packet to every compatible chip other than the sender
+    /// \param[in] from The transmitting chip
+    /// \param[in] data The packet
+    /// \param[in] len Number of octets in data
+    virtual void transmit(RHSimSX1276* from, const uint8_t* data, uint8_t len);
+
+    /// Tells whether a compatible chip is transmitting, for CAD
+    /// \param[in] listener The chip doing channel activity detection
+    bool         channelActive(RHSimSX1276* listener);
+
+    /// Called by the chips from yield(), for subclasses that receive from outside the process
+    virtual void poll() {}
+
+protected:
+    /// Delivers a packet to every attached chip that is compatible with from, except from.
+    /// from may be NULL for packets from outside the process, which go to every chip.
+    void         deliver(RHSimSX1276* from, const uint8_t* data, uint8_t len);
+
+private:
+    RHSimSX1276* _chips[RH_SIM_ETHER_MAX_CHIPS];
+    uint8_t      _numChips;
+    int8_t       _snr;
+    int16_t      _rssi;
+    uint8_t      _lossPercent;
+};
+
+/////////////////////////////////////////////////////////////////////
+/// \class RHSimTcpEther RHSimSX1276.h <RHutil/RHSimSX1276.h>
+/// \brief An RHSimEther that also exchanges packets with tools/etherSimulator.pl,
+/// so that simulated RH_RF95 nodes can talk to RH_TCP nodes and to each other across processes.
+///
+/// Packets are carried with RH_TCP_MESSAGE_TYPE_PACKET, whose to, from, id and flags octets are
+/// the RadioHead headers RH_RF95 puts at the start of the FIFO. The FROM header of the
+/// first packet transmitted is announced with RH_TCP_MESSAGE_TYPE_THISADDRESS, for the
+/// link probabilities in the simulator's configuration.
+class RHSimTcpEther : public RHSimEther
+{
+public:
+    /// Constructor
+    /// \param[in] server Name and optionally port of the etherSimulator.pl server, as RH_TCP
+    RHSimTcpEther(const char* server = "localhost:4000");
+
+    /// Connects to the server
+    /// \return true if connected
+    bool         init();
+
+    /// Delivers locally and sends to the server
+    void         transmit(RHSimSX1276* from, const uint8_t* data, uint8_t len);
+
+    /// Delivers packets from the server
+    void         poll();
+
+private:
+    const char*  _server;
+    int          _socket;
+    int16_t      _thisAddress;
+    uint8_t      _socketBuf[512];
+    uint16_t     _socketBufLen;
+};
+
+#endif
+#endif
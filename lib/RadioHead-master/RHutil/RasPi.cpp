@@ -9,12 +9,17 @@
 #include <RadioHead.h>
 
 #if (RH_PLATFORM == RH_PLATFORM_RASPI)
-#include <sys/time.h>
+#include <errno.h>
 #include <time.h>
+#include <RHClock.h>
 #include "RasPi.h"
 
 //Initialize the values for sanity
-timeval RHStartTime;
+uint32_t RHStartMillis;
+
+//Delivers the interrupts, one per thread: a thread only runs the handlers it attached, so a
+//program can run each driver in its own thread without its handler racing with another thread
+static thread_local RHLinuxGpio RHGpio;
 
 void SPIClass::begin()
 {
@@ -38,7 +43,7 @@ void SPIClass::begin(uint16_t divider, uint8_t bitOrder, uint8_t dataMode)
   bcm2835_spi_begin();
 
   //Initialize a timestamp for millis calculation
-  gettimeofday(&RHStartTime, NULL);
+  RHStartMillis = RHClock::millis();
 }
 
 void SPIClass::end()
@@ -94,24 +99,44 @@ void digitalWrite(unsigned char pin, unsigned char value)
 
 unsigned long millis()
 {
-  //Declare a variable to store current time
-  struct timeval RHCurrentTime;
-  //Get current time
-  gettimeofday(&RHCurrentTime,NULL);
-  //Calculate the difference between our start time and the end time
-  unsigned long difference = ((RHCurrentTime.tv_sec - RHStartTime.tv_sec) * 1000);
-  difference += ((RHCurrentTime.tv_usec - RHStartTime.tv_usec)/1000);
-  //Return the calculated value
-  return difference;
+  //Monotonic: unlike gettimeofday(), it does not jump when NTP sets the date
+  return (uint32_t)(RHClock::millis() - RHStartMillis);
 }
 
 void delay (unsigned long ms)
 {
   //Implement Delay function
   struct timespec ts;
-  ts.tv_sec=0;
-  ts.tv_nsec=(ms * 1000);
-  nanosleep(&ts,&ts);
+  ts.tv_sec = ms / 1000;
+  ts.tv_nsec = (ms % 1000) * 1000000;
+  //Sleep again for what is left if a signal interrupts
+  while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+    ;
+}
+
+void attachInterrupt(unsigned char interrupt, void (*isr)(void), int mode)
+{
+  RHGpio.attach(interrupt, isr, mode);
+}
+
+void detachInterrupt(unsigned char interrupt)
+{
+  RHGpio.detach(interrupt);
+}
+
+void yield()
+{
+  RHGpio.service(0);
+}
+
+int gpioInterruptFd()
+{
+  return RHGpio.fd();
+}
+
+int gpioServiceInterrupts(int timeout)
+{
+  return RHGpio.service(timeout);
 }
 
 long random(long min, long max)
@@ -127,7 +152,7 @@ void SerialSimulator::begin(int baud)
   //
   //Initialize a timestamp for millis calculation - we do this here as well in case SPI
   //isn't used for some reason
-  gettimeofday(&RHStartTime, NULL);
+  RHStartMillis = RHClock::millis();
 }
 
 size_t SerialSimulator::println(const char* s)
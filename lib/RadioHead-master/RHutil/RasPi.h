@@ -24,6 +24,18 @@ typedef unsigned char byte;
   #define OUTPUT BCM2835_GPIO_FSEL_OUTP
 #endif
 
+#ifndef INPUT
+  #define INPUT BCM2835_GPIO_FSEL_INPT
+#endif
+
+// Interrupts are edges on GPIO lines, delivered through the Linux GPIO character device
+// (see RHutil/RHLinuxGpio.h), and numbered by BCM GPIO number
+#include <RHutil/RHLinuxGpio.h>
+#define CHANGE  RH_LINUX_GPIO_CHANGE
+#define FALLING RH_LINUX_GPIO_FALLING
+#define RISING  RH_LINUX_GPIO_RISING
+#define digitalPinToInterrupt(p) (p)
+
 class SPIClass
 {
   public:
@@ -72,4 +84,19 @@ void delay (unsigned long delay);
 
 long random(long min, long max);
 
+// Interrupts are per thread: yield(), gpioInterruptFd() and gpioServiceInterrupts() only see the
+// interrupts attached by the calling thread
+void attachInterrupt(unsigned char interrupt, void (*isr)(void), int mode);
+
+void detachInterrupt(unsigned char interrupt);
+
+// Calls the handlers of the edges that happened, without waiting. Called by the driver spin loops through YIELD
+void yield();
+
+// Returns a file descriptor that is readable when an interrupt is waiting, for select() or epoll
+int gpioInterruptFd();
+
+// Waits up to timeout ms (-1 for ever) for interrupts and calls their handlers. Returns the number of calls
+int gpioServiceInterrupts(int timeout);
+
 #endif
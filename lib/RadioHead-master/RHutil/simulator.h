@@ -10,6 +10,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <math.h>
 
 // Equivalent types for common Arduino types like uint8_t are in stdint.h
 
@@ -24,6 +25,61 @@ extern unsigned long millis();
 extern long random(long to);
 extern long random(long from, long to);
 
+// Arduino pin and interrupt functions. Pins have no effect except to notify the simulated
+// devices (see SimulatorDevice), so that simulated SPI chips can see their chip select
+#define INPUT   0
+#define OUTPUT  1
+#define LOW     0
+#define HIGH    1
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+extern void pinMode(uint8_t pin, uint8_t mode);
+extern void digitalWrite(uint8_t pin, uint8_t value);
+extern uint8_t digitalRead(uint8_t pin); // The last value written
+extern void attachInterrupt(uint8_t interrupt, void (*isr)(void), int mode);
+extern void detachInterrupt(uint8_t interrupt);
+
+// Gives simulated devices the chance to raise interrupts. Called from delay() and, through YIELD,
+// from the driver spin loops
+extern void yield();
+
+// There is no separate program memory
+#define PROGMEM
+#define memcpy_P memcpy
+
+// Base class for simulated peripherals (eg RHSimSX1276).
+// Devices register themselves on construction. They are told about every digitalWrite(),
+// and polled from yield(), which is the only place they may call simulatorInterrupt(): never
+// in the middle of an SPI transaction
+class SimulatorDevice
+{
+public:
+    SimulatorDevice();
+    virtual ~SimulatorDevice();
+
+    // Called on every digitalWrite()
+    virtual void pinChanged(uint8_t /*pin*/, uint8_t /*value*/) {}
+
+    // Called from yield()
+    virtual void poll() {}
+
+    // Called for every octet on the hardware SPI bus (see simulatorSpiTransfer()).
+    // Devices that are selected answer in result and return true
+    virtual bool spiTransfer(uint8_t /*data*/, uint8_t* /*result*/) { return false; }
+
+    // Next device in the list of registered devices
+    SimulatorDevice* _simulatorNext;
+};
+
+// Calls the interrupt handler attached to an interrupt number, if any
+// Returns true if there was one
+extern bool simulatorInterrupt(uint8_t interrupt);
+
+// Transfers an octet over the hardware SPI bus (RHHardwareSPI) to the selected simulated device.
+// Returns 0 if no device is selected
+extern uint8_t simulatorSpiTransfer(uint8_t data);
+
 // Equavalent to HardwareSerial in Arduino
 // but outputs to stdout
 class SerialSimulator
@@ -51,7 +107,7 @@ public:
 	if (base == DEC)
 	    return printf("%d", n);
 	else if (base == HEX)
-	    return printf("%02x", n);
+	    return printf("%x", n);
 	else if (base == OCT)
 	    return printf("%o", n);
 	// TODO: BIN
@@ -76,6 +132,63 @@ public:
 	return printf("\n");
     }
 
+    size_t print(int n, int base = DEC)
+    {
+	return print((long)n, base);
+    }
+    size_t println(int n, int base = DEC)
+    {
+	print(n, base);
+	return printf("\n");
+    }
+    size_t println(unsigned int n, int base = DEC)
+    {
+	print(n, base);
+	return printf("\n");
+    }
+    size_t print(long n, int base = DEC)
+    {
+	if (base == DEC)
+	    return printf("%ld", n);
+	return print((unsigned long)n, base);
+    }
+    size_t println(long n, int base = DEC)
+    {
+	print(n, base);
+	return printf("\n");
+    }
+    size_t print(unsigned long n, int base = DEC)
+    {
+	if (base == DEC)
+	    return printf("%lu", n);
+	else if (base == HEX)
+	    return printf("%lx", n);
+	else if (base == OCT)
+	    return printf("%lo", n);
+	else
+	    return 0;
+    }
+    size_t println(unsigned long n, int base = DEC)
+    {
+	print(n, base);
+	return printf("\n");
+    }
+    size_t println()
+    {
+	return printf("\n");
+    }
+    size_t write(uint8_t ch)
+    {
+	return fwrite(&ch, 1, 1, stdout);
+    }
+    size_t write(const uint8_t* buf, size_t len)
+    {
+	return fwrite(buf, 1, len, stdout);
+    }
+    void flush()
+    {
+	fflush(stdout);
+    }
 };
 
 // Global instance of the Serial output
@@ -888,6 +888,7 @@
  #define RH_HAVE_HARDWARE_SPI
  #define RH_HAVE_SERIAL
  #define PROGMEM
+ #define memcpy_P memcpy
  #include <RHutil/RasPi.h>
  #include <string.h>
  //Define SS for CS0 or pin 24
@@ -940,6 +941,16 @@
  #define ATOMIC_BLOCK_END
 #endif
 
+////////////////////////////////////////////////////
+// Orders the memory accesses on either side of it, for data an interrupt handler hands to the
+// main line through an index, without disabling interrupts. AVR has a single core and no caches,
+// so keeping the compiler from moving accesses across it is enough
+#if defined(__AVR__)
+ #define RH_MEMORY_BARRIER __asm__ __volatile__ ("" ::: "memory")
+#else
+ #define RH_MEMORY_BARRIER __sync_synchronize()
+#endif
+
 ////////////////////////////////////////////////////
 // Try to be compatible with systems that support yield() and multitasking
 // instead of spin-loops
@@ -949,6 +960,12 @@
 #elif (RH_PLATFORM == RH_PLATFORM_ESP8266)
 // ESP8266 also hash it
  #define YIELD yield();
+#elif (RH_PLATFORM == RH_PLATFORM_UNIX)
+// The simulator delivers simulated interrupts from yield()
+ #define YIELD yield();
+#elif (RH_PLATFORM == RH_PLATFORM_RASPI)
+// So does RHutil/RasPi.cpp, with the edges from the GPIO character device
+ #define YIELD yield();
 #else
  #define YIELD
 #endif
@@ -0,0 +1,439 @@
+// simulator_microbenchmarks.pde
+// -*- mode: C++ -*-
+// Microbenchmarks of RadioHead hot paths on the host, with the RHBenchmark harness:
+// CRC updates, RH_ASK symbol encoding and decoding, RH_Serial receive framing,
+// RHRouter routing table operations at several table occupancies, RHMesh route discovery
+// processing and RH_TCP receive framing.
+// Results can be saved as JSON (Google Benchmark format) and compared between commits.
+// Tested on Linux
+// Build with
+// cd whatever/RadioHead
+// CXXFLAGS="-O2 -DRH_ROUTING_TABLE_SIZE=64" tools/simBuild examples/simulator/simulator_microbenchmarks/simulator_microbenchmarks.pde
+// Run with ./simulator_microbenchmarks [--benchmark_filter=regex] [--benchmark_out=results.json]
+// (see RHutil/RHBenchmark.h for all the options)
+
+#include <RHCRC.h>
+#include <RH_ASK.h>
+#include <RH_Serial.h>
+#include <RH_TCP.h>
+#include <RHTcpProtocol.h>
+#include <RHMesh.h>
+#include <RHutil/RHBenchmark.h>
+#include <RHutil/HardwareSerial.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// A driver that sends nowhere and receives what inject() gave it, for the routing layers
+class BenchDriver : public RHGenericDriver
+{
+public:
+    BenchDriver() : _rxLen(0), _sent(0) {}
+    bool available() { return _rxLen > 0; }
+    bool recv(uint8_t* buf, uint8_t* len)
+    {
+	if (!_rxLen)
+	    return false;
+	if (*len > _rxLen)
+	    *len = _rxLen;
+	memcpy(buf, _rxBuf, *len);
+	_rxLen = 0;
+	return true;
+    }
+    bool send(const uint8_t* /*data*/, uint8_t /*len*/) { _sent++; return true; }
+    uint8_t maxMessageLength() { return sizeof(_rxBuf); }
+    void inject(const uint8_t* data, uint8_t len, uint8_t to, uint8_t from, uint8_t id, uint8_t flags)
+    {
+	memcpy(_rxBuf, data, len);
+	_rxLen = len;
+	_rxHeaderTo = to;
+	_rxHeaderFrom = from;
+	_rxHeaderId = id;
+	_rxHeaderFlags = flags;
+    }
+    uint8_t  _rxBuf[RH_MAX_MESSAGE_LEN];
+    uint8_t  _rxLen;
+    uint32_t _sent;
+};
+
+// Exposes the protected parts benchmarked
+class BenchAsk : public RH_ASK
+{
+public:
+    using RH_ASK::symbol_6to4;
+    using RH_ASK::_txBuf;
+};
+
+class BenchSerial : public RH_Serial
+{
+public:
+    BenchSerial(HardwareSerial& serial) : RH_Serial(serial) {}
+    using RH_Serial::handleRx;
+};
+
+// Input data, the same for every run
+static uint8_t data[256];
+
+////////////////////////////////////////////////////////////////////
+// RHCRC
+
+static void BM_RHcrc_ccitt_update(RHBenchmarkState& state)
+{
+    while (state.keepRunning())
+    {
+	uint16_t crc = 0xffff;
+	for (int64_t i = 0; i < state.arg(); i++)
+	    crc = RHcrc_ccitt_update(crc, data[i]);
+	rhDoNotOptimize(crc);
+    }
+    state.setBytesProcessed(state.iterations() * state.arg());
+}
+RH_BENCHMARK(BM_RHcrc_ccitt_update)->arg(16)->arg(64)->arg(255);
+
+static void BM_RHcrc_xmodem_update(RHBenchmarkState& state)
+{
+    while (state.keepRunning())
+    {
+	uint16_t crc = 0;
+	for (int64_t i = 0; i < state.arg(); i++)
+	    crc = RHcrc_xmodem_update(crc, data[i]);
+	rhDoNotOptimize(crc);
+    }
+    state.setBytesProcessed(state.iterations() * state.arg());
+}
+RH_BENCHMARK(BM_RHcrc_xmodem_update)->arg(64);
+
+static void BM_RHcrc16_update(RHBenchmarkState& state)
+{
+    while (state.keepRunning())
+    {
+	uint16_t crc = 0;
+	for (int64_t i = 0; i < state.arg(); i++)
+	    crc = RHcrc16_update(crc, data[i]);
+	rhDoNotOptimize(crc);
+    }
+    state.setBytesProcessed(state.iterations() * state.arg());
+}
+RH_BENCHMARK(BM_RHcrc16_update)->arg(64);
+
+static void BM_RHcrc_ibutton_update(RHBenchmarkState& state)
+{
+    while (state.keepRunning())
+    {
+	uint8_t crc = 0;
+	for (int64_t i = 0; i < state.arg(); i++)
+	    crc = RHcrc_ibutton_update(crc, data[i]);
+	rhDoNotOptimize(crc);
+    }
+    state.setBytesProcessed(state.iterations() * state.arg());
+}
+RH_BENCHMARK(BM_RHcrc_ibutton_update)->arg(64);
+
+// The buffer update of the engine, as RH_ASK and RH_Serial use it
+static void BM_RHCrcCcitt_buffer(RHBenchmarkState& state)
+{
+    while (state.keepRunning())
+	rhDoNotOptimize(RHCrcCcitt::update(0xffff, data, state.arg()));
+    state.setBytesProcessed(state.iterations() * state.arg());
+}
+RH_BENCHMARK(BM_RHCrcCcitt_buffer)->arg(16)->arg(64)->arg(255);
+
+////////////////////////////////////////////////////////////////////
+// RH_ASK
+
+// Message length, headers and FCS encoded into 6 bit symbols. The transmitter is stopped
+// before each send so that it doesn't wait for the (absent) timer interrupt
+static void BM_RH_ASK_send(RHBenchmarkState& state)
+{
+    BenchAsk ask;
+    while (state.keepRunning())
+    {
+	ask.setModeIdle();
+	if (!ask.send(data, state.arg()))
+	    state.skipWithError("send failed");
+	rhClobberMemory();
+    }
+    state.setBytesProcessed(state.iterations() * state.arg());
+}
+RH_BENCHMARK(BM_RH_ASK_send)->arg(1)->arg(20)->arg(RH_ASK_MAX_MESSAGE_LEN);
+
+// Decoding of the 16 valid symbols, as the receive interrupt does for every 6 bits
+static void BM_RH_ASK_symbol_6to4(RHBenchmarkState& state)
+{
+    BenchAsk ask;
+    // Every nybble value once: 0x01, 0x23, ... 0xef, encoded after the length and the 4 headers
+    uint8_t nybbles[8];
+    for (uint8_t i = 0; i < 8; i++)
+	nybbles[i] = (2 * i) << 4 | (2 * i + 1);
+    ask.send(nybbles, sizeof(nybbles));
+    uint8_t symbols[16];
+    memcpy(symbols, ask._txBuf + RH_ASK_PREAMBLE_LEN + 2 + 2 * RH_ASK_HEADER_LEN, sizeof(symbols));
+    ask.setModeIdle();
+
+    while (state.keepRunning())
+    {
+	uint8_t sum = 0;
+	for (uint8_t i = 0; i < sizeof(symbols); i++)
+	    sum += ask.symbol_6to4(symbols[i]);
+	rhDoNotOptimize(sum);
+    }
+    state.setItemsProcessed(state.iterations() * sizeof(symbols));
+}
+RH_BENCHMARK(BM_RH_ASK_symbol_6to4);
+
+////////////////////////////////////////////////////////////////////
+// RH_Serial
+
+// Appends an octet to a frame, doubling DLE
+static uint8_t appendEscaped(uint8_t* frame, uint8_t len, uint8_t ch)
+{
+    if (ch == DLE)
+	frame[len++] = DLE;
+    frame[len++] = ch;
+    return len;
+}
+
+// The receive state machine over a whole frame: DLE STX, headers and payload (escaped), DLE ETX, FCS.
+// The payload has DLE octets in it, so escaping is covered
+static void BM_RH_Serial_handleRx(RHBenchmarkState& state)
+{
+    HardwareSerial port("/dev/null");
+    BenchSerial driver(port);
+    driver.init();
+
+    uint8_t frame[2 * RH_SERIAL_MAX_PAYLOAD_LEN + 8];
+    uint8_t len = 0;
+    uint8_t headers[RH_SERIAL_HEADER_LEN] = {RH_BROADCAST_ADDRESS, 1, 0, 0};
+    uint8_t payload[RH_SERIAL_MAX_MESSAGE_LEN];
+    for (uint8_t i = 0; i < sizeof(payload); i++)
+	payload[i] = i % 8 == 0 ? DLE : i;
+    uint16_t fcs = RHCrcCcitt::update(0xffff, headers, sizeof(headers));
+    fcs = RHCrcCcitt::update(fcs, payload, state.arg());
+    fcs = RHCrcCcitt::update(fcs, DLE);
+    fcs = RHCrcCcitt::update(fcs, ETX);
+    frame[len++] = DLE;
+    frame[len++] = STX;
+    for (uint8_t i = 0; i < sizeof(headers); i++)
+	len = appendEscaped(frame, len, headers[i]);
+    for (uint8_t i = 0; i < state.arg(); i++)
+	len = appendEscaped(frame, len, payload[i]);
+    frame[len++] = DLE;
+    frame[len++] = ETX;
+    frame[len++] = fcs >> 8;
+    frame[len++] = fcs & 0xff;
+
+    uint8_t buf[RH_SERIAL_MAX_MESSAGE_LEN];
+    while (state.keepRunning())
+    {
+	for (uint8_t i = 0; i < len; i++)
+	    driver.handleRx(frame[i]);
+	uint8_t bufLen = sizeof(buf);
+	if (!driver.recv(buf, &bufLen) || bufLen != state.arg())
+	    state.skipWithError("frame not received");
+    }
+    state.setBytesProcessed(state.iterations() * len);
+}
+RH_BENCHMARK(BM_RH_Serial_handleRx)->arg(1)->arg(20)->arg(RH_SERIAL_MAX_MESSAGE_LEN);
+
+////////////////////////////////////////////////////////////////////
+// RHRouter
+
+// Fills the routing table with routes to destinations 1 to n, oldest first
+template <class Router>
+static void fillRoutes(Router& router, int64_t n)
+{
+    router.clearRoutingTable();
+    for (int64_t i = 1; i <= n; i++)
+	router.addRouteTo(i, 200);
+}
+
+// Lookup of the newest of arg routes, the worst case hit
+static void BM_RHRouter_getRouteTo(RHBenchmarkState& state)
+{
+    BenchDriver driver;
+    RHRouter router(driver, 250);
+    fillRoutes(router, state.arg());
+    while (state.keepRunning())
+	rhDoNotOptimize(router.getRouteTo(state.arg()));
+}
+RH_BENCHMARK(BM_RHRouter_getRouteTo)->arg(1)->arg(RH_ROUTING_TABLE_SIZE / 2)->arg(RH_ROUTING_TABLE_SIZE);
+
+// The same in the routing table of a gateway (see RHGatewayTraits)
+static void BM_RHRouter_getRouteTo_gateway(RHBenchmarkState& state)
+{
+    BenchDriver driver;
+    RHRouterT<BenchDriver, RHGatewayTraits> router(driver, 0);
+    fillRoutes(router, state.arg());
+    while (state.keepRunning())
+	rhDoNotOptimize(router.getRouteTo(state.arg()));
+}
+RH_BENCHMARK(BM_RHRouter_getRouteTo_gateway)->arg(16)->arg(64)->arg(RHGatewayTraits::routingTableSize);
+
+// Lookup of a destination with no route, with arg routes in the table
+static void BM_RHRouter_getRouteTo_miss(RHBenchmarkState& state)
+{
+    BenchDriver driver;
+    RHRouter router(driver, 250);
+    fillRoutes(router, state.arg());
+    while (state.keepRunning())
+	rhDoNotOptimize(router.getRouteTo(249));
+}
+RH_BENCHMARK(BM_RHRouter_getRouteTo_miss)->arg(1)->arg(RH_ROUTING_TABLE_SIZE / 2)->arg(RH_ROUTING_TABLE_SIZE);
+
+// Update of the newest of arg routes, as route discovery does for known nodes
+static void BM_RHRouter_addRouteTo_update(RHBenchmarkState& state)
+{
+    BenchDriver driver;
+    RHRouter router(driver, 250);
+    fillRoutes(router, state.arg());
+    while (state.keepRunning())
+    {
+	router.addRouteTo(state.arg(), 201);
+	rhClobberMemory();
+    }
+}
+RH_BENCHMARK(BM_RHRouter_addRouteTo_update)->arg(1)->arg(RH_ROUTING_TABLE_SIZE / 2)->arg(RH_ROUTING_TABLE_SIZE);
+
+// Insertion of new destinations into a full table, which retires the oldest route every time
+static void BM_RHRouter_addRouteTo_full(RHBenchmarkState& state)
+{
+    BenchDriver driver;
+    RHRouter router(driver, 250);
+    fillRoutes(router, RH_ROUTING_TABLE_SIZE);
+    uint8_t dest = RH_ROUTING_TABLE_SIZE;
+    while (state.keepRunning())
+    {
+	dest = dest % 240 + 1;
+	router.addRouteTo(dest, 200);
+	rhClobberMemory();
+    }
+}
+RH_BENCHMARK(BM_RHRouter_addRouteTo_full);
+
+////////////////////////////////////////////////////////////////////
+// RHMesh
+
+// A broadcast route discovery request for another node, that has come through arg nodes:
+// recorded routes back to the originator and the nodes on the way, then rebroadcast
+template <class Driver>
+static void routeDiscovery(RHBenchmarkState& state)
+{
+    Driver driver;
+    RHMeshT<Driver> mesh(driver, 1);
+    mesh.init();
+
+    uint8_t message[5 + 3 + RH_DEFAULT_MAX_HOPS];
+    uint8_t len = 0;
+    message[len++] = RH_BROADCAST_ADDRESS;                       // RHRouter header: dest
+    message[len++] = 100;                                        // source
+    message[len++] = 0;                                          // hops
+    message[len++] = 0;                                          // id
+    message[len++] = 0;                                          // flags
+    message[len++] = RH_MESH_MESSAGE_TYPE_ROUTE_DISCOVERY_REQUEST;
+    message[len++] = 1;                                          // destlen
+    message[len++] = 99;                                         // dest, not us
+    for (int64_t i = 0; i < state.arg(); i++)
+	message[len++] = 101 + i;                                // route so far
+
+    uint8_t id = 0;
+    uint8_t buf[RH_MESH_MAX_MESSAGE_LEN];
+    uint32_t sent = driver._sent;
+    while (state.keepRunning())
+    {
+	// A new request each time, or it would be discarded as a duplicate
+	driver.inject(message, len, RH_BROADCAST_ADDRESS, state.arg() ? 100 + state.arg() : 100, ++id, 0);
+	uint8_t bufLen = sizeof(buf);
+	mesh.recvfromAck(buf, &bufLen);
+    }
+    if (driver._sent - sent != state.iterations())
+	state.skipWithError("request not rebroadcast");
+    state.setItemsProcessed(state.iterations());
+}
+
+static void BM_RHMesh_routeDiscovery(RHBenchmarkState& state)
+{
+    routeDiscovery<BenchDriver>(state);
+}
+RH_BENCHMARK(BM_RHMesh_routeDiscovery)->arg(0)->arg(4)->arg(16);
+
+// The same with the driver called directly (see RHStaticDriver)
+static void BM_RHMesh_routeDiscovery_static(RHBenchmarkState& state)
+{
+    routeDiscovery<RHStaticDriver<BenchDriver> >(state);
+}
+RH_BENCHMARK(BM_RHMesh_routeDiscovery_static)->arg(0)->arg(4)->arg(16);
+
+////////////////////////////////////////////////////////////////////
+// RH_TCP
+
+// A packet message from the server parsed out of the socket stream. Includes writing it into
+// a loopback TCP connection and reading it back
+static void BM_RH_TCP_recv(RHBenchmarkState& state)
+{
+    // The "server" end of the connection is ours
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addrLen = sizeof(addr);
+    if (   listener < 0
+	|| bind(listener, (struct sockaddr*)&addr, sizeof(addr)) < 0
+	|| listen(listener, 1) < 0
+	|| getsockname(listener, (struct sockaddr*)&addr, &addrLen) < 0)
+    {
+	state.skipWithError("can't listen on loopback");
+	return;
+    }
+    char server[32];
+    snprintf(server, sizeof(server), "127.0.0.1:%u", ntohs(addr.sin_port));
+    RH_TCP driver(server);
+    if (!driver.init())
+    {
+	state.skipWithError("can't connect");
+	return;
+    }
+    int peer = accept(listener, NULL, NULL);
+    RHTcpThisAddress thisAddress;
+    if (peer < 0 || read(peer, &thisAddress, sizeof(thisAddress)) != sizeof(thisAddress))
+    {
+	state.skipWithError("can't accept");
+	return;
+    }
+
+    RHTcpPacket packet;
+    packet.length = htonl(state.arg() + 5);
+    packet.type = RH_TCP_MESSAGE_TYPE_PACKET;
+    packet.to = RH_BROADCAST_ADDRESS;
+    packet.from = 2;
+    packet.id = 0;
+    packet.flags = 0;
+    memcpy(packet.payload, data, state.arg());
+    size_t packetLen = sizeof(packet.length) + 5 + state.arg();
+
+    uint8_t buf[RH_TCP_MAX_MESSAGE_LEN];
+    while (state.keepRunning())
+    {
+	if (write(peer, &packet, packetLen) != (ssize_t)packetLen)
+	    state.skipWithError("write failed");
+	uint8_t bufLen = sizeof(buf);
+	while (!driver.recv(buf, &bufLen))
+	    ;
+    }
+    state.setBytesProcessed(state.iterations() * packetLen);
+    close(peer);
+    close(listener);
+}
+RH_BENCHMARK(BM_RH_TCP_recv)->arg(1)->arg(20)->arg(RH_TCP_MAX_MESSAGE_LEN);
+
+void setup()
+{
+    for (uint16_t i = 0; i < sizeof(data); i++)
+	data[i] = i * 7 + 3;
+    exit(RHBenchmark::runAll(_simulator_argc, _simulator_argv));
+}
+
+void loop()
+{
+}
@@ -0,0 +1,118 @@
+// simulator_rf95_channel_plan.pde
+// -*- mode: C++ -*-
+// Sends packets from one RH_RF95 node hopping over the channels of an RHChannelPlan, deferring by
+// offTime() when every sub-band is in its duty cycle off time, to one receiving RH_RF95 per channel
+// as a multi-radio gateway would have. All run against simulated SX1276 chips (RHSimSX1276) sharing
+// an in-process ether, which only delivers between chips tuned to the same frequency.
+// Prints the packets heard on each channel and the duty cycle used in each sub-band. Exits with
+// status 1 if a packet is lost or a sub-band exceeds its duty cycle.
+// Tested on Linux
+// Build with
+// cd whatever/RadioHead
+// tools/simBuild examples/simulator/simulator_rf95_channel_plan/simulator_rf95_channel_plan.pde
+// Run with ./simulator_rf95_channel_plan [packets]
+
+#include <RH_RF95.h>
+#include <RHChannelPlan.h>
+#include <RHutil/RHSimSX1276.h>
+
+#define NUM_CHANNELS 4
+#define DUTY_CYCLE_DIVISOR 10 // 10%, to keep the run short
+#define NODE_ADDRESS 1
+
+// Three channels in one sub-band, one in another
+PROGMEM static const RHChannelPlan::Channel channels[NUM_CHANNELS] =
+{
+    { RH_RF95::frequencyToFrf(868100000), 0 },
+    { RH_RF95::frequencyToFrf(868300000), 0 },
+    { RH_RF95::frequencyToFrf(868500000), 0 },
+    { RH_RF95::frequencyToFrf(869525000), 1 },
+};
+static const float frequencies[NUM_CHANNELS] = { 868.1, 868.3, 868.5, 869.525 };
+
+RHChannelPlan plan(channels, NUM_CHANNELS, DUTY_CYCLE_DIVISOR, 1000);
+
+RHSimEther ether;
+RHSimSX1276 nodeChip(ether, 10, 2);
+RHSimSX1276 gatewayChip0(ether, 9, 3);
+RHSimSX1276 gatewayChip1(ether, 8, 4);
+RHSimSX1276 gatewayChip2(ether, 7, 5);
+RHSimSX1276 gatewayChip3(ether, 6, 6);
+RH_RF95 node(10, 2, nodeChip);
+RH_RF95 gateway0(9, 3, gatewayChip0);
+RH_RF95 gateway1(8, 4, gatewayChip1);
+RH_RF95 gateway2(7, 5, gatewayChip2);
+RH_RF95 gateway3(6, 6, gatewayChip3);
+RH_RF95* gateways[NUM_CHANNELS] = { &gateway0, &gateway1, &gateway2, &gateway3 };
+
+void setup()
+{
+    if (!node.init())
+    {
+	Serial.println("init failed");
+	exit(1);
+    }
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++)
+    {
+	if (!gateways[i]->init())
+	{
+	    Serial.println("init failed");
+	    exit(1);
+	}
+	gateways[i]->setFrequency(frequencies[i]);
+	gateways[i]->setModeRx();
+    }
+}
+
+void loop()
+{
+    uint32_t packets = _simulator_argc >= 2 ? atoi(_simulator_argv[1]) : 20;
+    uint8_t data[20];
+    uint8_t buf[RH_RF95_MAX_MESSAGE_LEN];
+    // RH_RF95 defaults: SF7, 125 kHz, 4/5
+    uint32_t airtime = RH_RF95::timeOnAirUs(sizeof(data) + RH_RF95_HEADER_LEN, 7, RH_RF95::Bw125kHz, 5) / 1000 + 1;
+    uint32_t heard[NUM_CHANNELS] = { 0 };
+    uint32_t lost = 0;
+    uint32_t deferred = 0;
+
+    uint32_t start = millis();
+    for (uint32_t i = 0; i < packets; i++)
+    {
+	uint8_t channel;
+	while ((channel = plan.selectChannel(NODE_ADDRESS, millis())) == RH_CHANNEL_NONE)
+	{
+	    deferred++;
+	    delay(plan.offTime(millis()));
+	}
+	for (uint8_t j = 0; j < sizeof(data); j++)
+	    data[j] = i + j;
+	plan.tune(node, channel);
+	uint32_t sent = millis();
+	node.send(data, sizeof(data));
+	node.waitPacketSent();
+	plan.recordTransmit(channel, airtime, sent);
+
+	uint8_t len = sizeof(buf);
+	if (gateways[channel]->waitAvailableTimeout(100) && gateways[channel]->recv(buf, &len)
+	    && len == sizeof(data) && !memcmp(buf, data, len))
+	    heard[channel]++;
+	else
+	    lost++;
+    }
+    uint32_t elapsed = millis() - start;
+
+    printf("%u packets of %u ms in %u ms, %u lost, deferred %u times\n", packets, airtime, elapsed, lost, deferred);
+    for (uint8_t i = 0; i < NUM_CHANNELS; i++)
+	printf("channel %u (%.3f MHz): %u packets\n", i, frequencies[i], heard[i]);
+    bool exceeded = false;
+    for (uint8_t band = 0; band < 2; band++)
+    {
+	// Each sub-band may have just started one more transmission than its duty cycle allows
+	uint32_t allowed = elapsed / DUTY_CYCLE_DIVISOR + airtime;
+	printf("sub-band %u: %u ms on air, %.1f%% duty cycle\n", band, plan.bandAirtime(band),
+	       elapsed ? 100.0 * plan.bandAirtime(band) / elapsed : 0.0);
+	if (plan.bandAirtime(band) > allowed)
+	    exceeded = true;
+    }
+    exit(lost || exceeded ? 1 : 0);
+}
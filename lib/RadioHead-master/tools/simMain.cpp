@@ -8,7 +8,7 @@
 
 #include <stdio.h>
 #include <RHutil/simulator.h>
-#include <sys/time.h>
+#include <RHClock.h>
 #include <unistd.h>
 #include <time.h>
 
@@ -19,27 +19,18 @@ extern void setup();
 extern void loop();
 
 // Millis at the start of the process
-unsigned long start_millis;
+uint32_t start_millis;
 
 int    _simulator_argc;
 char** _simulator_argv;
 
-// Returns milliseconds since beginning of day
-unsigned long time_in_millis()
-{    
-    struct timeval te; 
-    gettimeofday(&te, NULL); // get current time
-    unsigned long milliseconds = te.tv_sec*1000LL + te.tv_usec/1000; // caclulate milliseconds
-    return milliseconds;
-}
-
 // Run the Arduino standard functions in the main loop
 int main(int argc, char** argv)
 {
     // Let simulated program have access to argc and argv
     _simulator_argc = argc;
     _simulator_argv = argv;
-    start_millis = time_in_millis();
+    start_millis = RHClock::millis();
     // Seed the random number generator
     srand(getpid() ^ (unsigned) time(NULL)/2);
     setup();
@@ -47,15 +38,23 @@ int main(int argc, char** argv)
 	loop();
 }
 
+// Delays in steps of at most 1ms so that simulated devices can interrupt
 void delay(unsigned long ms)
 {
-    usleep(ms * 1000);
+    unsigned long start = millis();
+    yield();
+    while (millis() - start < ms)
+    {
+	usleep(1000);
+	yield();
+    }
 }
 
 // Arduino equivalent, milliseconds since process start
+// Monotonic, so timeouts don't jump when NTP sets the date
 unsigned long millis()
 {
-    return time_in_millis() - start_millis;
+    return (uint32_t)(RHClock::millis() - start_millis);
 }
 
 long random(long from, long to)
@@ -68,4 +67,81 @@ long random(long to)
     return random(0, to);
 }
 
+// The simulated devices, in order of registration
+static SimulatorDevice* devices = NULL;
+
+// Interrupt handlers indexed by interrupt (== pin) number
+#define SIMULATOR_NUM_INTERRUPTS 256
+static void (*isrs[SIMULATOR_NUM_INTERRUPTS])(void);
+
+// Last value written to each pin
+static uint8_t pinValues[256];
+
+SimulatorDevice::SimulatorDevice()
+    : _simulatorNext(NULL)
+{
+    SimulatorDevice** p = &devices;
+    while (*p)
+	p = &(*p)->_simulatorNext;
+    *p = this;
+}
+
+SimulatorDevice::~SimulatorDevice()
+{
+    SimulatorDevice** p = &devices;
+    while (*p && *p != this)
+	p = &(*p)->_simulatorNext;
+    if (*p)
+	*p = _simulatorNext;
+}
+
+void pinMode(uint8_t /*pin*/, uint8_t /*mode*/)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    pinValues[pin] = value;
+    for (SimulatorDevice* d = devices; d; d = d->_simulatorNext)
+	d->pinChanged(pin, value);
+}
+
+uint8_t digitalRead(uint8_t pin)
+{
+    return pinValues[pin];
+}
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(void), int /*mode*/)
+{
+    isrs[interrupt] = isr;
+}
+
+void detachInterrupt(uint8_t interrupt)
+{
+    isrs[interrupt] = NULL;
+}
+
+bool simulatorInterrupt(uint8_t interrupt)
+{
+    if (!isrs[interrupt])
+	return false;
+    isrs[interrupt]();
+    return true;
+}
+
+uint8_t simulatorSpiTransfer(uint8_t data)
+{
+    uint8_t result;
+    for (SimulatorDevice* d = devices; d; d = d->_simulatorNext)
+	if (d->spiTransfer(data, &result))
+	    return result;
+    return 0;
+}
+
+void yield()
+{
+    for (SimulatorDevice* d = devices; d; d = d->_simulatorNext)
+	d->poll();
+}
+
 #endif
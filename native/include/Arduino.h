@@ -0,0 +1,33 @@
+/*
+  Arduino core for the native build: runs the firmware on Linux (see native/README)
+
+  Timing, pins, Serial and interrupts attached to pins come from the RadioHead simulator
+  (lib/RadioHead-master/RHutil/simulator.h). The AVR registers the firmware uses directly
+  are modelled in avr/io.h.
+
+  Copyright: desplega.com
+*/
+
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+#include <RadioHead.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+// Analog pins of the ATmega328
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+#define A6 20
+#define A7 21
+
+#define bit(b) (1UL << (b))
+#define noInterrupts() cli()
+#define interrupts() sei()
+
+#endif
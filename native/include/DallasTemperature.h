@@ -0,0 +1,46 @@
+/*
+  DallasTemperature library for the native build: NATIVE_SENSORS simulated DS18B20s (2 by default).
+  Sensor i reads 21 + i / 2 C plus a daily swing of 5 C, rounded to its resolution
+
+  Copyright: desplega.com
+*/
+
+#ifndef NATIVE_DALLASTEMPERATURE_H
+#define NATIVE_DALLASTEMPERATURE_H
+
+#include <Arduino.h>
+#include <OneWire.h>
+
+#define DEVICE_DISCONNECTED_RAW -7040
+
+typedef uint8_t DeviceAddress[8];
+
+class DallasTemperature
+{
+public:
+  DallasTemperature(OneWire *oneWire) : oneWire(oneWire) {}
+
+  void begin();
+  uint8_t getDeviceCount();
+  bool isParasitePowerMode() { return false; }
+  bool getAddress(uint8_t *deviceAddress, uint8_t index);
+  bool setResolution(const uint8_t *deviceAddress, uint8_t newResolution);
+  uint8_t getResolution(const uint8_t *deviceAddress);
+  void setWaitForConversion(bool wait) { waitForConversion = wait; }
+
+  // Samples the simulated temperatures
+  void requestTemperatures();
+  int16_t millisToWaitForConversion(uint8_t bitResolution);
+
+  // Temperature in 1/128 C, DEVICE_DISCONNECTED_RAW for an unknown address
+  int16_t getTemp(const uint8_t *deviceAddress);
+
+private:
+  OneWire *oneWire;
+  uint8_t devices = 0;
+  bool waitForConversion = true;
+  uint8_t resolution[8];
+  int16_t raw[8];
+};
+
+#endif
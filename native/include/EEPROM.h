@@ -0,0 +1,51 @@
+/*
+  EEPROM library for the native build, over the EEPROM the registers in avr/io.h also reach.
+  Erased cells read 0xff, and the contents are kept between runs in the file named by NATIVE_EEPROM
+
+  Copyright: desplega.com
+*/
+
+#ifndef NATIVE_EEPROM_H
+#define NATIVE_EEPROM_H
+
+#include <Arduino.h>
+#include "native.h"
+
+class EEPROMClass
+{
+public:
+  uint8_t read(int idx) { return nativeEeprom[idx & E2END]; }
+  void write(int idx, uint8_t val)
+  {
+    nativeEeprom[idx & E2END] = val;
+    nativeStats.eepromWrites++;
+  }
+  void update(int idx, uint8_t val)
+  {
+    if (read(idx) != val)
+      write(idx, val);
+  }
+  uint16_t length() { return E2END + 1; }
+
+  template <typename T>
+  T &get(int idx, T &t)
+  {
+    uint8_t *ptr = (uint8_t *)&t;
+    for (int count = sizeof(T); count; --count, ++idx)
+      *ptr++ = read(idx);
+    return t;
+  }
+
+  template <typename T>
+  const T &put(int idx, const T &t)
+  {
+    const uint8_t *ptr = (const uint8_t *)&t;
+    for (int count = sizeof(T); count; --count, ++idx)
+      update(idx, *ptr++);
+    return t;
+  }
+};
+
+static EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,21 @@
+/*
+  OneWire library for the native build. The bus is not simulated, DallasTemperature.h simulates
+  the sensors on it
+
+  Copyright: desplega.com
+*/
+
+#ifndef NATIVE_ONEWIRE_H
+#define NATIVE_ONEWIRE_H
+
+#include <Arduino.h>
+
+class OneWire
+{
+public:
+  OneWire(uint8_t pin) : pin(pin) {}
+
+  uint8_t pin;
+};
+
+#endif
@@ -0,0 +1,13 @@
+/*
+  SPI for the native build. RadioHead reaches the simulated radio through RHHardwareSPI,
+  which the simulator routes to it (see simulatorSpiTransfer()), so there is nothing here
+
+  Copyright: desplega.com
+*/
+
+#ifndef NATIVE_SPI_H
+#define NATIVE_SPI_H
+
+#include <Arduino.h>
+
+#endif
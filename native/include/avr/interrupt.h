@@ -0,0 +1,25 @@
+/*
+  Interrupts for the native build
+
+  An ISR is a plain function the hardware model (native/src/avr.cpp) calls when its interrupt is
+  pending and enabled: from sei() and from sleep_cpu(), as on the MCU after the instruction that
+  follows sei. Vectors are named as in avr-libc.
+
+  Copyright: desplega.com
+*/
+
+#ifndef NATIVE_AVR_INTERRUPT_H
+#define NATIVE_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+#define ISR(vector, ...) extern "C" void vector(void)
+#define EMPTY_INTERRUPT(vector) ISR(vector) {}
+
+// Clears the I bit
+void cli();
+
+// Sets the I bit and runs the pending interrupts
+void sei();
+
+#endif
@@ -0,0 +1,107 @@
+/*
+  ATmega328 registers used by the firmware, for the native build
+
+  Each register is a NativeRegister: reads and writes behave as plain variables, and writes
+  tell the hardware model (native/src/avr.cpp) so that setting EERE reads the EEPROM,
+  EEPE writes it, ADSC converts, and so on. Bit numbers are those of the datasheet.
+
+  Copyright: desplega.com
+*/
+
+#ifndef NATIVE_AVR_IO_H
+#define NATIVE_AVR_IO_H
+
+#include <stdint.h>
+
+template <typename T>
+class NativeRegister
+{
+public:
+  NativeRegister(T value = 0, void (*written)() = 0) : value(value), written(written) {}
+  operator T() const { return value; }
+  NativeRegister &operator=(T v)
+  {
+    value = v;
+    if (written)
+      written();
+    return *this;
+  }
+  template <typename V>
+  NativeRegister &operator|=(V v) { return *this = (T)(value | v); }
+  template <typename V>
+  NativeRegister &operator&=(V v) { return *this = (T)(value & v); }
+  template <typename V>
+  NativeRegister &operator^=(V v) { return *this = (T)(value ^ v); }
+
+  T value; // For the hardware model, which changes registers without being told
+private:
+  void (*written)();
+};
+
+typedef NativeRegister<uint8_t> NativeRegister8;
+typedef NativeRegister<uint16_t> NativeRegister16;
+
+// Status register, only its I bit (see cli() and sei()). Set at reset, as the Arduino core does before setup()
+extern NativeRegister8 SREG;
+#define SREG_I 7
+
+// MCU control, BOD disable in sleep
+extern NativeRegister8 MCUCR;
+#define BODS 6
+#define BODSE 5
+
+// MCU status, the reset flags
+extern NativeRegister8 MCUSR;
+#define WDRF 3
+
+// Sleep mode control
+extern NativeRegister8 SMCR;
+#define SM2 3
+#define SM1 2
+#define SM0 1
+#define SE 0
+
+// Watchdog
+extern NativeRegister8 WDTCSR;
+#define WDIF 7
+#define WDIE 6
+#define WDP3 5
+#define WDCE 4
+#define WDE 3
+#define WDP2 2
+#define WDP1 1
+#define WDP0 0
+
+// ADC
+extern NativeRegister8 ADCSRA;
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIF 4
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+extern NativeRegister8 ADMUX;
+#define REFS1 7
+#define REFS0 6
+#define ADLAR 5
+#define MUX3 3
+#define MUX2 2
+#define MUX1 1
+#define MUX0 0
+extern NativeRegister16 ADC;
+
+// EEPROM
+extern NativeRegister8 EECR;
+#define EERIE 3
+#define EEMPE 2
+#define EEPE 1
+#define EERE 0
+extern NativeRegister8 EEDR;
+extern NativeRegister16 EEAR;
+#define E2END 0x3ff
+
+#define _BV(b) (1 << (b))
+
+#endif
@@ -0,0 +1,22 @@
+/*
+  Program memory for the native build: there is only one address space
+
+  Copyright: desplega.com
+*/
+
+#ifndef NATIVE_AVR_PGMSPACE_H
+#define NATIVE_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef PROGMEM
+#define PROGMEM
+#define memcpy_P memcpy
+#endif
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+#define strlen_P strlen
+
+#endif
@@ -0,0 +1,34 @@
+/*
+  Sleep modes for the native build
+
+  sleep_cpu() runs the interrupt that would wake the MCU up: the ADC conversion in ADC noise
+  reduction mode, the watchdog in power down, at once. Idle gives the simulated radio a
+  chance to interrupt, in real time. Time in power down is counted by the
+  watchdog (see nativeMillis()) instead of being waited for, so simulated days run in seconds.
+
+  Copyright: desplega.com
+*/
+
+#ifndef NATIVE_AVR_SLEEP_H
+#define NATIVE_AVR_SLEEP_H
+
+#include <avr/io.h>
+
+#define SLEEP_MODE_IDLE 0
+#define SLEEP_MODE_ADC _BV(SM0)
+#define SLEEP_MODE_PWR_DOWN _BV(SM1)
+
+#define set_sleep_mode(mode) (SMCR = (SMCR & ~(_BV(SM2) | _BV(SM1) | _BV(SM0))) | (mode))
+#define sleep_enable() (SMCR |= _BV(SE))
+#define sleep_disable() (SMCR &= ~_BV(SE))
+#define sleep_mode()  \
+  do                  \
+  {                   \
+    sleep_enable();   \
+    sleep_cpu();      \
+    sleep_disable();  \
+  } while (0)
+
+void sleep_cpu();
+
+#endif
@@ -0,0 +1,15 @@
+/*
+  Watchdog for the native build. It never resets the process, so there is nothing to reset
+
+  Copyright: desplega.com
+*/
+
+#ifndef NATIVE_AVR_WDT_H
+#define NATIVE_AVR_WDT_H
+
+#include <avr/io.h>
+
+#define wdt_reset() do {} while (0)
+#define wdt_disable() (WDTCSR = 0)
+
+#endif
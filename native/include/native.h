@@ -0,0 +1,44 @@
+/*
+  Simulated board of the native build: settings, clock and counters
+
+  The settings are read from environment variables, see native/README.
+
+  Copyright: desplega.com
+*/
+
+#ifndef NATIVE_H
+#define NATIVE_H
+
+#include <stdint.h>
+
+// What happened in the run, printed by nativeExit()
+typedef struct
+{
+  unsigned long sleptMs;   // Time in power down
+  uint32_t wakeups;        // Power down sleeps ended by the watchdog
+  uint32_t adcConversions; // ADC conversions
+  uint32_t eepromWrites;   // EEPROM bytes written (erase and write cycles)
+  uint32_t uplinks;        // Packets the node sent
+  uint32_t uplinkBytes;    // Their payload bytes, RadioHead headers included
+  uint64_t airtimeUs;      // Their time on air
+  uint32_t downlinks;      // Packets the gateway sent (ACKs)
+} NativeStats;
+
+extern NativeStats nativeStats;
+
+// Returns the integer setting in the environment variable name, or def if it is not set
+long nativeSetting(const char *name, long def);
+
+// Simulated time since start in ms: host time outside power down (real) plus time in power down (counted)
+unsigned long nativeMillis();
+
+// Prints the summary to stderr, saves the EEPROM if NATIVE_EEPROM is set, and ends the process
+void nativeExit(int status);
+
+// Called by the hardware model after every power down sleep: ends the run after NATIVE_SECONDS
+void nativeCheckRunTime();
+
+// EEPROM contents, for EEPROM.h and the EEPROM registers
+extern uint8_t nativeEeprom[];
+
+#endif
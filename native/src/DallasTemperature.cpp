@@ -0,0 +1,89 @@
+/*
+  Simulated DS18B20 sensors for the native build
+
+  Copyright: desplega.com
+*/
+
+#include <DallasTemperature.h>
+#include "native.h"
+
+#define DAY_MS 86400000.0
+
+void DallasTemperature::begin()
+{
+  long count = nativeSetting("NATIVE_SENSORS", 2);
+  devices = count < 0 ? 0 : count > 8 ? 8 : count;
+  for (uint8_t i = 0; i < devices; i++)
+    resolution[i] = 12;
+}
+
+uint8_t DallasTemperature::getDeviceCount()
+{
+  return devices;
+}
+
+bool DallasTemperature::getAddress(uint8_t *deviceAddress, uint8_t index)
+{
+  if (index >= devices)
+    return false;
+  // DS18B20 family code, the index as serial number
+  static const uint8_t address[8] = {0x28, 0, 0, 0, 0, 0, 0, 0};
+  memcpy(deviceAddress, address, sizeof(address));
+  deviceAddress[1] = index;
+  return true;
+}
+
+// Index of the simulated sensor at an address, -1 if there is none
+static int sensorIndex(const uint8_t *deviceAddress, uint8_t devices)
+{
+  return deviceAddress[0] == 0x28 && deviceAddress[1] < devices ? deviceAddress[1] : -1;
+}
+
+bool DallasTemperature::setResolution(const uint8_t *deviceAddress, uint8_t newResolution)
+{
+  int i = sensorIndex(deviceAddress, devices);
+  if (i < 0)
+    return false;
+  resolution[i] = newResolution < 9 ? 9 : newResolution > 12 ? 12 : newResolution;
+  return true;
+}
+
+uint8_t DallasTemperature::getResolution(const uint8_t *deviceAddress)
+{
+  int i = sensorIndex(deviceAddress, devices);
+  return i < 0 ? 0 : resolution[i];
+}
+
+void DallasTemperature::requestTemperatures()
+{
+  double swing = 5 * sin(2 * M_PI * nativeMillis() / DAY_MS);
+  for (uint8_t i = 0; i < devices; i++)
+  {
+    // 1/128 C, the bits below the resolution are 0
+    int16_t mask = ~((1 << (12 - resolution[i])) * 8 - 1);
+    raw[i] = (int16_t)lround((21 + i / 2.0 + swing) * 128) & mask;
+  }
+  if (waitForConversion)
+    delay(millisToWaitForConversion(12));
+}
+
+int16_t DallasTemperature::millisToWaitForConversion(uint8_t bitResolution)
+{
+  switch (bitResolution)
+  {
+  case 9:
+    return 94;
+  case 10:
+    return 188;
+  case 11:
+    return 375;
+  default:
+    return 750;
+  }
+}
+
+int16_t DallasTemperature::getTemp(const uint8_t *deviceAddress)
+{
+  int i = sensorIndex(deviceAddress, devices);
+  return i < 0 ? DEVICE_DISCONNECTED_RAW : raw[i];
+}
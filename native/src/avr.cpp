@@ -0,0 +1,173 @@
+/*
+  Hardware model of the ATmega328 registers in native/include/avr/io.h: sleep, watchdog, ADC and EEPROM
+
+  Copyright: desplega.com
+*/
+
+#include <Arduino.h>
+#include <avr/sleep.h>
+#include "native.h"
+
+// The firmware's interrupt handlers, if it has them
+extern "C" void WDT_vect(void) __attribute__((weak));
+extern "C" void ADC_vect(void) __attribute__((weak));
+extern "C" void EE_READY_vect(void) __attribute__((weak));
+
+static void adcWritten();
+static void eecrWritten();
+
+NativeRegister8 SREG(bit(SREG_I));
+NativeRegister8 MCUCR;
+NativeRegister8 MCUSR;
+NativeRegister8 SMCR;
+NativeRegister8 WDTCSR;
+NativeRegister8 ADCSRA(0, adcWritten);
+NativeRegister8 ADMUX;
+NativeRegister16 ADC;
+NativeRegister8 EECR(0, eecrWritten);
+NativeRegister8 EEDR;
+NativeRegister16 EEAR;
+
+uint8_t nativeEeprom[E2END + 1];
+
+// ADC channels other than the analog inputs
+#define ADC_CHANNEL_BANDGAP 14
+#define ADC_CHANNEL_GND 15
+#define BANDGAP_MV 1100
+
+// Runs an interrupt handler with the I bit cleared, as the MCU does
+static void runHandler(void (*handler)(void))
+{
+  SREG.value &= ~bit(SREG_I);
+  handler();
+  SREG.value |= bit(SREG_I);
+}
+
+// Runs the interrupts that are pending and enabled, while the I bit is set
+static void serviceInterrupts()
+{
+  bool serviced;
+  do
+  {
+    serviced = false;
+    if (!(SREG & bit(SREG_I)))
+      return;
+    if ((ADCSRA & bit(ADIF)) && (ADCSRA & bit(ADIE)))
+    {
+      ADCSRA.value &= ~bit(ADIF);
+      if (ADC_vect)
+        runHandler(ADC_vect);
+      serviced = true;
+    }
+    // EEPROM ready is a level: it fires for as long as it is enabled and no write is in progress
+    if ((EECR & bit(EERIE)) && !(EECR & bit(EEPE)))
+    {
+      if (EE_READY_vect)
+        runHandler(EE_READY_vect);
+      else
+        EECR.value &= ~bit(EERIE);
+      serviced = true;
+    }
+  } while (serviced);
+}
+
+void cli()
+{
+  SREG.value &= ~bit(SREG_I);
+}
+
+void sei()
+{
+  SREG.value |= bit(SREG_I);
+  serviceInterrupts();
+}
+
+// A conversion completes as soon as it starts. The bandgap starts up when selected (or the ADC is
+// powered up), rising to BANDGAP_MV over the first conversions
+static void adcWritten()
+{
+  static uint8_t lastChannel = 0xff;
+  static uint8_t settling = 0; // Conversions since the channel was selected
+
+  if (!(ADCSRA & bit(ADEN)))
+    lastChannel = 0xff;
+  if (!(ADCSRA & bit(ADEN)) || !(ADCSRA & bit(ADSC)))
+    return;
+
+  uint8_t channel = ADMUX & 0x0f;
+  if (channel != lastChannel)
+    settling = 0;
+  lastChannel = channel;
+  long vcc = nativeSetting("NATIVE_VCC_MV", 3300);
+  long mv;
+  if (channel == ADC_CHANNEL_BANDGAP)
+  {
+    mv = BANDGAP_MV - (settling < 8 ? BANDGAP_MV >> (2 * settling + 2) : 0);
+    settling++;
+  }
+  else if (channel == 0)
+    mv = nativeSetting("NATIVE_HARP_MV", 0);
+  else
+    mv = 0;
+  long value = mv * 1024 / vcc;
+  ADC.value = value > 1023 ? 1023 : value;
+  ADCSRA.value = (ADCSRA.value & ~bit(ADSC)) | bit(ADIF);
+  nativeStats.adcConversions++;
+  serviceInterrupts();
+}
+
+// EEPROM reads and writes complete at once
+static void eecrWritten()
+{
+  if (EECR & bit(EERE))
+  {
+    EEDR.value = nativeEeprom[EEAR & E2END];
+    EECR.value &= ~bit(EERE);
+  }
+  if ((EECR & bit(EEPE)) && (EECR & bit(EEMPE)))
+  {
+    nativeEeprom[EEAR & E2END] = EEDR;
+    nativeStats.eepromWrites++;
+    EECR.value &= ~(bit(EEPE) | bit(EEMPE));
+  }
+  serviceInterrupts();
+}
+
+// Watchdog interval selected by WDTCSR, 16 ms << WDP3..0
+static unsigned long watchdogMs()
+{
+  uint8_t index = (WDTCSR & 7) | ((WDTCSR & bit(WDP3)) ? 8 : 0);
+  return 16UL << (index > 9 ? 9 : index);
+}
+
+void sleep_cpu()
+{
+  if (!(SMCR & bit(SE)))
+    return;
+
+  switch (SMCR & (bit(SM2) | bit(SM1) | bit(SM0)))
+  {
+  case SLEEP_MODE_PWR_DOWN:
+    if (!(SREG & bit(SREG_I)) || !(WDTCSR & bit(WDIE)))
+    {
+      // Nothing can wake the MCU up: the low battery shutdown
+      fprintf(stderr, "Powered down for ever\n");
+      nativeExit(0);
+    }
+    nativeStats.sleptMs += watchdogMs();
+    nativeStats.wakeups++;
+    if (WDT_vect)
+      runHandler(WDT_vect);
+    nativeCheckRunTime();
+    break;
+  case SLEEP_MODE_IDLE:
+    // Woken up by the radio or the next millis() tick: let the simulated radio run
+    yield();
+    nativeCheckRunTime();
+    break;
+  default:
+    // ADC noise reduction: woken up by what is pending
+    break;
+  }
+  serviceInterrupts();
+}
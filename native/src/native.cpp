@@ -0,0 +1,79 @@
+/*
+  Settings, clock and end of run of the native build
+
+  Copyright: desplega.com
+*/
+
+#include <Arduino.h>
+#include <signal.h>
+#include "native.h"
+
+NativeStats nativeStats;
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void onSignal(int)
+{
+  interrupted = 1;
+}
+
+// Loads the EEPROM before setup() reads it, erased unless NATIVE_EEPROM names a saved one
+static struct NativeBoot
+{
+  NativeBoot()
+  {
+    memset(nativeEeprom, 0xff, E2END + 1);
+    const char *path = getenv("NATIVE_EEPROM");
+    FILE *file = path ? fopen(path, "rb") : NULL;
+    if (file)
+    {
+      if (fread(nativeEeprom, 1, E2END + 1, file) != E2END + 1)
+        fprintf(stderr, "%s: short EEPROM image, the rest is erased\n", path);
+      fclose(file);
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+  }
+} boot;
+
+long nativeSetting(const char *name, long def)
+{
+  const char *value = getenv(name);
+  return value && *value ? strtol(value, NULL, 0) : def;
+}
+
+unsigned long nativeMillis()
+{
+  return millis() + nativeStats.sleptMs;
+}
+
+void nativeExit(int status)
+{
+  fflush(stdout);
+  // Outside power down the firmware runs at host speed, so this is not the node's awake time: it is
+  // the host time, mostly the listen windows and waits the firmware times with millis()
+  unsigned long host = millis();
+  fprintf(stderr, "Simulated %lu s: host time %lu ms, powered down %lu ms in %lu watchdog sleeps\n",
+          nativeMillis() / 1000, host, nativeStats.sleptMs, (unsigned long)nativeStats.wakeups);
+  fprintf(stderr, "Radio: %lu uplinks, %lu bytes, %lu ms on air, %lu downlinks\n",
+          (unsigned long)nativeStats.uplinks, (unsigned long)nativeStats.uplinkBytes,
+          (unsigned long)(nativeStats.airtimeUs / 1000), (unsigned long)nativeStats.downlinks);
+  fprintf(stderr, "ADC: %lu conversions, EEPROM: %lu bytes written\n",
+          (unsigned long)nativeStats.adcConversions, (unsigned long)nativeStats.eepromWrites);
+
+  const char *path = getenv("NATIVE_EEPROM");
+  FILE *file = path ? fopen(path, "wb") : NULL;
+  if (file)
+  {
+    fwrite(nativeEeprom, 1, E2END + 1, file);
+    fclose(file);
+  }
+  exit(status);
+}
+
+void nativeCheckRunTime()
+{
+  long seconds = nativeSetting("NATIVE_SECONDS", 0);
+  if (interrupted || (seconds > 0 && nativeMillis() >= (unsigned long)seconds * 1000))
+    nativeExit(0);
+}
@@ -0,0 +1,103 @@
+/*
+  Simulated SX1276 behind the hardware SPI bus, and the gateway it talks to
+
+  RH_RF95 in src/main.cpp uses the default hardware_spi, which the simulator routes to
+  nativeRadio while its slave select (SS) is low. Every packet it sends is heard by the gateway,
+  unless lost (NATIVE_LOSS percent). With NATIVE_ACK set, the gateway acknowledges every frame
+  it hears ('K' and the frame CRC, see store.h) when the node next listens. With NATIVE_ADR set too,
+  it runs an RHAdrServer as tools/gateway.cpp does, on uplinks heard NATIVE_SNR dB above the noise at
+  13 dBm (1 dB more or less per dBm).
+
+  Copyright: desplega.com
+*/
+
+#include <Arduino.h>
+#include <RH_RF95.h>
+#include <RHAdr.h>
+#include <RHutil/RHSimSX1276.h>
+#include "native.h"
+
+class NativeGateway : public RHSimEther
+{
+public:
+  NativeGateway() : ackPending(false), ackLength(0), node(NULL)
+  {
+    setLossPercent(nativeSetting("NATIVE_LOSS", 0)); // Downlinks
+  }
+
+  void transmit(RHSimSX1276 *from, const uint8_t *data, uint8_t len)
+  {
+    uint8_t config1 = from->registerValue(RH_RF95_REG_1D_MODEM_CONFIG1);
+    uint8_t config2 = from->registerValue(RH_RF95_REG_1E_MODEM_CONFIG2);
+    uint16_t preamble = ((uint16_t)from->registerValue(RH_RF95_REG_20_PREAMBLE_MSB) << 8) |
+                        from->registerValue(RH_RF95_REG_21_PREAMBLE_LSB);
+    nativeStats.uplinks++;
+    nativeStats.uplinkBytes += len;
+    nativeStats.airtimeUs += RH_RF95::timeOnAirUs(len, config2 >> 4, (RH_RF95::Bandwidth)(config1 >> 4),
+                                                  ((config1 & RH_RF95_CODING_RATE) >> 1) + 4, preamble,
+                                                  config2 & RH_RF95_PAYLOAD_CRC_ON);
+
+    if (nativeSetting("NATIVE_VERBOSE", 0))
+    {
+      fprintf(stderr, "%lu ms uplink:", nativeMillis());
+      for (uint8_t i = 0; i < len; i++)
+        fprintf(stderr, " %02x", data[i]);
+      fprintf(stderr, "\n");
+    }
+
+    // The payload follows the RadioHead headers, and ends with the frame CRC
+    ackPending = false;
+    long loss = nativeSetting("NATIVE_LOSS", 0); // Uplinks
+    if (nativeSetting("NATIVE_ACK", 0) && len >= RH_RF95_HEADER_LEN + 2 && !(loss && random(100) < loss))
+    {
+      uint8_t command = 0;
+      if (nativeSetting("NATIVE_ADR", 0) && data[2])
+      {
+        long snr = nativeSetting("NATIVE_SNR", 10) + RH_ADR_SETTINGS_POWER(data[2]) - 13;
+        adr.handleUplink(data[1], (int8_t)(snr * 4), data[3], data[2]);
+        command = adr.command(data[1], ack + RH_RF95_HEADER_LEN + 3);
+      }
+      ack[0] = data[1];              // To the node
+      ack[1] = 0;                    // From
+      ack[2] = data[2];              // Id
+      ack[3] = command ? RH_FLAGS_ADR : RH_FLAGS_NONE;
+      ack[4] = 'K';
+      ack[5] = data[len - 2];
+      ack[6] = data[len - 1];
+      ackLength = RH_RF95_HEADER_LEN + 3 + command;
+      ackPending = true;
+      node = from;
+    }
+  }
+
+  void poll()
+  {
+    // The node only hears the ACK if it is listening
+    if (ackPending && (node->registerValue(RH_RF95_REG_01_OP_MODE) & RH_RF95_MODE) == RH_RF95_MODE_RXCONTINUOUS)
+    {
+      ackPending = false;
+      nativeStats.downlinks++;
+      deliver(NULL, ack, ackLength);
+    }
+  }
+
+private:
+  bool ackPending;
+  uint8_t ackLength;
+  RHSimSX1276 *node;
+  RHAdrServer adr;
+  uint8_t ack[RH_RF95_HEADER_LEN + 3 + RH_ADR_COMMAND_LEN];
+};
+
+class NativeRadio : public RHSimSX1276
+{
+public:
+  NativeRadio(NativeGateway &gateway) : RHSimSX1276(gateway, SS, 2)
+  {
+    // Real time on air includes the TX time in the host time, as in the node's awake time, but makes the run slower
+    setAirtime(nativeSetting("NATIVE_AIRTIME", 0));
+  }
+};
+
+NativeGateway nativeGateway;
+NativeRadio nativeRadio(nativeGateway);
@@ -0,0 +1,72 @@
+/*
+  ADC sampling in noise reduction sleep
+
+  Copyright: desplega.com
+*/
+
+#include <avr/sleep.h>
+#include "adc.h"
+#include "log.h"
+#include "profile.h"
+
+// Only wakes the CPU up, the result is read from ADC
+EMPTY_INTERRUPT(ADC_vect);
+
+void adcBegin()
+{
+  // ADC clock 8 MHz / 64 = 125 kHz, within the 50 to 200 kHz needed for 10 bits: 104 us per conversion
+  ADCSRA = bit(ADEN) | bit(ADPS2) | bit(ADPS1);
+}
+
+void adcEnd()
+{
+  ADCSRA &= ~bit(ADEN);
+}
+
+// One conversion, asleep
+static uint16_t convert()
+{
+  ADCSRA |= bit(ADSC);
+  noInterrupts();
+  while (ADCSRA & bit(ADSC))
+  {
+    // Interrupts are only enabled for the instruction after sei, so the ADC interrupt can't fire before we sleep
+    sleep_enable();
+    interrupts();
+    sleep_cpu();
+    noInterrupts();
+  }
+  interrupts();
+  return ADC;
+}
+
+uint16_t adcRead(uint8_t channel, uint8_t samples)
+{
+  LOG_FLUSH(); // The UART clock stops in noise reduction sleep
+  uint8_t phase = profileEnter(PROFILE_ADC);
+
+  ADMUX = bit(REFS0) | (channel & 0x0f);
+  ADCSRA |= bit(ADIE);
+  set_sleep_mode(SLEEP_MODE_ADC);
+
+  // Discarded while the mux (and the bandgap) settle
+  uint16_t previous = convert();
+  uint8_t discarded = 1;
+  while (discarded < ADC_SETTLE_CONVERSIONS)
+  {
+    uint16_t value = convert();
+    discarded++;
+    if (value <= previous + 1 && previous <= value + 1)
+      break;
+    previous = value;
+  }
+  uint16_t sum = 0; // Up to 64 samples fit
+  for (uint8_t i = 0; i < samples; i++)
+    sum += convert();
+
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN); // Back to what initSleep() set
+  ADCSRA &= ~bit(ADIE);
+  profileAdd(PROFILE_ADC, (uint32_t)(samples + discarded) * ADC_CONVERSION_US); // Timer1 stopped while we slept
+  profileLeave(phase);
+  return (sum + samples / 2) / samples;
+}
@@ -0,0 +1,37 @@
+/*
+  SRAM ring buffer of readings waiting to be sent in a batch frame
+
+  Copyright: desplega.com
+*/
+
+#include "batch.h"
+
+TelemetryReading batchReadings[BATCH_CAPACITY];
+uint8_t batchFirst = 0; // Index of the oldest reading
+uint8_t batchSize = 0;  // Number of readings
+
+void batchAdd(const TelemetryReading *reading)
+{
+  if (batchSize == BATCH_CAPACITY)
+    batchDrop(1);
+  batchReadings[(batchFirst + batchSize) % BATCH_CAPACITY] = *reading;
+  batchSize++;
+}
+
+uint8_t batchCount()
+{
+  return batchSize;
+}
+
+const TelemetryReading *batchGet(uint8_t index)
+{
+  return &batchReadings[(batchFirst + index) % BATCH_CAPACITY];
+}
+
+void batchDrop(uint8_t count)
+{
+  if (count > batchSize)
+    count = batchSize;
+  batchFirst = (batchFirst + count) % BATCH_CAPACITY;
+  batchSize -= count;
+}
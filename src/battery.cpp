@@ -12,9 +12,7 @@
 // 40 = 4 volts, 35 = 3.5 volts,  29 = 2.9 volts
 //
 // On each reading we: enable the ADC, take the measurement, and then disable the ADC for power savings.
-// This takes >1ms because the internal reference voltage must stabilize each time the ADC is enabled.
-// For faster readings, you could initialize once, and then take multiple fast readings, just make sure to
-// disable the ADC before going to sleep so you don't waste power.
+// This takes about 2ms (ADC_SAMPLES conversions in noise reduction sleep, see adc.h).
 
 // NOTE: THIS WORKS ON THE LEVEL OF THE BOARD STABILIZER (NOT THE BATTERY LEVEL)
 // Since the stabilizer always shows 3,3V this code does not work :(
@@ -22,35 +20,38 @@
 // detects the low voltage. Hence it is useless.
 // We should rework the board to take directly the Vcc from the battery in order this to work.
 
+#include "adc.h"
 #include "battery.h"
 
-unsigned char readVccVoltage(void)
+static unsigned char measuredVcc = 0; // Measured by batteryMeasure() since the last isVoltageLow(), 0 if not
+
+unsigned char batteryMeasure(void)
 {
   //http://www.gammon.com.au/adc
 
   // Adjust this value to your boards specific internal BG voltage x1000
   const long InternalReferenceVoltage = 1100L; // <-- change this for your ATMEga328P pin 21 AREF value
 
-  // REFS1 REFS0          --> 0 1, AVcc internal ref. -Selects AVcc external reference
-  // MUX3 MUX2 MUX1 MUX0  --> 1110 1.1V (VBG)         -Selects channel 14, bandgap voltage, to measure
-  ADMUX = (0 << REFS1) | (1 << REFS0) | (0 << ADLAR) | (1 << MUX3) | (1 << MUX2) | (1 << MUX1) | (0 << MUX0);
-
-  // Let mux settle a little to get a more stable A/D conversion
-  delay(50);
-
-  // Start a conversion
-  ADCSRA |= _BV(ADSC);
-
-  // Wait for conversion to complete
-  while (((ADCSRA & (1 << ADSC)) != 0))
-    ;
+  // Bandgap (1.1V) against AVcc, averaged. adcRead() discards conversions until the bandgap has
+  // started up, instead of waiting 50ms for the mux to settle
+  unsigned int bandgap = adcRead(ADC_CHANNEL_BANDGAP);
 
   // Scale the value - calculates for straight line value
-  unsigned int results = (unsigned int)((InternalReferenceVoltage * 1024L) / ADC) / 100L;
+  measuredVcc = (unsigned int)((InternalReferenceVoltage * 1024L) / bandgap) / 100L;
+  return measuredVcc;
+}
+
+unsigned char readVccVoltage(void)
+{
+  adcBegin();
+  unsigned char results = batteryMeasure();
+  adcEnd();
   return results;
 }
 
 bool isVoltageLow() {
-  unsigned char vcc = readVccVoltage();
+  // Measured along with the other inputs of this wake up if possible, which saves powering the ADC again
+  unsigned char vcc = measuredVcc ? measuredVcc : readVccVoltage();
+  measuredVcc = 0;
   return vcc < 32 ? true : false;
 }
\ No newline at end of file
@@ -0,0 +1,25 @@
+/*
+  Serial logging with compile-time levels
+
+  Copyright: desplega.com
+*/
+
+#include "log.h"
+#include "profile.h"
+
+#if LOG_LEVEL > LOG_LEVEL_NONE || LOG_TRACE
+void logFlush()
+{
+  uint8_t phase = profileEnter(PROFILE_SERIAL);
+  Serial.flush();
+  profileLeave(phase);
+}
+#endif
+
+#if LOG_TRACE
+void logTrace(uint8_t event, int32_t value)
+{
+  uint8_t record[6] = {LOG_TRACE_SYNC, event, (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24)};
+  Serial.write(record, sizeof(record));
+}
+#endif
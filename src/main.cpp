@@ -15,30 +15,73 @@
 
 #include <SPI.h>
 #include <RH_RF95.h>
+#include <RHAdr.h>
+#include <RHChannelPlan.h>
 
 #include <OneWire.h>
 #include <DallasTemperature.h>
 
+#include "adc.h"
+#include "batch.h"
+#include "battery.h"
+#include "log.h"
 #include "nvm.h"
 #include "powerDown.h"
+#include "profile.h"
+#include "report.h"
+#include "scheduler.h"
+#include "store.h"
+#include "telemetry.h"
 
 // Store deviceID in a permanent variable to avoid reading nvm everytime we need it
 char deviceID[6];
 
 RH_RF95 rf95;
 
+// Adaptive data rate: start at SF7 (Bw125Cr45Sf128) and 13dBm until the gateway commands otherwise
+RHAdrNode adr(rf95, 7, 13);
+uint8_t nodeAddress; // RadioHead address, from the deviceID
+
+// Channels to hop over, each within the duty cycle of its sub-band. LG01-N listens on one, add more for
+// a gateway with a radio per channel (tools/gateway.cpp)
+PROGMEM static const RHChannelPlan::Channel channels[] =
+{
+  {RH_RF95::frequencyToFrf(868000000), 0}, // 868.0-868.6 MHz sub-band: 1% duty cycle
+};
+RHChannelPlan channelPlan(channels, sizeof(channels) / sizeof(channels[0]), 100, 60000);
+
 // LoRa data configuration
-char dt_dat[5];            // Store Sensor Data (MAX 2 devices!)
-#define NODE_ID_LENGTH 6
+TelemetryReading reading;        // Store Sensor Data (MAX 2 devices!)
 const char *node_id = "<1234>";  // LoRa End Node ID
-float frequency = 868.0;
+float frequency = 868.0;         // Until the first send tunes to a channel
 unsigned int count = 1;
 
-// To construct the LoRa packet we expect always a specific number of devices
-#define PACKET_EXPECTED_DEVICES 2
+// Wake cycle
+#define SAMPLE_PERIOD_MS (SLEEP_TIME * WDT_INTERVAL_MS(WDT_INTERVAL_8S)) // Time between readings
+#define BATCH_SIZE 1         // Readings per uplink (up to BATCH_CAPACITY). 1 sends every reading in its own frame
+#define BATCH_FRAME_LENGTH 64 // Largest batch frame, readings that do not fit wait for the next uplink
+static_assert(BATCH_SIZE >= 1 && BATCH_SIZE <= BATCH_CAPACITY, "BATCH_SIZE must be 1 to BATCH_CAPACITY");
+#define LISTEN_EVERY 8       // Until a gateway acknowledges, open a listen window for downlinks (eg ADR commands) after every LISTEN_EVERY sends, 0 never
+#define LISTEN_WINDOW_MS 200 // Length of the listen window
+#define TX_TIMEOUT_MARGIN_MS 100 // Wait this much longer than the time on air for TX done, before giving the frame up
+unsigned long nextSample;    // Deadline of the next reading
+#define PROFILE_DUMP_EVERY 16 // Print the energy profile every PROFILE_DUMP_EVERY readings
+unsigned int sends = 0;      // Number of uplinks
+bool replaying = false;      // The batch holds readings replayed from the store
+bool gatewayAcks = false;    // The last listen window got its ACK: listen after every uplink, so none is left pending
+
+// Last frame sent, for the gateway to acknowledge
+uint16_t sentCRC;                       // CRC16 of the frame
+uint32_t sentSequences[BATCH_CAPACITY]; // Sequence numbers of its readings
+uint8_t sentCount = 0;                  // Number of readings
+
+// Scheduler tasks
+void sampleTask();
+void sendTask();
+void listenTask();
 
 // Harp status input (analog)
-#define HARP_INPUT A0
+#define HARP_INPUT ADC_CHANNEL_A0
 
 // Data wire is plugged into port 4 on the Arduino
 #define ONE_WIRE_BUS 4          // D4 (not the pin number, but the number of digital I/O port)
@@ -54,14 +97,18 @@ int numberOfDevices; // Number of temperature devices found
 
 DeviceAddress tempDeviceAddress; // We'll use this variable to store a found device address
 
+// Addresses of the sensors we read, found once by initDT() to avoid searching the bus on every wake
+DeviceAddress sensorAddress[TELEMETRY_TEMPERATURES];
+uint8_t numberOfSensors = 0;
+
 // Function to print a device address
 void printAddress(DeviceAddress deviceAddress)
 {
   for (uint8_t i = 0; i < 8; i++)
   {
     if (deviceAddress[i] < 16)
-      Serial.print("0");
-    Serial.print(deviceAddress[i], HEX);
+      LOG_DEBUG("0");
+    LOG_DEBUG(deviceAddress[i], HEX);
   }
 }
 
@@ -71,19 +118,20 @@ void initDT(void)
   sensors.begin();
 
   // locate devices on the bus
-  Serial.print("Locating DT devices... ");
+  LOG_DEBUG("Locating DT devices... ");
 
   // Grab a count of devices on the wire
   numberOfDevices = sensors.getDeviceCount();
-  Serial.print(numberOfDevices, DEC);
-  Serial.println(" device(s) found");
+  LOG_DEBUG(numberOfDevices, DEC);
+  LOG_DEBUGLN(" device(s) found");
+  TRACE(TRACE_SENSORS, numberOfDevices);
 
   // Report parasite power requirements
-  Serial.print("Parasite power is: ");
+  LOG_DEBUG("Parasite power is: ");
   if (sensors.isParasitePowerMode())
-    Serial.println("ON");
+    LOG_DEBUGLN("ON");
   else
-    Serial.println("OFF");
+    LOG_DEBUGLN("OFF");
 
   // Loop through each device, print out address
   for (int i = 0; i < numberOfDevices; i++)
@@ -91,38 +139,51 @@ void initDT(void)
     // Search the wire for address
     if (sensors.getAddress(tempDeviceAddress, i))
     {
-      Serial.print("Found device ");
-      Serial.print(i, DEC);
-      Serial.print(" with address: ");
+      LOG_DEBUG("Found device ");
+      LOG_DEBUG(i, DEC);
+      LOG_DEBUG(" with address: ");
       printAddress(tempDeviceAddress);
-      Serial.println();
+      LOG_DEBUGLN();
 
-      Serial.print("Setting resolution to ");
-      Serial.println(TEMPERATURE_PRECISION, DEC);
+      LOG_DEBUG("Setting resolution to ");
+      LOG_DEBUGLN(TEMPERATURE_PRECISION, DEC);
 
       // Set the resolution to TEMPERATURE_PRECISION bit (Each Dallas/Maxim device is capable of several different resolutions)
       sensors.setResolution(tempDeviceAddress, TEMPERATURE_PRECISION);
 
-      Serial.print("Resolution actually set to: ");
-      Serial.print(sensors.getResolution(tempDeviceAddress), DEC);
-      Serial.println();
+      LOG_DEBUG("Resolution actually set to: ");
+      LOG_DEBUG(sensors.getResolution(tempDeviceAddress), DEC);
+      LOG_DEBUGLN();
+
+      if (numberOfSensors < TELEMETRY_TEMPERATURES)
+      {
+        memcpy(sensorAddress[numberOfSensors++], tempDeviceAddress, sizeof(DeviceAddress));
+      }
     }
     else
     {
-      Serial.print("Found ghost device at ");
-      Serial.print(i, DEC);
-      Serial.println(" but could not detect address. Check power and cabling");
+      LOG_ERROR("Found ghost device at ");
+      LOG_ERROR(i, DEC);
+      LOG_ERRORLN(" but could not detect address. Check power and cabling");
+      TRACE(TRACE_GHOST_DEVICE, i);
     }
   }
+
+  // requestTemperatures() only starts the conversion, readData() sleeps while it runs
+  sensors.setWaitForConversion(false);
 }
 
 uint8_t getHarpStatus(void)
 {
-  int analogPin = HARP_INPUT;
-  // If Vh > 0,8V then Harp is On
-  int analogValue = analogRead(analogPin);
-  Serial.print("Vh = ");
-  Serial.println(analogValue);
+  // If Vh > 0,8V then Harp is On. Averaged, so noise around the threshold does not flip it.
+  // The battery is measured in the same ADC session, for the low battery check before the next sleep
+  adcBegin();
+  int analogValue = adcRead(HARP_INPUT);
+  batteryMeasure();
+  adcEnd();
+  LOG_DEBUG("Vh = ");
+  LOG_DEBUGLN(analogValue);
+  TRACE(TRACE_HARP_ADC, analogValue);
   return (analogValue > 250 ? 1 : 0);  
 }
 
@@ -130,284 +191,322 @@ void initLoRa(void)
 {
   // LoRa init
   if (!rf95.init())
-    Serial.println("init failed");
+  {
+    LOG_ERRORLN("init failed");
+    TRACE(TRACE_RADIO_FAILED, 0);
+  }
   // Setup ISM frequency
   rf95.setFrequency(frequency);
-  // Setup Power,dBm
-  rf95.setTxPower(13);
+  // Own address, so the gateway can tell nodes apart for ADR and address its downlinks
+  nodeAddress = nvmNodeAddress(deviceID);
+  rf95.setThisAddress(nodeAddress);
+  rf95.setHeaderFrom(nodeAddress);
+  // Setup modem config and Power,dBm
+  adr.begin();
   rf95.setSyncWord(0x34);
 
-  Serial.println("Dallas Temperature IC Control & LoRa Demo");
-  Serial.print("LoRa End Node ID: ");
+  LOG_INFOLN("Dallas Temperature IC Control & LoRa Demo");
+  LOG_INFO("LoRa End Node ID: ");
 
-  Serial.print(node_id);
-  Serial.println();
+  LOG_INFO(node_id);
+  LOG_INFO(" address ");
+  LOG_INFOLN(nodeAddress, DEC);
 }
 
 void setup()
 {
-  // Configure serial port
-  Serial.begin(9600);
+  // Configure serial port (not in the release build)
+  LOG_BEGIN();
 
   // Init sleep mode
   initSleep();
+  profileBegin();
 
   // Init NVM
   nvmInit();
   nvmGetDeviceID(deviceID);
 
+  // Continue the sequence numbers of the readings logged before the reset
+  reading.sequence = storeInit();
+  TRACE(TRACE_BOOT, reading.sequence);
+
   // Temperature sensors init
+  uint8_t phase = profileEnter(PROFILE_SENSORS);
   initDT();
 
   // LoRa Init
+  profileEnter(PROFILE_RADIO);
   initLoRa();
+  profileLeave(phase);
 
   // Start in idle mode, required to avoid continuous reset... but I don't know why :(
-  delay(1000); // Wait some time just in case to make everything stable
+  LOG_FLUSH();
   rf95.sleep();
   goToSleep(INIT_SLEEP_TIME);
+
+  // First reading right away, then every SAMPLE_PERIOD_MS
+  nextSample = schedulerNow();
+  schedulerAt(nextSample, sampleTask);
 }
 
 void readData()
 {
-  // Get data from temperature sensors (up to 2 devices)
-  if (numberOfDevices > 0)
+  uint8_t phase = profileEnter(PROFILE_SENSORS);
+
+  // Start the conversion on all sensors at once (up to 2 devices), without waiting for it
+  if (numberOfSensors > 0)
   {
-    sensors.requestTemperatures(); // Send the command to get temperature readings
-    for (int i = 0; i < numberOfDevices; i++)
-    {
-      // Search the wire for address
-      if (sensors.getAddress(tempDeviceAddress, i))
-      {
-        // Get temperature for each device
-        float tempC = sensors.getTempC(tempDeviceAddress);
-        dt_dat[i * 2] = (int)tempC;                              // Get temperature integer part
-        dt_dat[(i * 2) + 1] = (int)((tempC - (int)tempC) * 100); // Get temperature decimal part
-      }
-      else
-      {
-        // Ghost device! Check your power requirements and cabling
-        Serial.println("Ghost device!");
-      }
-    }
+    sensors.requestTemperatures();
   }
 
-  // Fill with dummy data in case some sensors fail or are not present
-  switch (numberOfDevices)
+  // Get harp status while the sensors convert
+  reading.harp = getHarpStatus();
+  reading.led = 0; // LED is forced to 0 for now
+
+  // Power down for the rest of the conversion time (~94ms at 9 bits), the sensors keep converting
+  if (numberOfSensors > 0)
   {
-  case 0:
-    dt_dat[0] = 0;
-    dt_dat[1] = 0;
-    // No break
-  case 1:
-    dt_dat[2] = 0;
-    dt_dat[3] = 0;
-    break;
+    LOG_FLUSH();
+    sleepMs(sensors.millisToWaitForConversion(TEMPERATURE_PRECISION));
   }
 
-  // Get harp status
-  dt_dat[4] = getHarpStatus();
+  // Get temperature for each device, from 1/128 C (raw) to 1/16 C fixed point.
+  // Fill with dummy data in case some sensors fail or are not present
+  for (uint8_t i = 0; i < TELEMETRY_TEMPERATURES; i++)
+  {
+    int16_t raw = i < numberOfSensors ? sensors.getTemp(sensorAddress[i]) : 0;
+    if (raw == DEVICE_DISCONNECTED_RAW)
+    {
+      // Ghost device! Check your power requirements and cabling
+      LOG_ERRORLN("Ghost device!");
+      TRACE(TRACE_GHOST_DEVICE, i);
+      raw = 0;
+    }
+    reading.temperature[i] = raw / (128 / TELEMETRY_FIXED16_SCALE);
+  }
+  profileLeave(phase);
 };
 
-uint16_t calcByte(uint16_t crc, uint8_t b)
+void sampleTask()
 {
-  uint32_t i;
-  crc = crc ^ (uint32_t)b << 8;
-
-  for (i = 0; i < 8; i++)
+  LOG_INFO("###########    ");
+  LOG_INFO("COUNT=");
+  LOG_INFO(count);
+  LOG_INFOLN("    ###########");
+  TRACE(TRACE_SAMPLE, count);
+  count++;
+  readData();
+  reading.time = schedulerNow();
+#if TELEMETRY_ENERGY
+  reading.energy = profileCharge();
+#endif
+
+  // Only readings that changed enough, or the heartbeat, are sent. The sequence only counts those,
+  // so gaps at the gateway still mean lost frames
+  if (reportDue(&reading))
   {
-    if ((crc & 0x8000) == 0x8000)
-      crc = crc << 1 ^ 0x1021;
+    reading.sequence++;
+    batchAdd(&reading);
+    storeAppend(&reading); // Written while the reading is sent
+    if (batchCount() >= BATCH_SIZE)
+      schedulerAt(schedulerNow(), sendTask);
     else
-      crc = crc << 1;
+      storeFlush();
+  }
+  else
+  {
+    LOG_DEBUGLN("No change, not sent");
+    TRACE(TRACE_NOT_REPORTED, count);
   }
-  return crc & 0xffff;
+
+  if (count % PROFILE_DUMP_EVERY == 0)
+    profileDump();
+
+  // Deadlines follow the period, not the end of the previous cycle, so there is no drift
+  nextSample += SAMPLE_PERIOD_MS;
+  schedulerAt(nextSample, sampleTask);
 }
 
-uint16_t CRC16(uint8_t *pBuffer, uint32_t length)
+// Idle until the radio raises one of events, or timeout ms elapse (0 waits for ever). Returns the events raised
+uint8_t waitRadio(uint8_t events, uint16_t timeout)
 {
-  uint16_t wCRC16 = 0;
-  uint32_t i;
-  if ((pBuffer == 0) || (length == 0))
-  {
-    return 0;
-  }
-  for (i = 0; i < length; i++)
-  {
-    wCRC16 = calcByte(wCRC16, pBuffer[i]);
-  }
-  return wCRC16;
+  unsigned long start = millis();
+  uint8_t raised = 0;
+  // An event raised right before idleSleep() is seen after the next millis() tick, 1ms later at most
+  while (!((raised |= rf95.handleEvents()) & events) && (timeout == 0 || millis() - start < timeout))
+    idleSleep();
+  return raised;
 }
 
-void loop()
+void sendTask()
 {
-  Serial.print("###########    ");
-  Serial.print("COUNT=");
-  Serial.print(count);
-  Serial.println("    ###########");
-  count++;
-  readData();
-  char data[50] = {0};
-  int dataLength = NODE_ID_LENGTH + DEVICE_ID_LENGTH + PACKET_EXPECTED_DEVICES * 2 + 1; // Payload Length: node_id + temperature(s) + harp
+  if (batchCount() == 0)
+    return; // Already sent, by a run scheduled before this one was deferred
 
-  // Add to data[x] the Node ID
-  for (int i = 0; i < NODE_ID_LENGTH; i++) {
-    data[i] = node_id[i];
+  // Every sub-band still in its duty cycle off time (eg during a replay): send once one is free
+  unsigned long now = schedulerNow();
+  uint8_t channel = channelPlan.selectChannel(nodeAddress, now);
+  if (channel == RH_CHANNEL_NONE)
+  {
+    uint32_t offTime = channelPlan.offTime(now);
+    LOG_INFO("Duty cycle, send deferred ms: ");
+    LOG_INFOLN(offTime);
+    TRACE(TRACE_DEFERRED, offTime);
+    schedulerAt(now + offTime, sendTask);
+    return;
   }
 
-  // Get device ID
+  LOG_DEBUG("Device ID:");
   for (int i = 0; i < DEVICE_ID_LENGTH; i++)
   {
-    data[NODE_ID_LENGTH + i] = deviceID[i];
-  }
-  Serial.print("Device ID: ");
-  // Convert node ID to text
-  char str[25];
-  sprintf(str, "%02d %02d %02d %02d %02d %02d", deviceID[0], deviceID[1], deviceID[2], deviceID[3], deviceID[4], deviceID[5]);
-  str[24] = 0x00; // End of string
-  Serial.println(str);
-
-  // Get temperature(s)
-  for (int i = 0; i < PACKET_EXPECTED_DEVICES; i++)
-  {
-    data[NODE_ID_LENGTH + DEVICE_ID_LENGTH + (i * 2)] = dt_dat[i * 2];        //Get Temperature Integer Part
-    data[NODE_ID_LENGTH + DEVICE_ID_LENGTH + 1 + (i * 2)] = dt_dat[(i * 2) + 1]; //Get Temperature Decimal Part
+    LOG_DEBUG(" ");
+    LOG_DEBUG(deviceID[i], DEC);
   }
+  LOG_DEBUGLN();
 
-  // Get harp status
-  data[NODE_ID_LENGTH + DEVICE_ID_LENGTH + PACKET_EXPECTED_DEVICES * 2] = dt_dat[4]; // Harp status
-
-  // Print temperature(s)
-  for (int i = 0; i < PACKET_EXPECTED_DEVICES; i++)
+  // Print temperature(s) in 1/16 C
+  for (int i = 0; i < TELEMETRY_TEMPERATURES; i++)
   {
-    Serial.print("Temperature ");
-    Serial.print(i);
-    Serial.print(": ");
-    Serial.print(data[NODE_ID_LENGTH + DEVICE_ID_LENGTH + (i * 2)], DEC); //Show temperature
-    Serial.print(",");
-    Serial.print(data[NODE_ID_LENGTH + DEVICE_ID_LENGTH + 1 + (i * 2)], DEC); //Show temperature
-    Serial.println("C");
+    LOG_DEBUG("Temperature ");
+    LOG_DEBUG(i);
+    LOG_DEBUG(": ");
+    LOG_DEBUG(reading.temperature[i], DEC); //Show temperature
+    LOG_DEBUGLN("/16 C");
+    TRACE(TRACE_TEMPERATURE, (int32_t)i << 16 | (uint16_t)reading.temperature[i]);
   }
   // Print harp status
-  Serial.print("Harp status: ");
-  Serial.println(data[NODE_ID_LENGTH + DEVICE_ID_LENGTH + PACKET_EXPECTED_DEVICES * 2], DEC); // Show harp status
-
-  uint16_t crcData = CRC16((unsigned char *)data, dataLength); //get CRC DATA
-  //Serial.println(crcData,HEX);
-
-  Serial.print("Data to be sent(without CRC): ");
-
-  for (int i = 0; i < dataLength; i++)
+  LOG_DEBUG("Harp status: ");
+  LOG_DEBUGLN(reading.harp, DEC); // Show harp status
+
+  // Encode the buffered reading(s) as a binary telemetry frame, the gateway turns it into JSON (see tools/telemetry_decode.cpp)
+  uint8_t sendBuf[BATCH_FRAME_LENGTH > TELEMETRY_MAX_FRAME_LENGTH ? BATCH_FRAME_LENGTH : TELEMETRY_MAX_FRAME_LENGTH];
+  uint8_t length;
+  uint8_t encoded = 1;
+  if (batchCount() == 1 && !replaying)
   {
-    Serial.print(data[i], HEX);
-    Serial.print(" ");
+    length = telemetryEncode(batchGet(0), deviceID, sendBuf);
   }
-  Serial.println();
-
-  unsigned char sendBuf[100] = {0};
-
-  for (int i = 0; i < dataLength; i++)
+  else
   {
-    sendBuf[i] = data[i];
+    // Readings delta-encoded against the previous one, the first one timestamped by its age
+    const TelemetryReading *readings[BATCH_CAPACITY];
+    for (uint8_t i = 0; i < batchCount(); i++)
+      readings[i] = batchGet(i);
+    length = telemetryEncodeBatch(readings, batchCount(), schedulerNow(), deviceID, sendBuf, sizeof(sendBuf), &encoded);
   }
-
-  sendBuf[dataLength] = (unsigned char)crcData;            // Add CRC to LoRa Data
-  sendBuf[dataLength + 1] = (unsigned char)(crcData >> 8); // Add CRC to LoRa Data
-  
-  Serial.print("Data to be sent(with CRC):    ");
-  for (int i = 0; i < (dataLength + 2); i++)
+  // Sent readings stay pending in the store until the gateway acknowledges this frame
+  sentCRC = sendBuf[length - 2] | ((uint16_t)sendBuf[length - 1] << 8);
+  sentCount = encoded;
+  for (uint8_t i = 0; i < encoded; i++)
+    sentSequences[i] = batchGet(i)->sequence;
+  batchDrop(encoded);
+
+  LOG_DEBUG("Data to be sent(with CRC):    ");
+  for (int i = 0; i < length; i++)
   {
-    Serial.print(sendBuf[i], HEX);
-    Serial.print(" ");
-  }
-  Serial.println();
-
-  //rf95.send(sendBuf, dataLength + 2); //Send LoRa Data
-
-  // Adapt for LG01-N (Ack not implemented yet, no CRC is sent for now) *******************
-  char dataSend[100] = {0};
-  char intStr[5];
-  int bufIndex;
-
-  for (bufIndex = 0; bufIndex < NODE_ID_LENGTH; bufIndex++) {
-    dataSend[bufIndex] = sendBuf[bufIndex];
+    LOG_DEBUG(sendBuf[i], HEX);
+    LOG_DEBUG(" ");
   }
-  strcat(dataSend, "{\"number\":\"");
-  for (int i = 0; i < DEVICE_ID_LENGTH; i++) {
-    sprintf(intStr, "%02d", sendBuf[bufIndex++]);
-    strcat(dataSend, intStr);
+  LOG_DEBUGLN();
+
+  TRACE(TRACE_SEND, length);
+  profileTxPower(adr.txPower());
+  uint8_t phase = profileEnter(PROFILE_TX);
+  rf95.handleEvents(); // Forget the events of earlier exchanges
+  rf95.setHeaderFlags(adr.uplinkFlags(), RH_FLAGS_ADR); // Tells the gateway we fell back from its last ADR command
+  rf95.setHeaderId(adr.uplinkId()); // And the settings we send with, which confirm its commands
+  channelPlan.tune(rf95, channel);
+  uint16_t airtime = RH_RF95::timeOnAirUs(length + RH_RF95_HEADER_LEN, adr.spreadingFactor(), RH_RF95::Bw125kHz, 5) / 1000 + 1;
+  channelPlan.recordTransmit(channel, airtime, schedulerNow());
+  rf95.send(sendBuf, length); //Send LoRa Data
+  // Idle until TX done (raised by the driver interrupt), then sleep right away
+  bool sent = waitRadio(RH_EVENT_TX_DONE, airtime + TX_TIMEOUT_MARGIN_MS) & RH_EVENT_TX_DONE;
+  profileLeave(phase);
+  if (!sent)
+  {
+    // No TX done (radio hung, DIO0 lost): stop the transmitter. The readings stay pending in the store
+    rf95.setModeIdle();
+    rf95.sleep();
+    LOG_ERRORLN("LoRa TX timeout");
+    TRACE(TRACE_TX_TIMEOUT, length);
+    storeFlush();
+    return;
   }
-  strcat(dataSend, "\",\"data\":{\"t0\":\"");
-  sprintf(intStr, "%d", sendBuf[bufIndex++]);
-  strcat(dataSend, intStr);
-  strcat(dataSend, ".");
-  sprintf(intStr, "%d", sendBuf[bufIndex++]);
-  strcat(dataSend, intStr);
-  strcat(dataSend, "\",\"t1\":\"");
-  sprintf(intStr, "%d", sendBuf[bufIndex++]);
-  strcat(dataSend, intStr);
-  strcat(dataSend, ".");
-  sprintf(intStr, "%d", sendBuf[bufIndex++]);
-  strcat(dataSend, intStr);
-  strcat(dataSend, "\",\"h\":\"");
-  sprintf(intStr, "%d", sendBuf[bufIndex++]);
-  strcat(dataSend, intStr);
-  strcat(dataSend, "\",\"l\":\"");
-  sprintf(intStr, "%d", 0); // LED is forced to 0 for now
-  strcat(dataSend, intStr);
-  strcat(dataSend, "\"}}");
-
-  Serial.println(dataSend);
-  int length = strlen(dataSend);
-  Serial.print("Packet length: ");
-  Serial.println(length);
-
-  strcpy((char *)sendBuf, dataSend);
-  rf95.send(sendBuf, strlen(dataSend)); //Send LoRa Data
-  Serial.println("LoRa packet sent...");
-  //***************************************************************************************
-
-  /* No Ack yet for LG01-N */
-  /*
-  uint8_t buf[RH_RF95_MAX_MESSAGE_LEN]; //Reply data array
-  uint8_t len = sizeof(buf);            //reply data length
-
-  if (rf95.waitAvailableTimeout(3000)) // Check If there is reply in 3 seconds.
+  LOG_INFOLN("LoRa packet sent...");
+  storeFlush(); // Mostly done while on air
+
+  // After a replay, or while the gateway acknowledges, listen for the ACK of this frame. Otherwise its
+  // readings stay pending and are replayed once an ACK comes, costing airtime and EEPROM writes
+  sends++;
+  if (replaying || gatewayAcks || (LISTEN_EVERY && sends % LISTEN_EVERY == 0))
+    schedulerAt(schedulerNow(), listenTask);
+  else
+    rf95.sleep(); // Disable LoRa radio
+}
+
+void listenTask()
+{
+  // No Ack from LG01-N, but other gateways may acknowledge the last frame or send ADR commands right after an uplink,
+  // on their own or following the ACK
+  uint8_t buf[STORE_ACK_LEN + RH_ADR_COMMAND_LEN];
+  uint8_t len = sizeof(buf);
+  bool acknowledged = false;
+  bool heard = false; // A valid downlink came: the gateway answers
+  uint8_t phase = profileEnter(PROFILE_RX);
+  rf95.setModeRx();
+  bool received = (waitRadio(RH_EVENT_RECEIVE, LISTEN_WINDOW_MS) & RH_EVENT_RECEIVE) && rf95.recv(buf, &len);
+  profileLeave(phase);
+  if (received)
   {
-    // Should be a reply message for us now
-    if (rf95.recv(buf, &len)) //check if reply message is correct
+    uint8_t *command = buf;
+    if (len >= STORE_ACK_LEN && buf[0] == STORE_ACK_COMMAND)
     {
-      if (buf[0] == node_id[0] && buf[1] == node_id[2] && buf[2] == node_id[2]) // Check if reply message has the our node ID
+      heard = true; // Maybe the ACK of another node's frame
+      if ((buf[1] | ((uint16_t)buf[2] << 8)) == sentCRC)
       {
-        Serial.print("Got Reply from Gateway: "); //print reply
-        // Convert node ID to text
-        char str[4]; // Considered last 0 character for strings
-        sprintf(str, "%d%d%d", buf[0], buf[1], buf[2]);
-        buf[0] = str[0];
-        buf[1] = str[1];
-        buf[2] = str[2];
-        Serial.println((char *)buf);
-
-        Serial.print("RSSI: "); // Print RSSI
-        Serial.println(rf95.lastRssi(), DEC);
+        acknowledged = true;
+        TRACE(TRACE_ACK, sentCRC);
+        for (uint8_t i = 0; i < sentCount; i++)
+          storeAck(sentSequences[i]);
+        sentCount = 0;
       }
+      command += STORE_ACK_LEN;
+      len -= STORE_ACK_LEN;
     }
-    else
+    if (adr.handleMessage(command, len, rf95.headerFlags()))
     {
-      Serial.println("recv failed");
-      //rf95.send(sendBuf, strlen((char *)sendBuf)); // Resend if no reply
+      LOG_INFO("ADR command applied, RSSI: ");
+      LOG_INFOLN(rf95.lastRssi(), DEC);
+      TRACE(TRACE_ADR, rf95.lastRssi());
+      heard = true;
     }
   }
-  else
+  rf95.sleep(); // Disable LoRa radio
+  adr.sendResult(heard); // Falls back to more power, then a higher SF, after consecutive silent windows of a gateway that answers
+  gatewayAcks = acknowledged;
+
+  // The link works: replay what was not acknowledged before, one batch at a time
+  replaying = false;
+  if (acknowledged && batchCount() == 0)
   {
-    Serial.println("No reply, is LoRa gateway running?"); // No signal reply
-    //rf95.send(sendBuf, strlen((char *)sendBuf));          // Resend data
+    uint16_t cursor = 0;
+    TelemetryReading pending;
+    while (batchCount() < BATCH_CAPACITY && storeNextPending(&cursor, &pending))
+      batchAdd(&pending);
+    if (batchCount() > 0)
+    {
+      LOG_INFO("Replaying readings: ");
+      LOG_INFOLN(batchCount());
+      TRACE(TRACE_REPLAY, batchCount());
+      replaying = true;
+      schedulerAt(schedulerNow(), sendTask);
+    }
   }
-  Serial.println("");
-  */
+  storeFlush();
+}
 
-  // Power down mode
-  delay(2000);  // Wait some time just in case to make everything stable
-  rf95.sleep(); // Disable LoRa radio
-  goToSleep(SLEEP_TIME);
+void loop()
+{
+  // Runs the due tasks, then powers down until the next deadline
+  schedulerRun();
 }
@@ -43,3 +43,15 @@ void nvmGetDeviceID(char *deviceID)
     deviceID[i] = EEPROM.read(DEVICE_ID_ADDR + i);
   }
 }
+
+uint8_t nvmNodeAddress(const char *deviceID)
+{
+  // Hash the deviceID into 1..254: never the gateway (0) or broadcast (0xFF). Two nodes may share an
+  // address, which only makes them share their ADR settings
+  uint16_t hash = 0;
+  for (int i = 0; i < DEVICE_ID_LENGTH; i++)
+  {
+    hash = hash * 31 + (uint8_t)deviceID[i];
+  }
+  return hash % 254 + 1;
+}
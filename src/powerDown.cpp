@@ -14,6 +14,7 @@ Author:       desplega (www.desplega.com)
 #include "battery.h"
 
 volatile char wdt_counter = 0; // Counter for Watchdog
+unsigned long slept = 0;       // Total time spent in power down, in ms
 
 // Watchdog interrupt
 // Note: usually <Arduino.h> is required to use ISR
@@ -23,35 +24,57 @@ ISR(WDT_vect)
   wdt_counter++;
 }
 
+// Set the watchdog in interrupt mode with an interval of 16ms << index (index 0 to 9, 16ms to 8s)
+static void setWatchdogInterval(uint8_t index)
+{
+  noInterrupts();
+  wdt_reset();
+  // Timed sequence: WDCE then the new configuration within 4 cycles
+  WDTCSR = bit(WDCE) | bit(WDE);
+  WDTCSR = bit(WDIE) | ((index & 8) ? bit(WDP3) : 0) | (index & 7);
+  interrupts();
+}
+
 // Init sleep mode
 void initSleep()
 {
   // Setup watchdog
-  WDTCSR = bit(WDCE) | bit(WDE);
-  // Set interrupt mode and an interval
-  WDTCSR = bit(WDIE) | bit(WDP3) | bit(WDP0); // Set WDIE, and 8 seconds delay
-  wdt_reset();                                // Reset the watchdog
+  setWatchdogInterval(WDT_INTERVAL_8S); // Set WDIE, and 8 seconds delay
+  wdt_reset();                          // Reset the watchdog
 
   //ENABLE SLEEP - this enables the sleep mode
   set_sleep_mode(SLEEP_MODE_PWR_DOWN); // set up sleep mode
   sleep_enable();
 }
 
+void shutdown()
+{
+  // Else the watchdog interrupt (or a pending one) wakes the CPU every 8 s only to sleep again
+  MCUSR &= ~bit(WDRF); // WDE can't be cleared while set
+  wdt_disable();
+  WDTCSR = bit(WDIF); // Written 1 to clear
+  noInterrupts(); // FORCED SLEEP MODE FOR EVER
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+  for (;;) // In case something wakes the CPU up anyway
+  {
+    //BOD disable - this must be called right before the __asm__ sleep instruction
+    MCUCR = bit(BODS) | bit(BODSE);
+    MCUCR = bit(BODS);
+    sleep_mode(); // Entering sleep mode
+  }
+}
+
 void goToSleep(char time)
 {
   if (isVoltageLow())
   {
-      noInterrupts(); // FORCED SLEEP MODE FOR EVER
-      //BOD disable - this must be called right before the __asm__ sleep instruction
-      MCUCR = bit(BODS) | bit(BODSE);
-      MCUCR = bit(BODS);
-      sleep_mode(); // Entering sleep mode
+    shutdown();
   }
   else
   {
     wdt_counter = 0;
     wdt_reset(); // Reset the watchdog
-    // Disable ADC
+    // Disable ADC (adcBegin() powers it up when needed)
     ADCSRA &= ~_BV(ADEN);
     // Configure A0 as input to avoid leaks when in power down mode
     pinMode(A0, INPUT);
@@ -63,7 +86,45 @@ void goToSleep(char time)
       MCUCR = bit(BODS);
       sleep_mode(); // Entering sleep mode
     } while (wdt_counter < time);
-    // Enable ADC
-    ADCSRA |= _BV(ADEN);
+    slept += time * WDT_INTERVAL_MS(WDT_INTERVAL_8S);
+  }
+}
+
+void idleSleep()
+{
+  // Only the CPU clock stops, the timers and SPI keep running
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  sleep_mode();
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN); // Back to the mode goToSleep() and sleepMs() expect
+}
+
+void sleepMs(unsigned long ms)
+{
+  // Disable ADC (adcBegin() powers it up when needed)
+  ADCSRA &= ~_BV(ADEN);
+  while (ms > 0)
+  {
+    // Longest watchdog interval that does not overshoot, or the shortest one for the remainder
+    uint8_t index = WDT_INTERVAL_8S;
+    while (index > 0 && WDT_INTERVAL_MS(index) > ms)
+      index--;
+    setWatchdogInterval(index);
+    wdt_counter = 0;
+    do
+    {
+      //BOD disable - this must be called right before the __asm__ sleep instruction
+      MCUCR = bit(BODS) | bit(BODSE);
+      MCUCR = bit(BODS);
+      sleep_mode(); // Entering sleep mode
+    } while (wdt_counter == 0); // Other interrupts (eg LoRa DIO0) may wake us up earlier
+    slept += WDT_INTERVAL_MS(index);
+    ms -= ms < WDT_INTERVAL_MS(index) ? ms : WDT_INTERVAL_MS(index);
   }
+  // Back to the interval goToSleep() counts in
+  setWatchdogInterval(WDT_INTERVAL_8S);
+}
+
+unsigned long sleptMillis()
+{
+  return slept;
 }
@@ -0,0 +1,226 @@
+/*
+  Awake time and energy profiler
+
+  Copyright: desplega.com
+*/
+
+#include "profile.h"
+
+#if PROFILE
+
+#include "log.h"
+#include "powerDown.h"
+
+#ifndef __AVR__
+#include <time.h>
+#endif
+
+// Names for profileDump(), in phase order
+static const char phaseNames[PROFILE_PHASES][8] PROGMEM = {"mcu", "sensors", "adc", "serial", "radio", "tx", "rx", "sleep"};
+
+// TX current of the SX1276 PA_BOOST output by power, from the datasheet, interpolated in between
+typedef struct
+{
+  int8_t power;     // dBm
+  uint32_t current; // uA, radio only
+} TxCurrent;
+
+static const TxCurrent txCurrents[] PROGMEM = {{2, 18000}, {7, 20000}, {13, 29000}, {17, 87000}, {20, 120000}};
+#define TX_CURRENTS (sizeof(txCurrents) / sizeof(txCurrents[0]))
+
+ProfileTotals profile;
+uint16_t profileMicrosRemainder[PROFILE_PHASES]; // Time not yet counted in profile.ms, < 1000 us
+uint16_t profileChargeRemainder[PROFILE_PHASES]; // Charge not yet counted in profile.charge, < 1000 nC
+uint8_t profilePhase = PROFILE_MCU;
+uint32_t profileLast;          // profileTicks() at the last update
+uint8_t profileTickRemainder;  // Ticks not yet counted, < TICKS_PER_US
+unsigned long profileSlept;    // sleptMillis() at the last update
+uint32_t profileTxMicroamps = 29000 + PROFILE_UA_MCU;
+
+#ifdef __AVR__
+volatile uint16_t timer1Overflows = 0;
+
+ISR(TIMER1_OVF_vect)
+{
+  timer1Overflows++;
+}
+
+// Timer ticks per microsecond
+#define TICKS_PER_US (F_CPU / 1000000UL)
+
+// CPU cycles since profileBegin(), while awake (Timer1 stops in power down and ADC noise reduction).
+// Wraps every 2^32 cycles, 537 s awake at 8 MHz
+static uint32_t profileTicks()
+{
+  uint8_t sreg = SREG;
+  noInterrupts();
+  uint16_t low = TCNT1;
+  uint16_t high = timer1Overflows;
+  if ((TIFR1 & bit(TOV1)) && low < 0x8000)
+    high++; // Overflowed after interrupts were disabled
+  SREG = sreg;
+  return (uint32_t)high << 16 | low;
+}
+#else
+#define TICKS_PER_US 1
+
+// The host build measures real time, in us
+static uint32_t profileTicks()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)((uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000);
+}
+#endif
+
+// Current drawn while awake in a phase, in uA
+static uint32_t awakeCurrent(uint8_t phase)
+{
+  switch (phase)
+  {
+  case PROFILE_SENSORS:
+    return PROFILE_UA_MCU + PROFILE_UA_SENSORS;
+  case PROFILE_ADC:
+    return PROFILE_UA_ADC;
+  case PROFILE_RADIO:
+    return PROFILE_UA_MCU + PROFILE_UA_RADIO_STANDBY;
+  case PROFILE_TX:
+    return profileTxMicroamps;
+  case PROFILE_RX:
+    return PROFILE_UA_MCU + PROFILE_UA_RX;
+  default:
+    return PROFILE_UA_MCU;
+  }
+}
+
+// Current drawn while powered down during a phase, in uA
+static uint32_t sleepCurrent(uint8_t phase)
+{
+  return phase == PROFILE_SENSORS ? PROFILE_UA_SLEEP + PROFILE_UA_SENSORS : PROFILE_UA_SLEEP;
+}
+
+// Adds time at a current to a phase
+static void account(uint8_t phase, uint32_t micros, uint32_t microamps)
+{
+  uint32_t time = profileMicrosRemainder[phase] + micros;
+  profile.ms[phase] += time / 1000;
+  profileMicrosRemainder[phase] = time % 1000;
+
+  uint64_t nanocoulombs = profileChargeRemainder[phase] + (uint64_t)micros * microamps / 1000;
+  profile.charge[phase] += (uint32_t)(nanocoulombs / 1000);
+  profileChargeRemainder[phase] = nanocoulombs % 1000;
+}
+
+// Charges the time since the last update to the current phase
+static void update()
+{
+  uint32_t now = profileTicks();
+  unsigned long slept = sleptMillis();
+  // Converted after the subtraction, so the difference stays right when the ticks wrap
+  uint32_t ticks = now - profileLast;
+  uint32_t micros = ticks / TICKS_PER_US;
+  profileTickRemainder += ticks % TICKS_PER_US;
+  if (profileTickRemainder >= TICKS_PER_US)
+  {
+    micros++;
+    profileTickRemainder -= TICKS_PER_US;
+  }
+  account(profilePhase, micros, awakeCurrent(profilePhase));
+  account(PROFILE_SLEEP, (slept - profileSlept) * 1000, sleepCurrent(profilePhase));
+  profileLast = now;
+  profileSlept = slept;
+}
+
+void profileBegin()
+{
+#ifdef __AVR__
+  // Timer1 free running at the CPU clock, counting overflows
+  TCCR1A = 0;
+  TCCR1B = bit(CS10);
+  TCNT1 = 0;
+  TIFR1 = bit(TOV1);
+  TIMSK1 = bit(TOIE1);
+#endif
+  memset(&profile, 0, sizeof(profile));
+  memset(profileMicrosRemainder, 0, sizeof(profileMicrosRemainder));
+  memset(profileChargeRemainder, 0, sizeof(profileChargeRemainder));
+  profilePhase = PROFILE_MCU;
+  profileLast = profileTicks();
+  profileTickRemainder = 0;
+  profileSlept = sleptMillis();
+}
+
+uint8_t profileEnter(uint8_t phase)
+{
+  uint8_t previous = profilePhase;
+  update();
+  profilePhase = phase;
+  return previous;
+}
+
+void profileLeave(uint8_t previous)
+{
+  profileEnter(previous);
+}
+
+void profileAdd(uint8_t phase, uint32_t micros)
+{
+  account(phase, micros, awakeCurrent(phase));
+}
+
+void profileTxPower(int8_t power)
+{
+  TxCurrent low, high;
+  memcpy_P(&low, &txCurrents[0], sizeof(low));
+  high = low;
+  for (uint8_t i = 1; i < TX_CURRENTS && high.power < power; i++)
+  {
+    low = high;
+    memcpy_P(&high, &txCurrents[i], sizeof(high));
+  }
+
+  uint32_t current = high.current;
+  if (power < high.power && power > low.power)
+    current = low.current + (high.current - low.current) * (uint32_t)(power - low.power) / (uint32_t)(high.power - low.power);
+  profileTxMicroamps = PROFILE_UA_MCU + current;
+}
+
+const ProfileTotals *profileTotals()
+{
+  update();
+  return &profile;
+}
+
+uint32_t profileCharge()
+{
+  update();
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < PROFILE_PHASES; i++)
+    total += profile.charge[i];
+  return total / 1000;
+}
+
+void profileDump()
+{
+  update();
+  uint32_t totalMs = 0, totalCharge = 0;
+  LOG_INFOLN("phase      ms        uC");
+  for (uint8_t i = 0; i < PROFILE_PHASES; i++)
+  {
+    char name[sizeof(phaseNames[0])];
+    memcpy_P(name, phaseNames[i], sizeof(name));
+    LOG_INFO(name);
+    LOG_INFO("\t");
+    LOG_INFO(profile.ms[i]);
+    LOG_INFO("\t");
+    LOG_INFOLN(profile.charge[i]);
+    totalMs += profile.ms[i];
+    totalCharge += profile.charge[i];
+  }
+  LOG_INFO("total\t");
+  LOG_INFO(totalMs);
+  LOG_INFO("\t");
+  LOG_INFOLN(totalCharge);
+}
+
+#endif
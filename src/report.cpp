@@ -0,0 +1,76 @@
+/*
+  Report by exception: decides which readings are worth an uplink
+
+  Copyright: desplega.com
+*/
+
+#include "report.h"
+
+// Deadband of each field, in telemetrySchema order and in the units of the field.
+// A field triggers a report when it differs from the last reported value by more than its deadband,
+// so 0 reports any change at once
+const uint16_t reportDeadbands[] PROGMEM = {
+  REPORT_IGNORE,               // Sequence, only set on reported readings
+  REPORT_DEADBAND_TEMPERATURE, // t0
+  REPORT_DEADBAND_TEMPERATURE, // t1
+  0,                           // Harp, a state change is sent immediately
+  REPORT_IGNORE,               // LED, forced to 0 for now
+#if TELEMETRY_ENERGY
+  REPORT_IGNORE,               // Energy, always grows
+#endif
+};
+
+TelemetryReading lastReport;
+bool reported = false;
+
+// Tells whether one field of reading is outside its deadband around the last report
+static bool fieldChanged(const TelemetryReading *reading, uint8_t index)
+{
+  TelemetryField field;
+  uint16_t deadband;
+  memcpy_P(&deadband, &reportDeadbands[index], sizeof(deadband));
+  if (deadband == REPORT_IGNORE)
+    return false;
+
+  telemetryGetField(index, &field);
+  const uint8_t *src = (const uint8_t *)reading + field.offset;
+  const uint8_t *last = (const uint8_t *)&lastReport + field.offset;
+  int32_t difference;
+  switch (field.type)
+  {
+  case TELEMETRY_VARINT:
+  {
+    uint32_t value, base;
+    memcpy(&value, src, sizeof(value));
+    memcpy(&base, last, sizeof(base));
+    difference = (int32_t)(value - base);
+    break;
+  }
+  case TELEMETRY_FIXED16:
+  {
+    int16_t value, base;
+    memcpy(&value, src, sizeof(value));
+    memcpy(&base, last, sizeof(base));
+    difference = (int32_t)value - base;
+    break;
+  }
+  default:
+    difference = (int32_t)*src - *last;
+    break;
+  }
+  return difference > (int32_t)deadband || difference < -(int32_t)deadband;
+}
+
+bool reportDue(const TelemetryReading *reading)
+{
+  bool due = !reported || reading->time - lastReport.time >= REPORT_HEARTBEAT_MS;
+  for (uint8_t i = 0; !due && i < telemetrySchemaLength; i++)
+    due = fieldChanged(reading, i);
+
+  if (due)
+  {
+    lastReport = *reading;
+    reported = true;
+  }
+  return due;
+}
@@ -0,0 +1,69 @@
+/*
+  Deadline ordered task scheduler for the wake/sleep cycle
+
+  Copyright: desplega.com
+*/
+
+#include "scheduler.h"
+#include "powerDown.h"
+#include "battery.h"
+#include "log.h"
+
+typedef struct
+{
+  unsigned long due;
+  SchedulerTask task;
+} ScheduledTask;
+
+// Pending tasks, sorted by deadline
+ScheduledTask tasks[SCHEDULER_MAX_TASKS];
+uint8_t numberOfTasks = 0;
+
+unsigned long schedulerNow()
+{
+  return millis() + sleptMillis();
+}
+
+bool schedulerAt(unsigned long due, SchedulerTask task)
+{
+  if (numberOfTasks == SCHEDULER_MAX_TASKS)
+    return false;
+
+  // Insert after the tasks with the same or an earlier deadline (wrap safe)
+  uint8_t i = numberOfTasks;
+  while (i > 0 && (long)(tasks[i - 1].due - due) > 0)
+  {
+    tasks[i] = tasks[i - 1];
+    i--;
+  }
+  tasks[i].due = due;
+  tasks[i].task = task;
+  numberOfTasks++;
+  return true;
+}
+
+void schedulerRun()
+{
+  // Run the due tasks. They may schedule new ones
+  while (numberOfTasks > 0 && (long)(schedulerNow() - tasks[0].due) >= 0)
+  {
+    SchedulerTask task = tasks[0].task;
+    numberOfTasks--;
+    for (uint8_t i = 0; i < numberOfTasks; i++)
+      tasks[i] = tasks[i + 1];
+    task();
+  }
+
+  if (numberOfTasks == 0)
+    return;
+  long wait = (long)(tasks[0].due - schedulerNow());
+  if (wait <= 0)
+    return;
+
+  // Same low battery protection as goToSleep(), only before long sleeps so short waits stay short
+  if (wait >= (long)WDT_INTERVAL_MS(WDT_INTERVAL_8S) && isVoltageLow())
+    shutdown();
+
+  LOG_FLUSH();
+  sleepMs(wait);
+}
@@ -0,0 +1,158 @@
+/*
+  Store-and-forward log of readings in EEPROM
+
+  Copyright: desplega.com
+*/
+
+#include <EEPROM.h>
+#include "store.h"
+
+static_assert(sizeof(TelemetryReading) < STORE_RECORD_LENGTH, "TelemetryReading does not fit in a store record");
+
+// Offset of the status byte in a record
+#define STATUS_OFFSET (STORE_RECORD_LENGTH - 1)
+
+// Queue of bytes waiting to be written, a record plus a few ACKs
+#define QUEUE_LENGTH (STORE_RECORD_LENGTH + 4)
+
+typedef struct
+{
+  uint16_t address;
+  uint8_t value;
+} QueuedWrite;
+
+volatile QueuedWrite queue[QUEUE_LENGTH];
+volatile uint8_t queueFirst = 0;
+volatile uint8_t queueSize = 0;
+
+uint16_t storeHead = 0;         // Record the next reading goes to
+uint32_t storeBootSequence = 0; // Newest sequence number logged before the last reset
+
+// Writes the next queued byte that differs from the EEPROM, or stops the interrupt when none is left
+ISR(EE_READY_vect)
+{
+  while (queueSize > 0)
+  {
+    uint16_t address = queue[queueFirst].address;
+    uint8_t value = queue[queueFirst].value;
+    queueFirst = (queueFirst + 1) % QUEUE_LENGTH;
+    queueSize--;
+
+    EEAR = address;
+    EECR |= bit(EERE);
+    if (EEDR == value)
+      continue; // Skipping unchanged bytes saves both time and wear
+
+    EEDR = value;
+    // Timed sequence: EEMPE then EEPE within 4 cycles, interrupts are already disabled here
+    EECR |= bit(EEMPE);
+    EECR |= bit(EEPE);
+    return;
+  }
+  EECR &= ~bit(EERIE);
+}
+
+// Queues one byte, waiting for room if the queue is full
+static void queueWrite(uint16_t address, uint8_t value)
+{
+  while (queueSize == QUEUE_LENGTH)
+    ;
+
+  noInterrupts();
+  uint8_t last = (queueFirst + queueSize) % QUEUE_LENGTH;
+  queue[last].address = address;
+  queue[last].value = value;
+  queueSize++;
+  EECR |= bit(EERIE); // Fires as soon as the EEPROM is ready
+  interrupts();
+}
+
+static uint16_t recordAddress(uint16_t record)
+{
+  return STORE_ADDR + record * STORE_RECORD_LENGTH;
+}
+
+static void readRecord(uint16_t record, TelemetryReading *reading)
+{
+  EEPROM.get(recordAddress(record), *reading);
+}
+
+static uint8_t readStatus(uint16_t record)
+{
+  return EEPROM.read(recordAddress(record) + STATUS_OFFSET);
+}
+
+uint32_t storeInit()
+{
+  // The newest record is the one with the highest sequence number, the next one is the head
+  bool found = false;
+  for (uint16_t i = 0; i < STORE_RECORDS; i++)
+  {
+    if (readStatus(i) == STORE_EMPTY)
+      continue;
+    uint32_t sequence;
+    EEPROM.get(recordAddress(i) + offsetof(TelemetryReading, sequence), sequence);
+    if (!found || (int32_t)(sequence - storeBootSequence) > 0)
+    {
+      storeBootSequence = sequence;
+      storeHead = (i + 1) % STORE_RECORDS;
+      found = true;
+    }
+  }
+  return storeBootSequence;
+}
+
+void storeAppend(const TelemetryReading *reading)
+{
+  uint16_t address = recordAddress(storeHead);
+  const uint8_t *bytes = (const uint8_t *)reading;
+
+  queueWrite(address + STATUS_OFFSET, STORE_EMPTY);
+  for (uint8_t i = 0; i < sizeof(TelemetryReading); i++)
+    queueWrite(address + i, bytes[i]);
+  queueWrite(address + STATUS_OFFSET, STORE_PENDING);
+
+  storeHead = (storeHead + 1) % STORE_RECORDS;
+}
+
+void storeAck(uint32_t sequence)
+{
+  storeFlush(); // So the records read below are up to date
+  for (uint16_t i = 0; i < STORE_RECORDS; i++)
+  {
+    if (readStatus(i) != STORE_PENDING)
+      continue;
+    TelemetryReading reading;
+    readRecord(i, &reading);
+    if (reading.sequence == sequence)
+    {
+      queueWrite(recordAddress(i) + STATUS_OFFSET, STORE_ACKED);
+      return;
+    }
+  }
+}
+
+bool storeNextPending(uint16_t *cursor, TelemetryReading *reading)
+{
+  storeFlush();
+  // Oldest first: from the head round to the record before it
+  while (*cursor < STORE_RECORDS)
+  {
+    uint16_t record = (storeHead + (*cursor)++) % STORE_RECORDS;
+    if (readStatus(record) != STORE_PENDING)
+      continue;
+    readRecord(record, reading);
+    // Taken before the reset: its time is on a clock that restarted
+    reading->timeUnknown = (int32_t)(reading->sequence - storeBootSequence) <= 0;
+    if (reading->timeUnknown)
+      reading->time = 0;
+    return true;
+  }
+  return false;
+}
+
+void storeFlush()
+{
+  while (queueSize > 0 || (EECR & bit(EEPE)))
+    ;
+}
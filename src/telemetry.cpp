@@ -0,0 +1,304 @@
+/*
+  Compact binary telemetry frames sent over LoRa, and their schema
+
+  Also built on the gateway by tools/telemetry_decode.cpp, so it must not depend on Arduino.
+
+  Copyright: desplega.com
+*/
+
+#include <RHCRC.h>
+#include "telemetry.h"
+
+const TelemetryField telemetrySchema[] PROGMEM = {
+  {"", TELEMETRY_VARINT, offsetof(TelemetryReading, sequence)},
+  {"t0", TELEMETRY_FIXED16, offsetof(TelemetryReading, temperature[0])},
+  {"t1", TELEMETRY_FIXED16, offsetof(TelemetryReading, temperature[1])},
+  {"h", TELEMETRY_FLAG, offsetof(TelemetryReading, harp)},
+  {"l", TELEMETRY_FLAG, offsetof(TelemetryReading, led)},
+  {"", TELEMETRY_FLAG, offsetof(TelemetryReading, timeUnknown)}, // Shares the flag byte, ignored by older decoders
+#if TELEMETRY_ENERGY
+  {"e", TELEMETRY_VARINT, offsetof(TelemetryReading, energy)},
+#endif
+};
+
+const uint8_t telemetrySchemaLength = sizeof(telemetrySchema) / sizeof(telemetrySchema[0]);
+
+void telemetryGetField(uint8_t index, TelemetryField *field)
+{
+  memcpy_P(field, &telemetrySchema[index], sizeof(TelemetryField));
+}
+
+// Appends an unsigned LEB128 varint
+static uint8_t putVarint(uint8_t *frame, uint8_t length, uint32_t value)
+{
+  while (value > 0x7f)
+  {
+    frame[length++] = (uint8_t)value | 0x80;
+    value >>= 7;
+  }
+  frame[length++] = (uint8_t)value;
+  return length;
+}
+
+// Reads an unsigned LEB128 varint. Returns false if it runs past length
+static bool getVarint(const uint8_t *frame, uint8_t length, uint8_t *index, uint32_t *value)
+{
+  uint8_t shift = 0;
+  *value = 0;
+  do
+  {
+    if (*index >= length || shift > 28)
+      return false;
+    *value |= (uint32_t)(frame[*index] & 0x7f) << shift;
+    shift += 7;
+  } while (frame[(*index)++] & 0x80);
+  return true;
+}
+
+// Zigzag encoding maps small negative and positive differences to small varints
+static uint32_t zigzag(int32_t value)
+{
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value)
+{
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+// Appends the fields of a reading, or their differences from previous if it is not NULL
+static uint8_t encodeFields(const TelemetryReading *reading, const TelemetryReading *previous, uint8_t *frame, uint8_t length)
+{
+  const uint8_t *src = (const uint8_t *)reading;
+  const uint8_t *prev = (const uint8_t *)previous;
+  uint8_t flagByte = 0; // Index in frame of the byte flags are being packed into
+  uint8_t flagBit = 0;  // Mask of the next flag bit, 0 if a new flag byte is needed
+
+  for (uint8_t i = 0; i < telemetrySchemaLength; i++)
+  {
+    TelemetryField field;
+    telemetryGetField(i, &field);
+    if (field.type != TELEMETRY_FLAG)
+      flagBit = 0;
+
+    switch (field.type)
+    {
+    case TELEMETRY_VARINT:
+    {
+      uint32_t value, base;
+      memcpy(&value, src + field.offset, sizeof(value));
+      if (prev)
+      {
+        memcpy(&base, prev + field.offset, sizeof(base));
+        value = zigzag((int32_t)(value - base));
+      }
+      length = putVarint(frame, length, value);
+      break;
+    }
+    case TELEMETRY_FIXED16:
+    {
+      int16_t value, base;
+      memcpy(&value, src + field.offset, sizeof(value));
+      if (prev)
+      {
+        memcpy(&base, prev + field.offset, sizeof(base));
+        length = putVarint(frame, length, zigzag((int32_t)value - base));
+      }
+      else
+      {
+        frame[length++] = (uint8_t)value;
+        frame[length++] = (uint8_t)((uint16_t)value >> 8);
+      }
+      break;
+    }
+    case TELEMETRY_FLAG:
+      if (flagBit == 0)
+      {
+        flagByte = length;
+        frame[length++] = 0;
+        flagBit = 1;
+      }
+      if (src[field.offset])
+        frame[flagByte] |= flagBit;
+      flagBit <<= 1;
+      break;
+    }
+  }
+  return length;
+}
+
+// Reads the fields of a reading, or their differences from previous if it is not NULL.
+// Returns false if they run past length
+static bool decodeFields(const uint8_t *frame, uint8_t length, uint8_t *index, TelemetryReading *reading, const TelemetryReading *previous)
+{
+  uint8_t *dst = (uint8_t *)reading;
+  const uint8_t *prev = (const uint8_t *)previous;
+  uint8_t flagBit = 0;
+  uint8_t flags = 0;
+
+  memset(reading, 0, sizeof(TelemetryReading));
+  for (uint8_t i = 0; i < telemetrySchemaLength; i++)
+  {
+    TelemetryField field;
+    telemetryGetField(i, &field);
+    if (field.type != TELEMETRY_FLAG)
+      flagBit = 0;
+
+    switch (field.type)
+    {
+    case TELEMETRY_VARINT:
+    {
+      uint32_t value, base;
+      if (!getVarint(frame, length, index, &value))
+        return false;
+      if (prev)
+      {
+        memcpy(&base, prev + field.offset, sizeof(base));
+        value = base + (uint32_t)unzigzag(value);
+      }
+      memcpy(dst + field.offset, &value, sizeof(value));
+      break;
+    }
+    case TELEMETRY_FIXED16:
+    {
+      int16_t value;
+      if (prev)
+      {
+        uint32_t delta;
+        int16_t base;
+        if (!getVarint(frame, length, index, &delta))
+          return false;
+        memcpy(&base, prev + field.offset, sizeof(base));
+        value = (int16_t)(base + unzigzag(delta));
+      }
+      else
+      {
+        if (*index + 2 > length)
+          return false;
+        value = (int16_t)(frame[*index] | ((uint16_t)frame[*index + 1] << 8));
+        *index += 2;
+      }
+      memcpy(dst + field.offset, &value, sizeof(value));
+      break;
+    }
+    case TELEMETRY_FLAG:
+      if (flagBit == 0)
+      {
+        if (*index >= length)
+          return false;
+        flags = frame[(*index)++];
+        flagBit = 1;
+      }
+      dst[field.offset] = (flags & flagBit) ? 1 : 0;
+      flagBit <<= 1;
+      break;
+    }
+  }
+  return true;
+}
+
+// Appends the CRC of the frame so far
+static uint8_t putCRC(uint8_t *frame, uint8_t length)
+{
+  uint16_t crc = CRC16(frame, length);
+  frame[length++] = (uint8_t)crc;
+  frame[length++] = (uint8_t)(crc >> 8);
+  return length;
+}
+
+// Checks the version and CRC of a frame and returns its length without the CRC, 0 if invalid
+static uint8_t checkFrame(const uint8_t *frame, uint8_t length, uint8_t version)
+{
+  if (length < 1 + DEVICE_ID_LENGTH + 2 || frame[0] != version)
+    return 0;
+  length -= 2;
+  if (CRC16(frame, length) != (frame[length] | ((uint16_t)frame[length + 1] << 8)))
+    return 0;
+  return length;
+}
+
+uint8_t telemetryEncode(const TelemetryReading *reading, const char *deviceID, uint8_t *frame)
+{
+  uint8_t length = 0;
+  frame[length++] = TELEMETRY_VERSION;
+  memcpy(frame + length, deviceID, DEVICE_ID_LENGTH);
+  length += DEVICE_ID_LENGTH;
+  length = encodeFields(reading, NULL, frame, length);
+  return putCRC(frame, length);
+}
+
+uint8_t telemetryEncodeBatch(const TelemetryReading *const *readings, uint8_t count, uint32_t now,
+                             const char *deviceID, uint8_t *frame, uint8_t size, uint8_t *encoded)
+{
+  uint8_t length = 0;
+  uint8_t i;
+  frame[length++] = TELEMETRY_BATCH_VERSION;
+  memcpy(frame + length, deviceID, DEVICE_ID_LENGTH);
+  length += DEVICE_ID_LENGTH;
+  uint8_t countIndex = length++;
+
+  uint32_t previousAge = 0;
+  for (i = 0; i < count; i++)
+  {
+    // Stop when the worst case of this reading plus the CRC would not fit
+    if (length + TELEMETRY_MAX_BATCH_READING_LENGTH + 2 > size)
+      break;
+    uint32_t age = (now - readings[i]->time) / 1000;
+    length = putVarint(frame, length, i == 0 ? age : previousAge - age);
+    length = encodeFields(readings[i], i == 0 ? NULL : readings[i - 1], frame, length);
+    previousAge = age;
+  }
+  frame[countIndex] = i;
+  *encoded = i;
+  return putCRC(frame, length);
+}
+
+bool telemetryDecode(const uint8_t *frame, uint8_t length, char *deviceID, TelemetryReading *reading)
+{
+  length = checkFrame(frame, length, TELEMETRY_VERSION);
+  if (length == 0)
+    return false;
+
+  uint8_t index = 1;
+  memcpy(deviceID, frame + index, DEVICE_ID_LENGTH);
+  index += DEVICE_ID_LENGTH;
+  return decodeFields(frame, length, &index, reading, NULL) && index == length;
+}
+
+int telemetryDecodeBatch(const uint8_t *frame, uint8_t length, char *deviceID,
+                         TelemetryReading *readings, uint32_t *ages, uint8_t maxReadings)
+{
+  length = checkFrame(frame, length, TELEMETRY_BATCH_VERSION);
+  if (length == 0)
+    return -1;
+
+  uint8_t index = 1;
+  memcpy(deviceID, frame + index, DEVICE_ID_LENGTH);
+  index += DEVICE_ID_LENGTH;
+  if (index >= length)
+    return -1;
+  uint8_t count = frame[index++];
+  if (count > maxReadings)
+    return -1;
+
+  for (uint8_t i = 0; i < count; i++)
+  {
+    uint32_t age;
+    if (!getVarint(frame, length, &index, &age))
+      return -1;
+    ages[i] = i == 0 ? age : ages[i - 1] - age;
+    if (!decodeFields(frame, length, &index, &readings[i], i == 0 ? NULL : &readings[i - 1]))
+      return -1;
+  }
+  return index == length ? count : -1;
+}
+
+uint16_t CRC16(const uint8_t *pBuffer, uint32_t length)
+{
+  if (pBuffer == 0)
+  {
+    return 0;
+  }
+  // Table driven, shared with RadioHead
+  return RHCrcXmodem::update(0, pBuffer, length);
+}
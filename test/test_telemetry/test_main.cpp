@@ -0,0 +1,237 @@
+/*
+  Unit tests of the telemetry frames: encoding and decoding of single and batch frames, the varint and
+  zigzag encodings at their limits, and rejection of truncated or corrupted frames.
+
+  Run on the host with:
+    pio test -e native
+
+  Copyright: desplega.com
+*/
+
+#include <unity.h>
+#include <RHCRC.h>
+
+// The units under test, with their static helpers
+#include "../../src/telemetry.cpp"
+#include "../../tools/telemetry_json.cpp"
+
+#define BATCH_READINGS_TESTED 16
+
+static const char deviceID[DEVICE_ID_LENGTH] = DEVICE_ID;
+
+static TelemetryReading makeReading(uint32_t sequence, int16_t t0, int16_t t1, uint8_t harp, uint32_t time)
+{
+  TelemetryReading reading;
+  memset(&reading, 0, sizeof(reading));
+  reading.sequence = sequence;
+  reading.temperature[0] = t0;
+  reading.temperature[1] = t1;
+  reading.harp = harp;
+  reading.time = time;
+  return reading;
+}
+
+static void assertSameReading(const TelemetryReading *expected, const TelemetryReading *actual)
+{
+  TEST_ASSERT_EQUAL_UINT32(expected->sequence, actual->sequence);
+  TEST_ASSERT_EQUAL_INT16(expected->temperature[0], actual->temperature[0]);
+  TEST_ASSERT_EQUAL_INT16(expected->temperature[1], actual->temperature[1]);
+  TEST_ASSERT_EQUAL_UINT8(expected->harp, actual->harp);
+  TEST_ASSERT_EQUAL_UINT8(expected->led, actual->led);
+  TEST_ASSERT_EQUAL_UINT8(expected->timeUnknown, actual->timeUnknown);
+#if TELEMETRY_ENERGY
+  TEST_ASSERT_EQUAL_UINT32(expected->energy, actual->energy);
+#endif
+}
+
+void test_single_frame_round_trip()
+{
+  TelemetryReading reading = makeReading(0xffffffff, -32768, 32767, 1, 0);
+  reading.led = 1;
+  uint8_t frame[TELEMETRY_MAX_FRAME_LENGTH];
+  uint8_t length = telemetryEncode(&reading, deviceID, frame);
+  TEST_ASSERT_TRUE(length <= TELEMETRY_MAX_FRAME_LENGTH);
+
+  char decodedID[DEVICE_ID_LENGTH];
+  TelemetryReading decoded;
+  TEST_ASSERT_TRUE(telemetryDecode(frame, length, decodedID, &decoded));
+  TEST_ASSERT_EQUAL_MEMORY(deviceID, decodedID, DEVICE_ID_LENGTH);
+  assertSameReading(&reading, &decoded);
+}
+
+void test_batch_frame_round_trip()
+{
+  // Deltas at the limits: sequence wrapping, temperatures swinging end to end
+  TelemetryReading readings[4] = {
+    makeReading(0xfffffffe, 32767, -32768, 0, 1000),
+    makeReading(0xffffffff, -32768, 32767, 1, 601000),
+    makeReading(0, 0, 0, 0, 1201000),
+    makeReading(1, 336, 352, 1, 1801000),
+  };
+  readings[0].timeUnknown = 1;
+  const TelemetryReading *pointers[4] = {&readings[0], &readings[1], &readings[2], &readings[3]};
+  uint8_t frame[255];
+  uint8_t encoded;
+  uint8_t length = telemetryEncodeBatch(pointers, 4, 2401000, deviceID, frame, sizeof(frame), &encoded);
+  TEST_ASSERT_EQUAL_UINT8(4, encoded);
+
+  char decodedID[DEVICE_ID_LENGTH];
+  TelemetryReading decoded[4];
+  uint32_t ages[4];
+  TEST_ASSERT_EQUAL_INT(4, telemetryDecodeBatch(frame, length, decodedID, decoded, ages, 4));
+  TEST_ASSERT_EQUAL_MEMORY(deviceID, decodedID, DEVICE_ID_LENGTH);
+  for (int i = 0; i < 4; i++)
+  {
+    assertSameReading(&readings[i], &decoded[i]);
+    TEST_ASSERT_EQUAL_UINT32((2401000 - readings[i].time) / 1000, ages[i]);
+  }
+
+  // Too many readings for the caller
+  TEST_ASSERT_EQUAL_INT(-1, telemetryDecodeBatch(frame, length, decodedID, decoded, ages, 3));
+}
+
+void test_batch_frame_stops_when_full()
+{
+  TelemetryReading readings[BATCH_READINGS_TESTED];
+  const TelemetryReading *pointers[BATCH_READINGS_TESTED];
+  for (int i = 0; i < BATCH_READINGS_TESTED; i++)
+  {
+    readings[i] = makeReading(i * 1000, i * 1000, -i * 1000, i & 1, i * 600000);
+    pointers[i] = &readings[i];
+  }
+  uint8_t frame[64];
+  uint8_t encoded;
+  uint8_t length = telemetryEncodeBatch(pointers, BATCH_READINGS_TESTED, BATCH_READINGS_TESTED * 600000, deviceID,
+                                        frame, sizeof(frame), &encoded);
+  TEST_ASSERT_TRUE(length <= sizeof(frame));
+  TEST_ASSERT_TRUE(encoded > 0 && encoded < BATCH_READINGS_TESTED);
+
+  char decodedID[DEVICE_ID_LENGTH];
+  TelemetryReading decoded[BATCH_READINGS_TESTED];
+  uint32_t ages[BATCH_READINGS_TESTED];
+  TEST_ASSERT_EQUAL_INT(encoded, telemetryDecodeBatch(frame, length, decodedID, decoded, ages, BATCH_READINGS_TESTED));
+  for (int i = 0; i < encoded; i++)
+    assertSameReading(&readings[i], &decoded[i]);
+}
+
+void test_zigzag_extremes()
+{
+  TEST_ASSERT_EQUAL_UINT32(0, zigzag(0));
+  TEST_ASSERT_EQUAL_UINT32(1, zigzag(-1));
+  TEST_ASSERT_EQUAL_UINT32(2, zigzag(1));
+  TEST_ASSERT_EQUAL_UINT32(0xfffffffe, zigzag(INT32_MAX));
+  TEST_ASSERT_EQUAL_UINT32(0xffffffff, zigzag(INT32_MIN));
+  const int32_t values[] = {0, 1, -1, 63, -64, 64, INT16_MAX, INT16_MIN, INT32_MAX, INT32_MIN};
+  for (unsigned i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+    TEST_ASSERT_EQUAL_INT32(values[i], unzigzag(zigzag(values[i])));
+}
+
+void test_varint_extremes()
+{
+  const uint32_t values[] = {0, 0x7f, 0x80, 0x3fff, 0x4000, 0x0fffffff, 0x10000000, 0xffffffff};
+  const uint8_t lengths[] = {1, 1, 2, 2, 3, 4, 5, 5};
+  for (unsigned i = 0; i < sizeof(values) / sizeof(values[0]); i++)
+  {
+    uint8_t frame[5];
+    uint8_t length = putVarint(frame, 0, values[i]);
+    TEST_ASSERT_EQUAL_UINT8(lengths[i], length);
+    uint8_t index = 0;
+    uint32_t value;
+    TEST_ASSERT_TRUE(getVarint(frame, length, &index, &value));
+    TEST_ASSERT_EQUAL_UINT32(values[i], value);
+    TEST_ASSERT_EQUAL_UINT8(length, index);
+
+    // Cut short
+    index = 0;
+    TEST_ASSERT_FALSE(getVarint(frame, length - 1, &index, &value));
+  }
+
+  // More than 5 bytes is not a uint32_t
+  const uint8_t overlong[] = {0x80, 0x80, 0x80, 0x80, 0x80, 0x00};
+  uint8_t index = 0;
+  uint32_t value;
+  TEST_ASSERT_FALSE(getVarint(overlong, sizeof(overlong), &index, &value));
+}
+
+void test_truncated_frames_are_rejected()
+{
+  TelemetryReading readings[2] = {makeReading(41, 336, 352, 1, 0), makeReading(42, 340, 350, 0, 600000)};
+  const TelemetryReading *pointers[2] = {&readings[0], &readings[1]};
+  uint8_t single[TELEMETRY_MAX_FRAME_LENGTH];
+  uint8_t singleLength = telemetryEncode(&readings[0], deviceID, single);
+  uint8_t batch[64];
+  uint8_t encoded;
+  uint8_t batchLength = telemetryEncodeBatch(pointers, 2, 600000, deviceID, batch, sizeof(batch), &encoded);
+
+  char decodedID[DEVICE_ID_LENGTH];
+  TelemetryReading decoded[2];
+  uint32_t ages[2];
+  for (uint8_t length = 0; length < singleLength; length++)
+  {
+    TEST_ASSERT_FALSE(telemetryDecode(single, length, decodedID, decoded));
+    TEST_ASSERT_EQUAL_INT(-1, telemetryDecodeFrame(single, length, decodedID, decoded, ages, 2));
+  }
+  for (uint8_t length = 0; length < batchLength; length++)
+  {
+    TEST_ASSERT_EQUAL_INT(-1, telemetryDecodeBatch(batch, length, decodedID, decoded, ages, 2));
+    TEST_ASSERT_EQUAL_INT(-1, telemetryDecodeFrame(batch, length, decodedID, decoded, ages, 2));
+  }
+}
+
+void test_corrupted_frames_are_rejected()
+{
+  TelemetryReading readings[2] = {makeReading(41, 336, 352, 1, 0), makeReading(42, 340, 350, 0, 600000)};
+  const TelemetryReading *pointers[2] = {&readings[0], &readings[1]};
+  uint8_t single[TELEMETRY_MAX_FRAME_LENGTH];
+  uint8_t singleLength = telemetryEncode(&readings[0], deviceID, single);
+  uint8_t batch[64];
+  uint8_t encoded;
+  uint8_t batchLength = telemetryEncodeBatch(pointers, 2, 600000, deviceID, batch, sizeof(batch), &encoded);
+
+  // Every single bit error, in the payload or in the CRC, is caught
+  char decodedID[DEVICE_ID_LENGTH];
+  TelemetryReading decoded[2];
+  uint32_t ages[2];
+  for (uint8_t i = 0; i < singleLength * 8; i++)
+  {
+    single[i / 8] ^= 1 << (i % 8);
+    TEST_ASSERT_EQUAL_INT(-1, telemetryDecodeFrame(single, singleLength, decodedID, decoded, ages, 2));
+    single[i / 8] ^= 1 << (i % 8);
+  }
+  for (uint16_t i = 0; i < batchLength * 8; i++)
+  {
+    batch[i / 8] ^= 1 << (i % 8);
+    TEST_ASSERT_EQUAL_INT(-1, telemetryDecodeFrame(batch, batchLength, decodedID, decoded, ages, 2));
+    batch[i / 8] ^= 1 << (i % 8);
+  }
+  TEST_ASSERT_EQUAL_INT(1, telemetryDecodeFrame(single, singleLength, decodedID, decoded, ages, 2));
+  TEST_ASSERT_EQUAL_INT(2, telemetryDecodeFrame(batch, batchLength, decodedID, decoded, ages, 2));
+}
+
+void test_json_leaves_out_unknown_time()
+{
+  TelemetryReading reading = makeReading(7, 344, 0, 1, 0);
+  char json[TELEMETRY_MAX_JSON_LENGTH];
+  telemetryFormatJson(json, sizeof(json), deviceID, &reading, 1572800000);
+  TEST_ASSERT_NOT_NULL(strstr(json, "\"timestamp\":1572800000"));
+  reading.timeUnknown = 1;
+  telemetryFormatJson(json, sizeof(json), deviceID, &reading, 1572800000);
+  TEST_ASSERT_NULL(strstr(json, "timestamp"));
+#if !TELEMETRY_ENERGY
+  TEST_ASSERT_EQUAL_STRING("{\"number\":\"191103181200\",\"data\":{\"t0\":\"21.50\",\"t1\":\"0.00\",\"h\":\"1\",\"l\":\"0\"}}", json);
+#endif
+}
+
+int main()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_single_frame_round_trip);
+  RUN_TEST(test_batch_frame_round_trip);
+  RUN_TEST(test_batch_frame_stops_when_full);
+  RUN_TEST(test_zigzag_extremes);
+  RUN_TEST(test_varint_extremes);
+  RUN_TEST(test_truncated_frames_are_rejected);
+  RUN_TEST(test_corrupted_frames_are_rejected);
+  RUN_TEST(test_json_leaves_out_unknown_time);
+  return UNITY_END();
+}
@@ -0,0 +1,903 @@
+/*
+  Gateway daemon for Linux (Raspberry Pi): receives the telemetry frames of the nodes on several radios at
+  once, and publishes every reading, as the JSON of tools/telemetry_decode.cpp, to an MQTT broker (or
+  to stdout without one). Valid frames are acknowledged on the radio they came from (see include/store.h)
+  once the broker has acknowledged their readings, which are published with QoS 1 (or once they are written
+  to stdout), so a node keeps in its store what did not reach the broker.
+  On an RH_RF95, the ACKs also carry adaptive data rate commands (see RHAdrServer in RHAdr.h): from the SNR
+  of the frames of a node, the lowest transmitter power it can use, which the node applies and reports in
+  the ID header of its next frames. Nodes that don't report their settings are left alone.
+
+  Each radio is run by its own thread, which sleeps on the event file descriptor of its driver (the DIO0
+  interrupt of an RH_RF95, the port of an RH_Serial) and hands the packets it receives to the forward
+  thread through a single producer, single consumer queue without locks. The forward thread decodes them,
+  drops repeated readings, publishes, and hands the ACKs back through a second queue per radio once the
+  broker has sent the PUBACK of their last reading. So ingest scales with the number of radios, and
+  decoding and publishing never delay a radio: its packets only wait in the driver (an RH_RF95 queues
+  RH_RF95_RX_QUEUE_LENGTH of them, an RH_Serial leaves them in the port) when its queue is full.
+
+  Radios are given as arguments:
+    rf95:SPIDEV:IRQ:MHZ[:SF[:BW]]  RH_RF95 on a spidev device, with DIO0 on BCM GPIO IRQ, and the spreading
+                                   factor (7 by default) and bandwidth in kHz (125 by default) of the nodes,
+                                   eg rf95:/dev/spidev0.0:25:868.1:9
+    serial:DEVICE[:BAUD]           RH_Serial (9600 baud by default), eg serial:/dev/ttyUSB0
+  At most RH_RF95_NUM_INTERRUPTS (8) of them RH_RF95.
+
+  Options:
+    -m HOST[:PORT]  MQTT broker to publish to (port 1883 by default), eg mosquitto run on the gateway
+    -T TOPIC        Topic to publish to, api-engine by default
+    -t              Add "timestamp" to every reading, as telemetry_decode -t
+    -s SECONDS      Print the statistics of every radio to stderr each SECONDS (60 by default, 0 never)
+  SIGINT and SIGTERM stop the gateway, which prints the statistics of the whole run.
+
+  Build on the gateway from the repository root with:
+    RH=lib/RadioHead-master
+    g++ -O2 -pthread -DRASPBERRY_PI -DBCM2835_NO_DELAY_COMPATIBILITY -I include -I $RH -I $RH/RHutil \
+      tools/gateway.cpp tools/telemetry_json.cpp src/telemetry.cpp $RH/RH_RF95.cpp $RH/RH_Serial.cpp $RH/RHAdr.cpp \
+      $RH/RHSPIDriver.cpp $RH/RHGenericSPI.cpp $RH/RHGenericDriver.cpp $RH/RHClock.cpp $RH/RHCRC.cpp \
+      $RH/RHutil/RasPi.cpp $RH/RHutil/RHLinuxGpio.cpp $RH/RHutil/RHLinuxSPI.cpp $RH/RHutil/HardwareSerial.cpp \
+      -lbcm2835 -o gateway
+  adding -DTELEMETRY_ENERGY=1 if the nodes are built with it.
+
+  Copyright: desplega.com
+*/
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+// After the system headers: RadioHead.h defines htons() and friends
+#include <RH_RF95.h>
+#include <RH_Serial.h>
+#include <RHAdr.h>
+#include <RHutil/HardwareSerial.h>
+#include <RHutil/RHLinuxSPI.h>
+
+#include "telemetry_json.h"
+
+// Most radios
+#define MAX_RADIOS 16
+
+// Packets a radio can hold for the forward thread, and ACKs the forward thread can hold for a radio,
+// queued or waiting for the broker. The forward thread takes no more packets from a radio than it can hold ACKs for
+#define PACKET_QUEUE_SIZE 256
+#define ACK_QUEUE_SIZE 64
+
+// ACK downlink, as STORE_ACK_COMMAND and STORE_ACK_LEN in include/store.h (which needs Arduino.h)
+#define ACK_COMMAND 'K'
+#define ACK_LENGTH 3
+
+// Bytes of MQTT packets or JSON lines buffered between two writes
+#define SINK_BUFFER_SIZE 65536
+
+// MQTT keep alive in seconds, and the time between two attempts to reach the broker
+#define MQTT_KEEP_ALIVE 60
+#define MQTT_RETRY_SECONDS 5
+
+// Single producer, single consumer queue without locks. The producer fills the slot returned by back()
+// and publishes it with push(). The consumer reads the slot returned by front() and frees it with pop().
+// Each index is only written by one side, which publishes it with release ordering, so the other side
+// sees the slot contents once it loads the index with acquire ordering.
+template <typename T, uint32_t SIZE>
+class SpscQueue
+{
+public:
+  SpscQueue() : head(0), tail(0) {}
+
+  // Producer: the slot to fill, NULL if the queue is full
+  T *back()
+  {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    return t - head.load(std::memory_order_acquire) == SIZE ? NULL : &slots[t % SIZE];
+  }
+
+  // Producer: hands the slot returned by back() to the consumer
+  void push() { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+  // Producer: the number of slots back() can return before the consumer frees one
+  uint32_t space() { return SIZE - (tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire)); }
+
+  // Consumer: the oldest slot, NULL if the queue is empty
+  T *front()
+  {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    return h == tail.load(std::memory_order_acquire) ? NULL : &slots[h % SIZE];
+  }
+
+  // Consumer: hands the slot returned by front() back to the producer
+  void pop() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+private:
+  static_assert((SIZE & (SIZE - 1)) == 0, "SIZE must be a power of 2");
+
+  // On their own cache lines, so the two threads don't invalidate each other's
+  alignas(64) std::atomic<uint32_t> head; // Next slot to read, written by the consumer
+  alignas(64) std::atomic<uint32_t> tail; // Next slot to write, written by the producer
+  alignas(64) T slots[SIZE];
+};
+
+struct Packet
+{
+  uint8_t from;   // RadioHead headers
+  uint8_t id;     // Echoed in the ACK. The ADR settings of the node (RH_ADR_SETTINGS), 0 if it does not report them
+  uint8_t flags;
+  uint8_t length;
+  int16_t rssi;   // dBm
+  int8_t snr;     // 0.25 dB, RH_RF95 only
+  uint8_t data[RH_RF95_MAX_MESSAGE_LEN];
+};
+
+struct Ack
+{
+  uint8_t to;     // The node, and what the radio thread needs for ADR
+  uint8_t id;
+  uint8_t flags;
+  int8_t snr;
+  uint8_t data[ACK_LENGTH + RH_ADR_COMMAND_LEN]; // The ACK, then room for an ADR command
+};
+
+// An ACK the forward thread holds until the broker has acknowledged the readings of its frame
+struct PendingAck
+{
+  Ack ack;
+  uint32_t published; // Sink::publishedCount() after the readings of the frame
+  uint32_t lost;      // Sink::lostCount() before they were published: if it changes, they may never arrive
+  uint32_t readings;  // Readings of the frame that were published, the others being duplicates
+};
+
+struct Radio
+{
+  const char *spec;
+  RHGenericDriver *driver;
+  RH_RF95 *rf95;          // The driver, if an RH_RF95
+  RHAdrServer adr;        // ADR of the nodes heard by an RH_RF95, only used by the radio thread
+  float frequency;        // MHz
+  int8_t spreadingFactor;
+  long bandwidth;         // Hz
+  HardwareSerial *port;   // The port, if an RH_Serial
+  int baud;
+  int wakeFd;             // eventfd that wakes the radio thread for ACKs and to stop
+  std::thread thread;
+  std::atomic<bool> running;
+
+  SpscQueue<Packet, PACKET_QUEUE_SIZE> packets; // To the forward thread
+  SpscQueue<Ack, ACK_QUEUE_SIZE> acks;          // From the forward thread
+
+  // Counted by the radio thread
+  std::atomic<uint32_t> received;
+  std::atomic<uint32_t> bytes;
+  std::atomic<uint32_t> full;     // Times the packet queue filled up. An RH_RF95 loses the packets that arrive then
+  std::atomic<uint32_t> acked;
+  std::atomic<uint32_t> commands; // ADR commands sent with the ACKs
+  std::atomic<int> rssi;          // Of the last packet
+
+  // Counted by the forward thread
+  uint32_t frames;       // Valid frames
+  uint32_t invalid;
+  uint32_t unforwarded;  // Frames not forwarded: the broker was not connected, or did not get them
+  uint32_t duplicates;   // Readings
+  uint32_t readings;     // Readings published, and acknowledged by the broker
+  uint32_t lastReceived; // received at the last statistics
+
+  // ACKs waiting for the broker, oldest first. Only used by the forward thread
+  PendingAck pending[ACK_QUEUE_SIZE];
+  int numPending;
+};
+
+static Radio radios[MAX_RADIOS];
+static int numRadios = 0;
+
+// Wakes the forward thread when packets are queued, or to stop
+static int forwardWakeFd = -1;
+
+static std::atomic<bool> stopping(false);
+
+// Serialises RH_RF95::init(), which allocates the interrupt of the driver
+static std::mutex initMutex;
+
+static bool timestamps = false;
+
+static void wake(int fd)
+{
+  uint64_t one = 1;
+  if (write(fd, &one, sizeof(one)) < 0)
+  {
+    // Only fails when the counter is about to overflow, and then the thread is woken anyway
+  }
+}
+
+static void drainWake(int fd)
+{
+  uint64_t count;
+  if (read(fd, &count, sizeof(count)) < 0)
+  {
+    // Nothing to drain
+  }
+}
+
+static void onSignal(int)
+{
+  stopping = true;
+  wake(forwardWakeFd);
+  for (int i = 0; i < numRadios; i++)
+    wake(radios[i].wakeFd);
+}
+
+// Where the readings go: an MQTT broker, or stdout (one JSON object per line) when there is none.
+// Readings are counted as they are published, then as they are acknowledged: by the PUBACK of the broker,
+// which acknowledges QoS 1 publications in order, or once written to stdout. When the connection is lost
+// (or stdout fails) before that, the readings are counted as lost instead. Only used by the forward thread
+class Sink
+{
+public:
+  Sink()
+    : host(NULL), port("1883"), topic("api-engine"), sock(-1), retryAt(0), lastWrite(0), length(0), inputLength(0),
+      published(0), acknowledged(0), lost(0), nextId(1), acknowledgedId(1)
+  {
+  }
+
+  void configure(char *broker, const char *mqttTopic)
+  {
+    if (broker)
+    {
+      char *colon = strrchr(broker, ':');
+      if (colon)
+      {
+        *colon = 0;
+        port = colon + 1;
+      }
+      host = broker;
+    }
+    if (mqttTopic)
+      topic = mqttTopic;
+  }
+
+  // Returns true if published readings can be delivered, connecting to the broker if it is time to try
+  bool ready(time_t now)
+  {
+    if (!host)
+      return true;
+    if (sock < 0 && now >= retryAt)
+    {
+      retryAt = now + MQTT_RETRY_SECONDS;
+      connectBroker();
+    }
+    return sock >= 0;
+  }
+
+  // The socket to wait on for data from the broker, -1 if none
+  int fd() { return sock; }
+
+  void publish(const char *json, int jsonLength)
+  {
+    if (host)
+    {
+      size_t topicLength = strlen(topic);
+      size_t remaining = 2 + topicLength + 2 + jsonLength;
+      if (length + 5 + remaining > sizeof(buffer))
+        flush();
+      if (length + 5 + remaining > sizeof(buffer))
+        return;
+      buffer[length++] = 0x32; // PUBLISH, QoS 1
+      length += encodeLength(buffer + length, remaining);
+      buffer[length++] = topicLength >> 8;
+      buffer[length++] = topicLength & 0xff;
+      memcpy(buffer + length, topic, topicLength);
+      length += topicLength;
+      // Packet identifiers run from 1 to 65535
+      buffer[length++] = nextId >> 8;
+      buffer[length++] = nextId & 0xff;
+      nextId = nextId % 0xffff + 1;
+    }
+    else if (length + jsonLength + 1 > sizeof(buffer))
+    {
+      flush();
+    }
+    memcpy(buffer + length, json, jsonLength);
+    length += jsonLength;
+    if (!host)
+      buffer[length++] = '\n';
+    published++;
+  }
+
+  // Writes what was published since the last call. Returns false if it could not be delivered, which
+  // loses it
+  bool flush()
+  {
+    if (length == 0)
+      return true;
+    bool delivered;
+    if (host)
+    {
+      delivered = writeAll(buffer, length);
+      if (!delivered)
+        disconnect();
+    }
+    else
+    {
+      delivered = fwrite(buffer, 1, length, stdout) == length && fflush(stdout) == 0;
+      if (delivered)
+        acknowledged = published;
+      else
+        loseUnacknowledged();
+    }
+    length = 0;
+    return delivered;
+  }
+
+  // Reads what the broker sends: PUBACKs, and PINGRESPs which are ignored. Notices when it goes away
+  void receive()
+  {
+    ssize_t got = read(sock, input + inputLength, sizeof(input) - inputLength);
+    if (got == 0 || (got < 0 && errno != EAGAIN && errno != EINTR))
+    {
+      fprintf(stderr, "gateway: lost the MQTT broker\n");
+      disconnect();
+      return;
+    }
+    if (got < 0)
+      return;
+    inputLength += got;
+
+    // Neither has more than 127 bytes of remaining length, which is then a single byte
+    size_t used = 0;
+    while (inputLength - used >= 2 && inputLength - used >= 2u + input[used + 1])
+    {
+      if (input[used + 1] & 0x80)
+      {
+        fprintf(stderr, "gateway: unexpected packet from the MQTT broker\n");
+        disconnect();
+        return;
+      }
+      if (input[used] == 0x40 && input[used + 1] == 2)
+        acknowledge((input[used + 2] << 8) | input[used + 3]);
+      used += 2 + input[used + 1];
+    }
+    inputLength -= used;
+    memmove(input, input + used, inputLength);
+  }
+
+  // Sends a PINGREQ when nothing was sent for half the keep alive
+  void keepAlive(time_t now)
+  {
+    static const uint8_t pingreq[] = {0xc0, 0x00};
+    if (sock >= 0 && now - lastWrite >= MQTT_KEEP_ALIVE / 2 && !writeAll(pingreq, sizeof(pingreq)))
+      disconnect();
+  }
+
+  void close()
+  {
+    static const uint8_t disconnectPacket[] = {0xe0, 0x00};
+    flush();
+    if (sock >= 0)
+      writeAll(disconnectPacket, sizeof(disconnectPacket));
+    disconnect();
+  }
+
+  const char *name() { return host ? host : "stdout"; }
+
+  bool connected() { return !host || sock >= 0; }
+
+  uint32_t publishedCount() { return published; }
+
+  uint32_t acknowledgedCount() { return acknowledged; }
+
+  uint32_t lostCount() { return lost; }
+
+private:
+  // A PUBACK also acknowledges the publications before its own
+  void acknowledge(uint16_t id)
+  {
+    uint32_t ahead = (id + 0xffff - acknowledgedId) % 0xffff;
+    if (id == 0 || ahead >= published - acknowledged)
+      return; // Not in flight
+    acknowledged += ahead + 1;
+    acknowledgedId = id % 0xffff + 1;
+  }
+
+  // What was published and not acknowledged will never be
+  void loseUnacknowledged()
+  {
+    if (acknowledged != published)
+      lost++;
+    acknowledged = published;
+    acknowledgedId = nextId;
+  }
+
+  // MQTT variable length encoding. Returns the number of bytes
+  static int encodeLength(uint8_t *dest, size_t value)
+  {
+    int n = 0;
+    do
+    {
+      dest[n] = value & 0x7f;
+      value >>= 7;
+      if (value)
+        dest[n] |= 0x80;
+      n++;
+    } while (value);
+    return n;
+  }
+
+  bool writeAll(const uint8_t *data, size_t size)
+  {
+    while (size)
+    {
+      ssize_t written = send(sock, data, size, MSG_NOSIGNAL);
+      if (written < 0 && errno == EINTR)
+        continue;
+      if (written <= 0)
+      {
+        fprintf(stderr, "gateway: could not write to the MQTT broker: %s\n", strerror(errno));
+        return false;
+      }
+      data += written;
+      size -= written;
+    }
+    lastWrite = time(NULL);
+    return true;
+  }
+
+  void connectBroker()
+  {
+    struct addrinfo hints, *addresses;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_socktype = SOCK_STREAM;
+    int error = getaddrinfo(host, port, &hints, &addresses);
+    if (error)
+    {
+      fprintf(stderr, "gateway: could not resolve %s: %s\n", host, gai_strerror(error));
+      return;
+    }
+    for (struct addrinfo *a = addresses; a && sock < 0; a = a->ai_next)
+    {
+      sock = socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+      if (sock >= 0 && ::connect(sock, a->ai_addr, a->ai_addrlen) < 0)
+      {
+        ::close(sock);
+        sock = -1;
+      }
+    }
+    freeaddrinfo(addresses);
+    if (sock < 0)
+    {
+      fprintf(stderr, "gateway: could not connect to %s:%s\n", host, port);
+      return;
+    }
+
+    // CONNECT with a clean session, then wait for CONNACK
+    char clientID[32];
+    int clientIDLength = snprintf(clientID, sizeof(clientID), "radiohead-gateway-%d", (int)getpid());
+    uint8_t packet[64];
+    int n = 0;
+    packet[n++] = 0x10;
+    n += encodeLength(packet + n, 10 + 2 + clientIDLength);
+    static const uint8_t header[] = {0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04, 0x02, MQTT_KEEP_ALIVE >> 8, MQTT_KEEP_ALIVE & 0xff};
+    memcpy(packet + n, header, sizeof(header));
+    n += sizeof(header);
+    packet[n++] = clientIDLength >> 8;
+    packet[n++] = clientIDLength & 0xff;
+    memcpy(packet + n, clientID, clientIDLength);
+    n += clientIDLength;
+    uint8_t connack[4];
+    struct pollfd p = {sock, POLLIN, 0};
+    if (!writeAll(packet, n) || poll(&p, 1, 5000) <= 0 || recv(sock, connack, sizeof(connack), MSG_WAITALL) != sizeof(connack)
+        || connack[0] != 0x20 || connack[3] != 0)
+    {
+      fprintf(stderr, "gateway: %s:%s refused the MQTT connection\n", host, port);
+      disconnect();
+      return;
+    }
+    fprintf(stderr, "gateway: connected to %s:%s\n", host, port);
+  }
+
+  void disconnect()
+  {
+    if (sock >= 0)
+      ::close(sock);
+    sock = -1;
+    length = 0;
+    inputLength = 0;
+    loseUnacknowledged();
+  }
+
+  const char *host; // NULL for stdout
+  const char *port;
+  const char *topic;
+  int sock;
+  time_t retryAt;
+  time_t lastWrite;
+  uint8_t buffer[SINK_BUFFER_SIZE];
+  size_t length;
+  uint8_t input[256]; // Received from the broker, up to an incomplete packet
+  size_t inputLength;
+  uint32_t published;
+  uint32_t acknowledged;
+  uint32_t lost;           // Times readings were lost
+  uint16_t nextId;         // Packet identifier of the next publication
+  uint16_t acknowledgedId; // Packet identifier of the oldest publication in flight
+};
+
+static Sink sink;
+
+static bool initRadio(Radio *radio)
+{
+  std::lock_guard<std::mutex> lock(initMutex);
+  if (radio->port)
+    radio->port->begin(radio->baud);
+  if (!radio->driver->init() || radio->driver->eventFd() < 0)
+    return false;
+  if (radio->rf95)
+  {
+    if (!radio->rf95->setFrequency(radio->frequency))
+      return false;
+    radio->rf95->setSpreadingFactor(radio->spreadingFactor);
+    radio->rf95->setSignalBandwidth(radio->bandwidth);
+    // The radio only demodulates its own spreading factor, so ADR only controls the power
+    radio->adr = RHAdrServer(radio->spreadingFactor, radio->spreadingFactor, 5, 20, radio->spreadingFactor, 13);
+  }
+  // Each ACK is addressed to the node that sent the frame, which matches it to the frame by its CRC
+  radio->driver->setHeaderFrom(0);
+  radio->driver->setHeaderTo(RH_BROADCAST_ADDRESS);
+  radio->driver->setHeaderFlags(0, 0xff);
+  return true;
+}
+
+// Body of the thread of a radio. The driver is only used from here
+static void runRadio(Radio *radio)
+{
+  if (!initRadio(radio))
+  {
+    fprintf(stderr, "gateway: could not initialise %s\n", radio->spec);
+    radio->running = false;
+    return;
+  }
+  fprintf(stderr, "gateway: listening on %s\n", radio->spec);
+
+  RHGenericDriver *driver = radio->driver;
+  bool full = false;
+  while (!stopping)
+  {
+    // With the queue full, packets wait in the driver (or the serial port) until the forward thread frees a slot
+    struct pollfd fds[2] = {{radio->packets.space() ? driver->eventFd() : -1, POLLIN, 0}, {radio->wakeFd, POLLIN, 0}};
+    if (poll(fds, 2, 1000) > 0 && (fds[1].revents & POLLIN))
+      drainWake(radio->wakeFd);
+
+    // Runs the interrupt handler (RH_RF95) or reads the port (RH_Serial)
+    driver->handleEvents();
+    bool queued = false;
+    Packet *packet;
+    while ((packet = radio->packets.back()) && driver->available())
+    {
+      packet->length = sizeof(packet->data);
+      if (!driver->recv(packet->data, &packet->length))
+        break;
+      packet->from = driver->headerFrom();
+      packet->id = driver->headerId();
+      packet->flags = driver->headerFlags();
+      packet->rssi = driver->lastRssi();
+      packet->snr = radio->rf95 ? radio->rf95->lastSNR() : 0;
+      radio->received++;
+      radio->bytes += packet->length;
+      radio->rssi = packet->rssi;
+      radio->packets.push();
+      queued = true;
+    }
+    // Counted once each time it fills up, not on each wake while it stays full
+    if (!packet && !full)
+      radio->full++;
+    full = !packet;
+    if (queued)
+      wake(forwardWakeFd);
+
+    // An RH_RF95 starts transmitting and returns: the TX done interrupt puts it back in receive
+    bool sent = false;
+    for (Ack *ack; (ack = radio->acks.front()); radio->acks.pop())
+    {
+      // Only valid frames are ACKed, so only they feed ADR
+      uint8_t command = 0;
+      if (radio->rf95 && ack->id)
+      {
+        radio->adr.handleUplink(ack->to, ack->snr, ack->flags, ack->id);
+        command = radio->adr.command(ack->to, ack->data + ACK_LENGTH);
+      }
+      driver->setHeaderTo(ack->to);
+      driver->setHeaderId(ack->id);
+      driver->setHeaderFlags(command ? RH_FLAGS_ADR : RH_FLAGS_NONE, 0xff);
+      if (driver->send(ack->data, ACK_LENGTH + command))
+      {
+        radio->acked++;
+        if (command)
+          radio->commands++;
+      }
+      sent = true;
+    }
+    // The forward thread may be waiting for room for ACKs
+    if (sent)
+      wake(forwardWakeFd);
+  }
+  driver->waitPacketSent(100);
+  driver->sleep();
+}
+
+// Queues the ACKs whose readings the broker has acknowledged, and drops those whose readings were lost.
+// Returns true if any was queued
+static bool releaseAcks(Radio *radio)
+{
+  int released = 0;
+  int i;
+  for (i = 0; i < radio->numPending; i++)
+  {
+    PendingAck *pending = &radio->pending[i];
+    if (pending->lost != sink.lostCount())
+    {
+      radio->unforwarded++; // No ACK, so the node will replay these readings
+    }
+    else if ((int32_t)(sink.acknowledgedCount() - pending->published) >= 0)
+    {
+      *radio->acks.back() = pending->ack;
+      radio->acks.push();
+      radio->readings += pending->readings;
+      released++;
+    }
+    else
+    {
+      break; // Neither are the ACKs after it
+    }
+  }
+  radio->numPending -= i;
+  memmove(radio->pending, radio->pending + i, radio->numPending * sizeof(PendingAck));
+  return released > 0;
+}
+
+// Decodes and publishes the frames a radio has queued, then holds their ACKs until the broker has
+// acknowledged the readings
+static void forwardPackets(Radio *radio, bool brokerReady)
+{
+  static TelemetryDuplicates duplicates;
+  static TelemetryDuplicates confirmed; // duplicates when the broker had acknowledged all the readings
+  static uint32_t lost = 0;             // sink.lostCount() when duplicates was last restored
+  static TelemetryReading readings[TELEMETRY_MAX_READINGS];
+  static uint32_t ages[TELEMETRY_MAX_READINGS];
+  uint32_t space = radio->acks.space() - radio->numPending;
+  uint32_t taken = 0;
+
+  if (sink.lostCount() != lost)
+  {
+    // The nodes will replay the readings that were lost: forget them, or they would be taken for duplicates
+    duplicates = confirmed;
+    lost = sink.lostCount();
+  }
+  else if (sink.acknowledgedCount() == sink.publishedCount())
+  {
+    confirmed = duplicates;
+  }
+
+  for (Packet *packet; taken < space && (packet = radio->packets.front()); radio->packets.pop(), taken++)
+  {
+    char deviceID[DEVICE_ID_LENGTH];
+    int count = telemetryDecodeFrame(packet->data, packet->length, deviceID, readings, ages, TELEMETRY_MAX_READINGS);
+    if (count < 0)
+    {
+      radio->invalid++;
+      continue;
+    }
+    radio->frames++;
+    // Without a broker, leave the readings to the store of the node: no ACK, and they are not
+    // remembered as seen, so they will be published when it replays them
+    if (!brokerReady)
+    {
+      radio->unforwarded++;
+      continue;
+    }
+
+    long now = (long)time(NULL);
+    uint32_t published = 0;
+    for (int i = 0; i < count; i++)
+    {
+      if (telemetryIsDuplicate(&duplicates, deviceID, readings[i].sequence))
+      {
+        radio->duplicates++; // Still ACKed: the node replays what it did not see ACKed
+        continue;
+      }
+      char json[TELEMETRY_MAX_JSON_LENGTH];
+      int length = telemetryFormatJson(json, sizeof(json), deviceID, &readings[i], timestamps ? now - (long)ages[i] : -1);
+      sink.publish(json, length < (int)sizeof(json) ? length : (int)sizeof(json) - 1);
+      published++;
+    }
+    PendingAck *pending = &radio->pending[radio->numPending++];
+    pending->published = sink.publishedCount();
+    pending->lost = lost;
+    pending->readings = published;
+    Ack *ack = &pending->ack;
+    ack->to = packet->from;
+    ack->id = packet->id;
+    ack->flags = packet->flags;
+    ack->snr = packet->snr;
+    ack->data[0] = ACK_COMMAND;
+    ack->data[1] = packet->data[packet->length - 2]; // The CRC of the frame, LSB first
+    ack->data[2] = packet->data[packet->length - 1];
+  }
+  // A failure loses the readings, and releaseAcks() then drops their ACKs
+  if (taken)
+    sink.flush();
+
+  // For the ACKs, and for a radio waiting for room in its queue
+  if (releaseAcks(radio) || taken)
+    wake(radio->wakeFd);
+}
+
+static void printStatistics(double seconds)
+{
+  for (int i = 0; i < numRadios; i++)
+  {
+    Radio *radio = &radios[i];
+    uint32_t received = radio->received;
+    fprintf(stderr, "radio %d %s: %s, %u packets (%.1f/s), %u bytes, queue full %u times, %u frames, %u invalid, %u unforwarded, "
+            "%u readings, %u duplicates, %u acked, %u ADR commands, RSSI %d dBm\n",
+            i, radio->spec, radio->running ? "running" : "stopped", received,
+            seconds > 0 ? (received - radio->lastReceived) / seconds : 0.0, (unsigned)radio->bytes,
+            (unsigned)radio->full, radio->frames, radio->invalid, radio->unforwarded, radio->readings,
+            radio->duplicates, (unsigned)radio->acked, (unsigned)radio->commands, (int)radio->rssi);
+    radio->lastReceived = received;
+  }
+  fprintf(stderr, "sink %s: %s, %u published\n", sink.name(), sink.connected() ? "connected" : "not connected",
+          sink.publishedCount());
+}
+
+// Body of the forward thread, until a signal stops the gateway
+static void runForward(int statisticsSeconds)
+{
+  uint32_t lastStatistics = RHClock::millis();
+  while (!stopping)
+  {
+    time_t now = time(NULL);
+    bool brokerReady = sink.ready(now);
+    struct pollfd fds[2] = {{forwardWakeFd, POLLIN, 0}, {sink.fd(), POLLIN, 0}};
+    if (poll(fds, 2, 1000) > 0)
+    {
+      if (fds[0].revents & POLLIN)
+        drainWake(forwardWakeFd);
+      if (fds[1].revents & (POLLIN | POLLHUP | POLLERR))
+        sink.receive();
+    }
+    for (int i = 0; i < numRadios; i++)
+      forwardPackets(&radios[i], brokerReady && sink.connected());
+    sink.keepAlive(now);
+
+    uint32_t elapsed = RHClock::millis() - lastStatistics;
+    if (statisticsSeconds && elapsed >= statisticsSeconds * 1000UL)
+    {
+      printStatistics(elapsed / 1000.0);
+      lastStatistics += elapsed;
+    }
+  }
+}
+
+// Parses a radio argument into radio. Returns false if it is invalid
+static bool parseRadio(char *spec, Radio *radio)
+{
+  radio->spec = strdup(spec);
+  char *type = strtok(spec, ":");
+  char *device = strtok(NULL, ":");
+  if (!type || !device)
+    return false;
+  if (strcmp(type, "rf95") == 0)
+  {
+    char *irq = strtok(NULL, ":");
+    char *mhz = strtok(NULL, ":");
+    char *sf = strtok(NULL, ":");
+    char *bw = strtok(NULL, ":");
+    if (!irq || !mhz)
+      return false;
+    radio->frequency = atof(mhz);
+    radio->spreadingFactor = sf ? atoi(sf) : 7;
+    radio->bandwidth = (bw ? atof(bw) : 125) * 1000;
+    RHLinuxSPI *spi = new RHLinuxSPI(device, RHGenericSPI::Frequency8MHz);
+    radio->rf95 = new RH_RF95(RH_SPI_NO_SLAVE_SELECT, atoi(irq), *spi);
+    radio->driver = radio->rf95;
+  }
+  else if (strcmp(type, "serial") == 0)
+  {
+    char *baud = strtok(NULL, ":");
+    radio->baud = baud ? atoi(baud) : 9600;
+    radio->port = new HardwareSerial(device);
+    radio->driver = new RH_Serial(*radio->port);
+  }
+  else
+  {
+    return false;
+  }
+  radio->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  return radio->wakeFd >= 0;
+}
+
+int main(int argc, char **argv)
+{
+  char *broker = NULL;
+  const char *topic = NULL;
+  int statisticsSeconds = 60;
+  int option;
+  while ((option = getopt(argc, argv, "m:T:ts:")) != -1)
+  {
+    switch (option)
+    {
+    case 'm':
+      broker = optarg;
+      break;
+    case 'T':
+      topic = optarg;
+      break;
+    case 't':
+      timestamps = true;
+      break;
+    case 's':
+      statisticsSeconds = atoi(optarg);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-m host[:port]] [-T topic] [-t] [-s seconds] rf95:spidev:irq:mhz[:sf[:bw]] | serial:device[:baud] ...\n", argv[0]);
+      return 1;
+    }
+  }
+  if (optind == argc || argc - optind > MAX_RADIOS)
+  {
+    fprintf(stderr, "%s: give 1 to %d radios\n", argv[0], MAX_RADIOS);
+    return 1;
+  }
+
+  bool anyRF95 = false;
+  for (int i = optind; i < argc; i++)
+  {
+    Radio *radio = &radios[numRadios++];
+    if (!parseRadio(argv[i], radio))
+    {
+      fprintf(stderr, "%s: invalid radio %s\n", argv[0], radio->spec);
+      return 1;
+    }
+    anyRF95 |= radio->rf95 != NULL;
+  }
+  // RH_RF95::init() sets up its interrupt pin with pinMode()
+  if (anyRF95 && !bcm2835_init())
+  {
+    fprintf(stderr, "%s: bcm2835_init failed, are you root?\n", argv[0]);
+    return 1;
+  }
+  sink.configure(broker, topic);
+
+  forwardWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = onSignal;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+  uint32_t start = RHClock::millis();
+  for (int i = 0; i < numRadios; i++)
+  {
+    radios[i].running = true;
+    radios[i].thread = std::thread(runRadio, &radios[i]);
+  }
+  runForward(statisticsSeconds);
+
+  for (int i = 0; i < numRadios; i++)
+    radios[i].thread.join();
+  for (int i = 0; i < numRadios; i++)
+    forwardPackets(&radios[i], sink.connected());
+  for (int i = 0; i < numRadios; i++)
+    radios[i].lastReceived = 0;
+  printStatistics((RHClock::millis() - start) / 1000.0);
+  sink.close();
+  return 0;
+}
@@ -0,0 +1,104 @@
+/*
+  Gateway side decoder of the binary telemetry frames sent by the node (see include/telemetry.h)
+
+  Reads one frame per line on stdin, as hex digits (spaces allowed), and writes the JSON the
+  IoT server expects on stdout, one object per reading and line:
+    {"number":"191103181200","data":{"t0":"21.50","t1":"0.00","h":"1","l":"0"}}
+  Batch frames give one line per reading, oldest first. With -t every object also gets
+  "timestamp": the Unix time the reading was taken, from the time it is decoded and its age. Readings
+  taken before the last reset of the node have none, since their age is unknown.
+  The keys of "data" come from the schema, so new fields need no change here.
+  Frames with a bad CRC, and repeats of any of the last 64 sequence numbers of a device (eg readings
+  replayed by its store-and-forward log that had arrived), are reported on stderr and dropped.
+
+  Build on the gateway (or any host) from the repository root with:
+    g++ -I include -I lib/RadioHead-master tools/telemetry_decode.cpp tools/telemetry_json.cpp src/telemetry.cpp -o telemetry_decode
+  adding -DTELEMETRY_ENERGY=1 if the nodes are built with it.
+
+  Copyright: desplega.com
+*/
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "telemetry_json.h"
+
+static TelemetryDuplicates duplicates;
+
+// Parses hex digits, ignoring anything else. Returns the number of bytes, or -1 on odd digits or overflow
+static int parseHex(const char *line, uint8_t *frame, int size)
+{
+  int length = 0;
+  int nibbles = 0;
+  for (; *line; line++)
+  {
+    if (!isxdigit((unsigned char)*line))
+      continue;
+    int value = isdigit((unsigned char)*line) ? *line - '0' : tolower((unsigned char)*line) - 'a' + 10;
+    if (nibbles % 2 == 0)
+    {
+      if (length == size)
+        return -1;
+      frame[length++] = value << 4;
+    }
+    else
+    {
+      frame[length - 1] |= value;
+    }
+    nibbles++;
+  }
+  return nibbles % 2 ? -1 : length;
+}
+
+int main(int argc, char **argv)
+{
+  bool timestamps = false;
+  int option;
+  while ((option = getopt(argc, argv, "t")) != -1)
+  {
+    if (option != 't')
+    {
+      fprintf(stderr, "usage: %s [-t] < frames\n", argv[0]);
+      return 1;
+    }
+    timestamps = true;
+  }
+
+  char line[1024];
+  while (fgets(line, sizeof(line), stdin))
+  {
+    uint8_t frame[255];
+    int length = parseHex(line, frame, sizeof(frame));
+    if (length == 0)
+      continue;
+
+    char deviceID[DEVICE_ID_LENGTH];
+    static TelemetryReading readings[TELEMETRY_MAX_READINGS];
+    static uint32_t ages[TELEMETRY_MAX_READINGS];
+    int count = length > 0 ? telemetryDecodeFrame(frame, length, deviceID, readings, ages, TELEMETRY_MAX_READINGS) : -1;
+    if (count < 0)
+    {
+      fprintf(stderr, "Dropped invalid frame: %s", line);
+      continue;
+    }
+
+    long now = (long)time(NULL);
+    for (int i = 0; i < count; i++)
+    {
+      if (telemetryIsDuplicate(&duplicates, deviceID, readings[i].sequence))
+      {
+        fprintf(stderr, "Dropped duplicate reading %lu\n", (unsigned long)readings[i].sequence);
+        continue;
+      }
+      char json[TELEMETRY_MAX_JSON_LENGTH];
+      telemetryFormatJson(json, sizeof(json), deviceID, &readings[i], timestamps ? now - (long)ages[i] : -1);
+      printf("%s\n", json);
+      fflush(stdout);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,136 @@
+/*
+  Gateway side handling of telemetry frames (see telemetry_json.h)
+
+  Copyright: desplega.com
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "telemetry_json.h"
+
+int telemetryDecodeFrame(const uint8_t *frame, uint8_t length, char *deviceID,
+                         TelemetryReading *readings, uint32_t *ages, uint8_t maxReadings)
+{
+  if (length > 0 && maxReadings > 0 && frame[0] == TELEMETRY_VERSION)
+  {
+    ages[0] = 0;
+    return telemetryDecode(frame, length, deviceID, &readings[0]) ? 1 : -1;
+  }
+  if (length > 0 && frame[0] == TELEMETRY_BATCH_VERSION)
+    return telemetryDecodeBatch(frame, length, deviceID, readings, ages, maxReadings);
+  return -1;
+}
+
+bool telemetryIsDuplicate(TelemetryDuplicates *duplicates, const char *deviceID, uint32_t sequence)
+{
+  int i;
+  for (i = 0; i < duplicates->count; i++)
+  {
+    if (memcmp(duplicates->devices[i].deviceID, deviceID, DEVICE_ID_LENGTH) == 0)
+      break;
+  }
+  if (i == duplicates->count)
+  {
+    if (duplicates->count < TELEMETRY_MAX_DEVICES)
+      duplicates->count++;
+    else
+      i = 0; // Table full: forget the oldest entry
+  }
+  else
+  {
+    TelemetryLastSequence *last = &duplicates->devices[i];
+    uint32_t behind = last->sequence - sequence;
+    if (behind < 64)
+    {
+      if (last->seen & ((uint64_t)1 << behind))
+        return true;
+      last->seen |= (uint64_t)1 << behind;
+      return false;
+    }
+    if ((int32_t)behind < 0)
+    {
+      // Newer: slide the window
+      uint32_t ahead = sequence - last->sequence;
+      last->seen = (ahead < 64 ? last->seen << ahead : 0) | 1;
+      last->sequence = sequence;
+      return false;
+    }
+    // Older than the window, or the node restarted its numbering: start over from it
+  }
+  memcpy(duplicates->devices[i].deviceID, deviceID, DEVICE_ID_LENGTH);
+  duplicates->devices[i].sequence = sequence;
+  duplicates->devices[i].seen = 1;
+  return false;
+}
+
+// Appends to json like snprintf, keeping count of the length the whole object needs
+static void append(char *json, size_t size, int *length, const char *format, ...)
+  __attribute__((format(printf, 4, 5)));
+
+static void append(char *json, size_t size, int *length, const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  size_t used = (size_t)*length < size ? (size_t)*length : size;
+  *length += vsnprintf(json + used, size - used, format, args);
+  va_end(args);
+}
+
+// Formats a fixed point value with two decimals, as the node used to send them
+static void appendFixed16(char *json, size_t size, int *length, int16_t value)
+{
+  long centi = ((long)value * 100 + (value < 0 ? -TELEMETRY_FIXED16_SCALE / 2 : TELEMETRY_FIXED16_SCALE / 2)) / TELEMETRY_FIXED16_SCALE;
+  append(json, size, length, "%s%ld.%02ld", centi < 0 ? "-" : "", labs(centi) / 100, labs(centi) % 100);
+}
+
+int telemetryFormatJson(char *json, size_t size, const char *deviceID, const TelemetryReading *reading, long timestamp)
+{
+  const uint8_t *src = (const uint8_t *)reading;
+  bool first = true;
+  int length = 0;
+
+  if (size > 0)
+    json[0] = 0;
+  append(json, size, &length, "{\"number\":\"");
+  for (int i = 0; i < DEVICE_ID_LENGTH; i++)
+    append(json, size, &length, "%02d", deviceID[i]);
+  append(json, size, &length, "\",\"data\":{");
+  for (uint8_t i = 0; i < telemetrySchemaLength; i++)
+  {
+    TelemetryField field;
+    telemetryGetField(i, &field);
+    if (field.name[0] == 0)
+      continue;
+    append(json, size, &length, "%s\"%.*s\":\"", first ? "" : ",", (int)sizeof(field.name), field.name);
+    first = false;
+    switch (field.type)
+    {
+    case TELEMETRY_VARINT:
+    {
+      uint32_t value;
+      memcpy(&value, src + field.offset, sizeof(value));
+      append(json, size, &length, "%lu", (unsigned long)value);
+      break;
+    }
+    case TELEMETRY_FIXED16:
+    {
+      int16_t value;
+      memcpy(&value, src + field.offset, sizeof(value));
+      appendFixed16(json, size, &length, value);
+      break;
+    }
+    case TELEMETRY_FLAG:
+      append(json, size, &length, "%d", src[field.offset]);
+      break;
+    }
+    append(json, size, &length, "\"");
+  }
+  append(json, size, &length, "}");
+  if (timestamp >= 0 && !reading->timeUnknown)
+    append(json, size, &length, ",\"timestamp\":%ld", timestamp);
+  append(json, size, &length, "}");
+  return length;
+}
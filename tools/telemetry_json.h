@@ -0,0 +1,52 @@
+/*
+  Gateway side handling of telemetry frames, shared by tools/telemetry_decode.cpp and tools/gateway.cpp:
+  decoding either frame version, dropping repeated readings, and formatting readings as the JSON the
+  IoT server expects:
+    {"number":"191103181200","data":{"t0":"21.50","t1":"0.00","h":"1","l":"0"}}
+
+  Copyright: desplega.com
+*/
+
+#ifndef TELEMETRY_JSON_H
+#define TELEMETRY_JSON_H
+
+#include "telemetry.h"
+
+// Number of devices whose last sequence numbers are remembered
+#define TELEMETRY_MAX_DEVICES 64
+
+// Most readings in a batch frame
+#define TELEMETRY_MAX_READINGS 255
+
+// Room for the longest JSON object telemetryFormatJson() writes, with its terminating 0
+#define TELEMETRY_MAX_JSON_LENGTH 512
+
+typedef struct
+{
+  char deviceID[DEVICE_ID_LENGTH];
+  uint32_t sequence; // Highest sequence number seen
+  uint64_t seen;     // Bit n set if sequence - n was seen, for readings replayed from the node's store
+} TelemetryLastSequence;
+
+// The last 64 sequence numbers of each device. Zero it before first use
+typedef struct
+{
+  TelemetryLastSequence devices[TELEMETRY_MAX_DEVICES];
+  int count;
+} TelemetryDuplicates;
+
+// Decodes a single reading frame or a batch frame into at most maxReadings readings, oldest first.
+// ages receives the age of each reading in seconds at the time it was sent.
+// Returns the number of readings, or -1 if the frame is invalid
+int telemetryDecodeFrame(const uint8_t *frame, uint8_t length, char *deviceID,
+                         TelemetryReading *readings, uint32_t *ages, uint8_t maxReadings);
+
+// Returns true if the reading repeats one of the last 64 of its device, and remembers it otherwise
+bool telemetryIsDuplicate(TelemetryDuplicates *duplicates, const char *deviceID, uint32_t sequence);
+
+// Formats a reading as one JSON object, without a newline. timestamp < 0 leaves it out, as does a
+// reading whose time is unknown.
+// Returns the length of the object, which is truncated if it is size or more
+int telemetryFormatJson(char *json, size_t size, const char *deviceID, const TelemetryReading *reading, long timestamp);
+
+#endif